@@ -0,0 +1,396 @@
+#include "Benchmark.h"
+
+#include "Camera.h"
+#include "FrameInfo.h"
+#include "Profiler.h"
+#include "descriptors/DescriptorWriter.h"
+#include "systems/MeshRenderSystem.h"
+#include "systems/ShadowRenderSystem.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace engine {
+
+  namespace {
+    struct Summary {
+      float min;
+      float mean;
+      float p50;
+      float p90;
+      float p95;
+      float p99;
+      float max;
+    };
+
+    // nearest rank percentiles
+    Summary summarize(std::vector<float> values) {
+      Summary summary{};
+      if (values.empty()) {
+        return summary;
+      }
+      std::sort(values.begin(), values.end());
+      auto percentile = [&](float p) {
+        auto rank = static_cast<size_t>(std::ceil(p / 100.0f * static_cast<float>(values.size())));
+        return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+      };
+
+      double sum = 0.0;
+      for (float value : values) {
+        sum += value;
+      }
+      summary.min = values.front();
+      summary.mean = static_cast<float>(sum / static_cast<double>(values.size()));
+      summary.p50 = percentile(50.0f);
+      summary.p90 = percentile(90.0f);
+      summary.p95 = percentile(95.0f);
+      summary.p99 = percentile(99.0f);
+      summary.max = values.back();
+      return summary;
+    }
+
+    void writeSummary(std::ostream &out, const Summary &summary) {
+      out << "{\"min\": " << summary.min << ", \"mean\": " << summary.mean << ", \"p50\": " << summary.p50
+          << ", \"p90\": " << summary.p90 << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99
+          << ", \"max\": " << summary.max << "}";
+    }
+
+    void printSummary(const char *name, const Summary &summary) {
+      std::cout << std::fixed << std::setprecision(3) << name << " ms: mean " << summary.mean
+                << ", p50 " << summary.p50 << ", p95 " << summary.p95 << ", p99 " << summary.p99
+                << ", max " << summary.max << std::endl;
+    }
+  } // namespace
+
+  Benchmark::Benchmark(const BenchmarkSettings &settings)
+      : m_settings{settings},
+        m_renderer{m_device, settings.extent, settings.framePolicy} {
+    uint32_t framesInFlight = m_renderer.GetFramesInFlight();
+    m_globalPool = DescriptorPool::Builder(m_device)
+                       .setMaxSets(framesInFlight)
+                       .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                                    framesInFlight)
+                       .build();
+  }
+
+  Benchmark::~Benchmark() {
+    m_device.waitIdle();
+  }
+
+  void Benchmark::buildScene() {
+    if (!m_resourceManager.importModel("../model/structure_1.obj")) {
+      throw std::runtime_error("benchmark: failed to load ../model/structure_1.obj");
+    }
+    if (!m_resourceManager.importTexture("../textures/structure_1.png")) {
+      throw std::runtime_error("benchmark: failed to load ../textures/structure_1.png");
+    }
+
+    // columns of random height from a fixed seed, y grows upwards as -y in world space
+    std::minstd_rand random{1};
+    uint32_t size = m_settings.sceneSize;
+    m_structures.clear();
+    m_structures.reserve(size * size * m_settings.maxHeight);
+    for (uint32_t x = 0; x < size; x++) {
+      for (uint32_t z = 0; z < size; z++) {
+        uint32_t height = 1 + random() % std::max(m_settings.maxHeight, 1u);
+        for (uint32_t y = 0; y < height; y++) {
+          auto color = static_cast<Structure::Color>((x + y + z) % Structure::COLOR_MAX);
+          m_structures.emplace_back(Structure{Structure::TYPE_1, color, {x, y, z}});
+        }
+      }
+    }
+    m_structureCount = static_cast<uint32_t>(m_structures.size());
+  }
+
+  void Benchmark::run() {
+    buildScene();
+
+    auto globalSetLayout =
+        DescriptorSetLayout::Builder(m_device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                        VK_SHADER_STAGE_ALL_GRAPHICS)
+            .build();
+
+    VkDescriptorSet globalDescriptorSet;
+    auto bufferInfo = m_renderer.GetFrameAllocator().descriptorInfo(sizeof(GlobalUbo));
+    DescriptorWriter(*globalSetLayout, *m_globalPool)
+        .writeBuffer(0, &bufferInfo)
+        .build(globalDescriptorSet);
+
+    ShadowRenderSystem shadowRenderSystem{m_device, m_pipelineRegistry, globalSetLayout->getDescriptorSetLayout()};
+    MeshRenderSystem renderSystem{m_device,
+                                  m_pipelineRegistry,
+                                  m_renderer.GetViewportRenderPass(),
+                                  {
+                                      globalSetLayout->getDescriptorSetLayout(),
+                                      shadowRenderSystem.GetDescriptorSetLayout(),
+                                      m_resourceManager.getTextureSetLayout()
+                                  },
+                                  "../shader/mesh.vert.spv",
+                                  "../shader/mesh_compact.vert.spv",
+                                  "../shader/mesh.frag.spv"
+    };
+
+    auto &graph = m_renderer.GetRenderGraph();
+    auto shadowMap = graph.addTransientImage("shadow map", VK_IMAGE_ASPECT_DEPTH_BIT);
+    graph.bindImage(shadowMap, shadowRenderSystem.GetShadowMapImage());
+
+    glm::vec3 backgroundColor{0.3f, 0.5f, 1.0f};
+    m_renderer.SetClearColor(backgroundColor);
+
+    float size = static_cast<float>(m_settings.sceneSize);
+    glm::vec3 center{size * 0.5f, -0.5f * static_cast<float>(m_settings.maxHeight), size * 0.5f};
+    float radius = size * 0.9f;
+    float cameraHeight = static_cast<float>(m_settings.maxHeight) + size * 0.3f;
+
+    component::Camera cam;
+    float aspect = static_cast<float>(m_settings.extent.width) / static_cast<float>(m_settings.extent.height);
+    cam.SetPerspectiveProjection(glm::radians(50.0f), aspect, 0.1f, 4.0f * size + 100.0f);
+
+    uint32_t totalFrames = m_settings.warmupFrames + m_settings.frames;
+    std::vector<FrameSample> samples(m_settings.frames, FrameSample{0.0f, 0.0f, -1.0f, {}});
+
+    // GPU results arrive a few frames late, the profiler's frame numbers map them
+    // back to the samples
+    auto &gpuProfiler = m_renderer.GetGpuProfiler();
+    uint64_t firstMeasuredGpuFrame = gpuProfiler.nextFrame() + m_settings.warmupFrames;
+    gpuProfiler.setFrameCallback([&](const GpuFrameTiming &timing) {
+      if (timing.frame < firstMeasuredGpuFrame || timing.frame - firstMeasuredGpuFrame >= samples.size()) {
+        return;
+      }
+      FrameSample &sample = samples[timing.frame - firstMeasuredGpuFrame];
+      if (gpuProfiler.timestampsSupported()) {
+        sample.gpuMs = timing.ms;
+      }
+      sample.gpuPasses = timing.passes;
+    });
+
+    if (!m_settings.tracePath.empty()) {
+      Profiler::setThreadName("main");
+      Profiler::setEnabled(true);
+    }
+
+    std::cout << "benchmark: " << m_structureCount << " structures, " << m_settings.extent.width << "x"
+              << m_settings.extent.height << ", " << m_settings.warmupFrames << " warmup and "
+              << m_settings.frames << " measured frames" << std::endl;
+
+    using clock = std::chrono::steady_clock;
+    auto previousStart = clock::now();
+    float frameTime = 0.0f;
+    for (uint32_t frame = 0; frame < totalFrames; frame++) {
+      // the camera holds still during warmup, then circles the scene exactly once
+      float t = frame < m_settings.warmupFrames
+                    ? 0.0f
+                    : static_cast<float>(frame - m_settings.warmupFrames) / static_cast<float>(m_settings.frames);
+      float angle = t * glm::two_pi<float>();
+      glm::vec3 cameraPosition = center + glm::vec3{radius * std::cos(angle), -cameraHeight, radius * std::sin(angle)};
+      cam.SetViewTarget(cameraPosition, center);
+
+      Profiler::markFrame();
+      PROFILE_SCOPE("Benchmark::frame");
+      auto commandBuffer = m_renderer.BeginFrame();
+      auto start = clock::now();
+      frameTime = std::chrono::duration<float>(start - previousStart).count();
+      if (frame > m_settings.warmupFrames) {
+        samples[frame - m_settings.warmupFrames - 1].frameMs = frameTime * 1000.0f;
+      }
+      previousStart = start;
+
+      uint32_t frameIndex = m_renderer.GetFrameIndex();
+
+      GlobalUbo ubo{};
+      ubo.view = cam.View();
+      ubo.projection = cam.Projection();
+      ubo.ambientLightColor = glm::vec4(backgroundColor, 1);
+      ubo.lightPosition = center + glm::vec3{-size * 0.5f, -size, -size * 0.5f};
+      glm::mat4 lightProjection = glm::ortho(-size, size, -size, size, 0.1f, 4.0f * size);
+      glm::mat4 lightView = glm::lookAt(glm::vec3(ubo.lightPosition), center, glm::vec3(0.0f, -1.0f, 0.0f));
+      ubo.lightSpaceMatrix = lightProjection * lightView;
+
+      auto &frameAllocator = m_renderer.GetFrameAllocator();
+      auto uboAllocation = frameAllocator.pushUniform(ubo);
+
+      FrameInfo frameInfo{static_cast<int>(frameIndex),
+                          frameTime,
+                          commandBuffer,
+                          {globalDescriptorSet},
+                          {uboAllocation.dynamicOffset()},
+                          m_structures,
+                          m_resourceManager,
+                          frameAllocator
+      };
+      frameInfo.cameraPosition = cameraPosition;
+      frameInfo.projectionScale = 0.5f * static_cast<float>(m_settings.extent.height) * cam.Projection()[1][1];
+      frameInfo.viewProjection = ubo.projection * ubo.view;
+
+      graph.addPass("shadow", {{shadowMap, RenderGraph::Use::DepthAttachment}},
+                    [&](VkCommandBuffer) { shadowRenderSystem.Render(frameInfo); });
+      graph.addPass("scene",
+                    {{shadowMap, RenderGraph::Use::FragmentSampled},
+                     {m_renderer.GetViewportColor(), RenderGraph::Use::ColorAttachment},
+                     {m_renderer.GetViewportDepth(), RenderGraph::Use::DepthAttachment}},
+                    [&](VkCommandBuffer commandBuffer) {
+                      m_renderer.BeginViewportRenderPass(commandBuffer);
+                      frameInfo.descriptorSets.push_back(shadowRenderSystem.GetShadowMapDescriptorSet());
+                      renderSystem.Render(frameInfo);
+                      m_renderer.EndViewportRenderPass(commandBuffer);
+                    });
+      graph.execute(commandBuffer);
+
+      m_renderer.EndFrame();
+
+      if (frame >= m_settings.warmupFrames) {
+        samples[frame - m_settings.warmupFrames].cpuMs =
+            std::chrono::duration<float, std::milli>(clock::now() - start).count();
+      }
+    }
+
+    m_device.waitIdle();
+    // the last frame ends when the GPU has finished all of them
+    if (!samples.empty()) {
+      samples.back().frameMs = std::chrono::duration<float, std::milli>(clock::now() - previousStart).count();
+    }
+    gpuProfiler.readAll();
+    gpuProfiler.setFrameCallback(nullptr);
+
+    writeReport(samples);
+    m_device.writeMemoryReport(std::cout);
+    if (!m_settings.tracePath.empty()) {
+      Profiler::setEnabled(false);
+      Profiler::writeChromeTrace(m_settings.tracePath);
+    }
+  }
+
+  void Benchmark::writeReport(const std::vector<FrameSample> &samples) const {
+    std::vector<float> frameMs;
+    std::vector<float> cpuMs;
+    std::vector<float> gpuMs;
+    for (const auto &sample : samples) {
+      frameMs.push_back(sample.frameMs);
+      cpuMs.push_back(sample.cpuMs);
+      if (sample.gpuMs >= 0.0f) {
+        gpuMs.push_back(sample.gpuMs);
+      }
+    }
+
+    Summary frameSummary = summarize(frameMs);
+    Summary cpuSummary = summarize(cpuMs);
+    Summary gpuSummary = summarize(gpuMs);
+    printSummary("frame", frameSummary);
+    printSummary("cpu", cpuSummary);
+    if (!gpuMs.empty()) {
+      printSummary("gpu", gpuSummary);
+    }
+
+    // the benchmark adds the same passes every frame, so they line up by index
+    std::vector<std::string> passNames;
+    for (const auto &sample : samples) {
+      if (!sample.gpuPasses.empty()) {
+        for (const auto &pass : sample.gpuPasses) {
+          passNames.push_back(pass.name);
+        }
+        break;
+      }
+    }
+    std::vector<Summary> passSummaries;
+    std::vector<std::array<double, GpuPassTiming::STATISTIC_COUNT>> passStatistics;
+    for (size_t pass = 0; pass < passNames.size(); pass++) {
+      std::vector<float> passMs;
+      std::array<double, GpuPassTiming::STATISTIC_COUNT> statistics{};
+      for (const auto &sample : samples) {
+        if (pass < sample.gpuPasses.size()) {
+          passMs.push_back(sample.gpuPasses[pass].ms);
+          for (uint32_t s = 0; s < GpuPassTiming::STATISTIC_COUNT; s++) {
+            statistics[s] += static_cast<double>(sample.gpuPasses[pass].statistics[s]);
+          }
+        }
+      }
+      for (auto &statistic : statistics) {
+        statistic /= static_cast<double>(std::max<size_t>(passMs.size(), 1));
+      }
+      passSummaries.push_back(summarize(passMs));
+      passStatistics.push_back(statistics);
+      if (m_renderer.GetGpuProfiler().timestampsSupported()) {
+        printSummary(("gpu " + passNames[pass]).c_str(), passSummaries.back());
+      }
+    }
+
+    std::string jsonPath = m_settings.output + ".json";
+    std::ofstream json{jsonPath, std::ios::trunc};
+    if (!json.is_open()) {
+      throw std::runtime_error("benchmark: failed to write " + jsonPath);
+    }
+    json << "{\n";
+    json << "  \"device\": \"" << m_device.properties.deviceName << "\",\n";
+    json << "  \"width\": " << m_settings.extent.width << ",\n";
+    json << "  \"height\": " << m_settings.extent.height << ",\n";
+    json << "  \"framesInFlight\": " << m_renderer.GetFramesInFlight() << ",\n";
+    json << "  \"structures\": " << m_structureCount << ",\n";
+    json << "  \"warmupFrames\": " << m_settings.warmupFrames << ",\n";
+    json << "  \"frames\": " << samples.size() << ",\n";
+    json << "  \"frameMs\": ";
+    writeSummary(json, frameSummary);
+    json << ",\n  \"cpuMs\": ";
+    writeSummary(json, cpuSummary);
+    json << ",\n  \"gpuMs\": ";
+    if (gpuMs.empty()) {
+      json << "null";
+    } else {
+      writeSummary(json, gpuSummary);
+    }
+    // per pass times and the mean pipeline statistics of a frame
+    json << ",\n  \"gpuPasses\": [";
+    for (size_t pass = 0; pass < passNames.size(); pass++) {
+      json << (pass == 0 ? "\n" : ",\n") << "    {\"name\": \"" << passNames[pass] << "\", \"ms\": ";
+      if (m_renderer.GetGpuProfiler().timestampsSupported()) {
+        writeSummary(json, passSummaries[pass]);
+      } else {
+        json << "null";
+      }
+      if (m_renderer.GetGpuProfiler().statisticsSupported()) {
+        for (uint32_t s = 0; s < GpuPassTiming::STATISTIC_COUNT; s++) {
+          json << ", \"" << GpuPassTiming::statisticName(s) << "\": " << passStatistics[pass][s];
+        }
+      }
+      json << "}";
+    }
+    json << (passNames.empty() ? "]" : "\n  ]") << "\n}\n";
+
+    std::string csvPath = m_settings.output + ".csv";
+    std::ofstream csv{csvPath, std::ios::trunc};
+    if (!csv.is_open()) {
+      throw std::runtime_error("benchmark: failed to write " + csvPath);
+    }
+    csv << "frame,frame_ms,cpu_ms,gpu_ms";
+    for (const auto &name : passNames) {
+      csv << ",gpu_" << name << "_ms";
+    }
+    csv << '\n';
+    for (size_t i = 0; i < samples.size(); i++) {
+      csv << i << ',' << samples[i].frameMs << ',' << samples[i].cpuMs << ',';
+      if (samples[i].gpuMs >= 0.0f) {
+        csv << samples[i].gpuMs;
+      }
+      for (size_t pass = 0; pass < passNames.size(); pass++) {
+        csv << ',';
+        if (samples[i].gpuMs >= 0.0f && pass < samples[i].gpuPasses.size()) {
+          csv << samples[i].gpuPasses[pass].ms;
+        }
+      }
+      csv << '\n';
+    }
+
+    std::cout << "benchmark: wrote " << jsonPath << " and " << csvPath << std::endl;
+  }
+
+} // namespace engine
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Device.h"
+#include "PipelineRegistry.h"
+#include "Renderer.h"
+#include "ResourceManager.h"
+#include "Structure.h"
+#include "descriptors/DescriptorPool.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+    struct BenchmarkSettings {
+        uint32_t frames = 1000;
+        // rendered before measuring so pipelines, caches and clocks settle
+        uint32_t warmupFrames = 60;
+        VkExtent2D extent{1280, 720};
+        // the scene is a square grid of structure columns up to maxHeight tall
+        uint32_t sceneSize = 24;
+        uint32_t maxHeight = 6;
+        // the summary goes to <output>.json, the time of every frame to <output>.csv
+        std::string output = "benchmark";
+        // CPU scopes of the run as a Chrome trace, not written when empty
+        std::string tracePath;
+        FramePolicy framePolicy{};
+    };
+
+    // Renders a generated scene headless while the camera circles it once over
+    // the measured frames, then reports CPU and GPU frame time percentiles. Scene
+    // and camera path only depend on the settings, so runs stay comparable.
+    class Benchmark {
+    public:
+        explicit Benchmark(const BenchmarkSettings &settings);
+        ~Benchmark();
+        Benchmark(const Benchmark &) = delete;
+        Benchmark &operator=(const Benchmark &) = delete;
+
+        void run();
+
+    private:
+        struct FrameSample {
+            // start of this frame to start of the next
+            float frameMs;
+            // recording and submission, without waiting for a free frame slot
+            float cpuMs;
+            // first to last command on the GPU, negative without timestamp support
+            float gpuMs;
+            // the render graph's passes as measured by the renderer's GPU profiler
+            std::vector<GpuPassTiming> gpuPasses;
+        };
+
+        void buildScene();
+
+        void writeReport(const std::vector<FrameSample> &samples) const;
+
+        BenchmarkSettings m_settings;
+        Device m_device;
+        PipelineRegistry m_pipelineRegistry{m_device};
+        Renderer m_renderer;
+        ResourceManager m_resourceManager{m_device};
+        std::unique_ptr<DescriptorPool> m_globalPool;
+
+        std::vector<std::optional<Structure>> m_structures;
+        uint32_t m_structureCount{0};
+    };
+
+} // namespace engine
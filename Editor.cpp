@@ -2,6 +2,7 @@
 
 #include "Camera.h"
 #include "Imgui.h"
+#include "Profiler.h"
 #include "TextureArray.h"
 #include "descriptors/DescriptorWriter.h"
 #include "systems/MeshRenderSystem.h"
@@ -11,26 +12,35 @@
 #include "GLFW/glfw3.h"
 #include "systems/ShadowRenderSystem.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <random>
 
 namespace engine {
 
-  Editor::Editor() {
+  Editor::Editor(const FramePolicy &framePolicy)
+      : m_renderer{m_window, m_device, {100, 100}, framePolicy},
+        m_requestedPresentMode{m_renderer.GetFramePolicy().presentMode} {
+    uint32_t framesInFlight = m_renderer.GetFramesInFlight();
     mGlobalPool = DescriptorPool::Builder(m_device)
-                      .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
-                      .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                                   SwapChain::MAX_FRAMES_IN_FLIGHT)
+                      .setMaxSets(framesInFlight)
+                      .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                                   framesInFlight)
                       .addPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-                                   SwapChain::MAX_FRAMES_IN_FLIGHT)
+                                   framesInFlight)
                       .build();
   }
 
   Editor::~Editor() = default;
 
   void Editor::run() {
+    Profiler::setThreadName("main");
+    auto startupTime = std::chrono::high_resolution_clock::now();
+
     Imgui imgui{m_window, m_device, m_renderer.GetSwapChainRenderPass(),
                 m_renderer.GetImageCount()};
 
@@ -38,39 +48,35 @@ namespace engine {
     io.Fonts->AddFontFromFileTTF("../font/MontserratAlternates-Bold.otf",
                                  32.0f);
 
-    std::vector<std::unique_ptr<Buffer>> uboBuffers(
-        SwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (auto &uboBuffer : uboBuffers) {
-      uboBuffer = std::make_unique<Buffer>(m_device, sizeof(GlobalUbo), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-      uboBuffer->map();
-    }
-
+    // the global ubo lives in the renderer's frame allocator, one descriptor set
+    // covers every frame and the dynamic offset selects this frame's copy
     auto globalSetLayout =
         DescriptorSetLayout::Builder(m_device)
-            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                         VK_SHADER_STAGE_ALL_GRAPHICS)
             .build();
 
-    std::vector<VkDescriptorSet> globalDescriptorSets(
-        SwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (uint32_t i = 0; i < globalDescriptorSets.size(); i++) {
-      auto bufferInfo = uboBuffers[i]->descriptorInfo();
-      DescriptorWriter(*globalSetLayout, *mGlobalPool)
-          .writeBuffer(0, &bufferInfo)
-          .build(globalDescriptorSets[i]);
-    }
+    VkDescriptorSet globalDescriptorSet;
+    auto bufferInfo = m_renderer.GetFrameAllocator().descriptorInfo(sizeof(GlobalUbo));
+    DescriptorWriter(*globalSetLayout, *mGlobalPool)
+        .writeBuffer(0, &bufferInfo)
+        .build(globalDescriptorSet);
 
-    ShadowRenderSystem shadowRenderSystem{m_device, globalSetLayout->getDescriptorSetLayout()};
+    ShadowRenderSystem shadowRenderSystem{m_device, m_pipelineRegistry, globalSetLayout->getDescriptorSetLayout()};
+    // the shadow map is rewritten every frame and outlives the renderer's passes
+    auto shadowMap = m_renderer.GetRenderGraph().addTransientImage("shadow map", VK_IMAGE_ASPECT_DEPTH_BIT);
+    m_renderer.GetRenderGraph().bindImage(shadowMap, shadowRenderSystem.GetShadowMapImage());
 
     MeshRenderSystem renderSystem{m_device,
-                                  m_renderer.GetSwapChainRenderPass(),
+                                  m_pipelineRegistry,
+                                  m_renderer.GetViewportRenderPass(),
                                   {
                                       globalSetLayout->getDescriptorSetLayout(),
                                       shadowRenderSystem.GetDescriptorSetLayout(),
                                       m_resourceManager.getTextureSetLayout()
                                   },
                                   "../shader/mesh.vert.spv",
+                                  "../shader/mesh_compact.vert.spv",
                                   "../shader/mesh.frag.spv"
     };
 
@@ -89,8 +95,9 @@ namespace engine {
     auto camPos = glm::vec3{0, -5, 0};
     cam.SetViewTarget(camPos, glm::vec3{5, 0, 5});
 
-    m_resourceManager.importModel("../model/structure_1.obj");
-    m_resourceManager.importTexture("../textures/structure_1.png");
+    // loads on the resource manager's workers, placeholders are drawn until then
+    m_resourceManager.importModelAsync("../model/structure_1.obj");
+    m_resourceManager.importTextureAsync("../textures/structure_1.png");
 
     m_game.PlaceStructure({5, 0, 5}, Structure::COLOR_1);
 //    m_game.PlaceStructure({0, 1, 0}, Structure::COLOR_1);
@@ -98,7 +105,14 @@ namespace engine {
     float placeTimeout = 1.0f;
     float placeTimer = 0.0f;
 
+    std::cout << "Startup took "
+              << std::chrono::duration<float, std::chrono::milliseconds::period>(
+                     std::chrono::high_resolution_clock::now() - startupTime).count()
+              << " ms" << std::endl;
+
     while (!m_window.shouldClose()) {
+      Profiler::markFrame();
+      PROFILE_SCOPE("Editor::frame");
       glfwPollEvents();
 
       if (m_window.minimized()) {
@@ -121,10 +135,18 @@ namespace engine {
       }
 
       if (auto commandBuffer = m_renderer.BeginFrame()) {
-        if (texture)
+        // the viewport texture only changes when the viewport is resized, so its
+        // ImGui descriptor is registered once per size instead of every frame
+        auto viewportTexture = m_renderer.GetTexture();
+        if (viewportTexture != texture) {
+          if (textureID) {
+            imgui.removeTexture(textureID);
+          }
+          texture = viewportTexture;
           textureID =
               imgui.addTexture(texture->sampler(), texture->imageView(),
                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        }
 
         int frameIndex = (int)m_renderer.GetFrameIndex();
 
@@ -145,53 +167,51 @@ namespace engine {
 
         ubo.lightSpaceMatrix = lightProjection * lightView;
 
-        uboBuffers[frameIndex]->writeToBuffer(&ubo);
-        uboBuffers[frameIndex]->flush();
+        auto &frameAllocator = m_renderer.GetFrameAllocator();
+        auto uboAllocation = frameAllocator.pushUniform(ubo);
 
         FrameInfo frameInfo{frameIndex,
                             frameTime,
                             commandBuffer,
-                            {globalDescriptorSets[frameIndex]},
+                            {globalDescriptorSet},
+                            {uboAllocation.dynamicOffset()},
                             m_game.GetStructures(),
-                            m_resourceManager
+                            m_resourceManager,
+                            frameAllocator
         };
+        frameInfo.cameraPosition = glm::vec3(glm::inverse(cam.View())[3]);
+        frameInfo.projectionScale = 0.5f * static_cast<float>(m_renderer.Extent().height) * cam.Projection()[1][1];
+        frameInfo.viewProjection = ubo.projection * ubo.view;
+        if (m_occlusionCulling) {
+          cullStructures(frameInfo);
+        }
 
         m_renderer.SetClearColor(m_backgroundColor);
 
-        // render
-        shadowRenderSystem.Render(frameInfo);
-
-        VkMemoryBarrier memoryBarrier{};
-        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-        memoryBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-        memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(
-            commandBuffer,
-            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
-            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-            0,
-            1, &memoryBarrier,
-            0, nullptr,
-            0, nullptr
-        );
-
-        m_renderer.BeginSwapChainRenderPass(commandBuffer);
-        {
-          frameInfo.descriptorSets.push_back(shadowRenderSystem.GetShadowMapDescriptorSet());
-          renderSystem.Render(frameInfo);
-        }
-        m_renderer.EndSwapChainRenderPass(commandBuffer);
+        // The passes only declare what they read and write, the render graph places
+        // the barriers between them. Nothing is recorded before execute.
+        auto &graph = m_renderer.GetRenderGraph();
+        graph.addPass("shadow", {{shadowMap, RenderGraph::Use::DepthAttachment}},
+                      [&](VkCommandBuffer) { shadowRenderSystem.Render(frameInfo); });
+        graph.addPass("scene",
+                      {{shadowMap, RenderGraph::Use::FragmentSampled},
+                       {m_renderer.GetViewportColor(), RenderGraph::Use::ColorAttachment},
+                       {m_renderer.GetViewportDepth(), RenderGraph::Use::DepthAttachment}},
+                      [&](VkCommandBuffer commandBuffer) {
+                        m_renderer.BeginViewportRenderPass(commandBuffer);
+                        frameInfo.descriptorSets.push_back(shadowRenderSystem.GetShadowMapDescriptorSet());
+                        renderSystem.Render(frameInfo);
+                        m_renderer.EndViewportRenderPass(commandBuffer);
+                      });
 
         imgui.newFrame();
 
         ImGui::Begin("Viewport", nullptr, ImGuiTableColumnFlags_NoResize);
         {
-          ImVec2 extent = ImGui::GetWindowSize();
-          m_renderer.SetExtent({(uint32_t)extent.x, (uint32_t)extent.y});
+          ImVec2 viewportPanelSize = ImGui::GetContentRegionAvail();
+          m_renderer.SetExtent({(uint32_t)viewportPanelSize.x, (uint32_t)viewportPanelSize.y});
 
           if (textureID) {
-            ImVec2 viewportPanelSize = ImGui::GetContentRegionAvail();
             ImGui::Image((ImTextureID)textureID, viewportPanelSize);
 
             if (ImGui::IsItemHovered()) {
@@ -209,14 +229,315 @@ namespace engine {
         }
         ImGui::End();
 
+        drawFrameSettings();
+        drawOcclusionStats();
+        drawProfiler();
+        drawMemory();
+
+        graph.addPass("imgui",
+                      {{m_renderer.GetViewportColor(), RenderGraph::Use::FragmentSampled},
+                       {m_renderer.GetSwapChainImage(), RenderGraph::Use::ColorAttachment}},
+                      [&](VkCommandBuffer) { m_renderer.RenderImGui(); });
+        graph.execute(commandBuffer);
+
+        m_renderer.EndFrame();
       }
-      m_renderer.RenderImGui();
-      m_renderer.EndFrame();
+
+      // the swap chain can only be recreated outside of a frame, the combo shows
+      // the mode the renderer fell back to when the request is unsupported
+      m_renderer.SetPresentMode(m_requestedPresentMode);
+      m_requestedPresentMode = m_renderer.GetFramePolicy().presentMode;
+    }
+
+    if (textureID) {
       imgui.removeTexture(textureID);
+    }
+
+  }
+
+  void Editor::drawFrameSettings() {
+    static constexpr VkPresentModeKHR presentModes[] = {
+        VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+    static constexpr const char *presentModeNames[] = {"V-Sync (FIFO)", "Mailbox", "Immediate"};
+
+    ImGui::Begin("Frame Settings");
+
+    ImGui::Text("Frames in flight: %u", m_renderer.GetFramesInFlight());
+    const auto &graphStats = m_renderer.GetRenderGraph().stats();
+    ImGui::Text("Render graph: %u passes, %u barriers (%u images)",
+                graphStats.passes, graphStats.barriers, graphStats.imageBarriers);
+    const auto registryStats = m_pipelineRegistry.stats();
+    ImGui::Text("Pipelines: %u (%u hits, %u misses)", registryStats.pipelines, registryStats.hits,
+                registryStats.misses);
+
+    int current = 0;
+    for (int i = 0; i < IM_ARRAYSIZE(presentModes); i++) {
+      if (presentModes[i] == m_requestedPresentMode) {
+        current = i;
+      }
+    }
+    if (ImGui::Combo("Present mode", &current, presentModeNames, IM_ARRAYSIZE(presentModeNames))) {
+      m_requestedPresentMode = presentModes[current];
+    }
+
+    float maxFrameRate = m_renderer.GetFramePolicy().maxFrameRate;
+    if (ImGui::SliderFloat("Frame rate cap", &maxFrameRate, 0.0f, 240.0f, maxFrameRate > 0.0f ? "%.0f fps" : "off")) {
+      m_renderer.SetMaxFrameRate(maxFrameRate);
+    }
+
+    // every change rebuilds the material array, so only finished edits are applied
+    ImGui::SliderFloat("Anisotropy", &m_samplerSettings.maxAnisotropy, 1.0f, 16.0f, "%.0fx");
+    if (ImGui::IsItemDeactivatedAfterEdit()) {
+      m_resourceManager.setSamplerSettings(m_samplerSettings);
+    }
+    ImGui::SliderFloat("Mip LOD bias", &m_samplerSettings.mipLodBias, -2.0f, 2.0f, "%.2f");
+    if (ImGui::IsItemDeactivatedAfterEdit()) {
+      m_resourceManager.setSamplerSettings(m_samplerSettings);
+    }
+
+    ImGui::End();
+  }
+
+  void Editor::cullStructures(FrameInfo &frameInfo) {
+    PROFILE_SCOPE("Editor::cullStructures");
+    const auto &structures = frameInfo.structures;
+    m_occluderBoxes.clear();
+    m_boundsMin.clear();
+    m_boundsMax.clear();
+    m_boundsStructure.clear();
+
+    for (uint32_t i = 0; i < structures.size(); i++) {
+      if (!structures[i]) continue;
+
+      std::shared_ptr<Model> model = m_resourceManager.getModel(structures[i]->type);
+      if (!model) continue;
+
+      glm::vec3 min = model->GetMinExtents();
+      glm::vec3 max = model->GetMaxExtents();
+      transformBox(structures[i]->mat4(), min, max);
+      m_boundsMin.push_back(min);
+      m_boundsMax.push_back(max);
+      m_boundsStructure.push_back(i);
+      if (model->IsSolidBox()) {
+        m_occluderBoxes.push_back({min, max});
+      }
+    }
+
+    // neighbouring blocks merge into rows and slabs, of those the ones covering the
+    // most of the screen are kept
+    mergeBoxes(m_occluderBoxes);
+    if (m_occluderBoxes.size() > MAX_OCCLUDERS) {
+      glm::vec3 camera = frameInfo.cameraPosition;
+      auto screenSize = [camera](const OccluderBox &box) {
+        float size = glm::length(box.max - box.min);
+        float distance = std::max(glm::length(glm::clamp(camera, box.min, box.max) - camera), 0.1f);
+        return size / distance;
+      };
+      std::nth_element(m_occluderBoxes.begin(), m_occluderBoxes.begin() + MAX_OCCLUDERS, m_occluderBoxes.end(),
+                       [&](const OccluderBox &a, const OccluderBox &b) { return screenSize(a) > screenSize(b); });
+      m_occluderBoxes.resize(MAX_OCCLUDERS);
+    }
+
+    m_occlusionCuller.beginFrame(frameInfo.viewProjection);
+    for (const auto &box : m_occluderBoxes) {
+      m_occlusionCuller.addOccluder(box);
+    }
+    m_occlusionCuller.rasterize();
+
+    m_boundsVisible.resize(m_boundsMin.size());
+    m_occlusionCuller.cullBoxes(m_boundsMin.data(), m_boundsMax.data(), static_cast<uint32_t>(m_boundsMin.size()),
+                                m_boundsVisible.data());
+    m_structureVisibility.assign(structures.size(), 1);
+    for (size_t i = 0; i < m_boundsStructure.size(); i++) {
+      m_structureVisibility[m_boundsStructure[i]] = m_boundsVisible[i];
+    }
+    frameInfo.structureVisibility = &m_structureVisibility;
+  }
+
+  void Editor::drawOcclusionStats() {
+    ImGui::Begin("Occlusion Culling");
+
+    ImGui::Checkbox("Enabled", &m_occlusionCulling);
+    if (m_occlusionCulling) {
+      const OcclusionStats &stats = m_occlusionCuller.stats();
+      ImGui::Text("Occluders: %u (%u triangles)", stats.occluders, stats.occluderTriangles);
+      ImGui::Text("Tested: %u", stats.tested);
+      ImGui::Text("Outside frustum: %u", stats.frustumCulled);
+      ImGui::Text("Occluded: %u", stats.occluded);
+      ImGui::Text("Rasterize: %.3f ms, test: %.3f ms", stats.rasterizeMs, stats.testMs);
+    }
+
+    ImGui::End();
+  }
+
+  void Editor::drawProfiler() {
+    ImGui::Begin("Profiler");
+
+    bool enabled = Profiler::enabled();
+    if (ImGui::Checkbox("Enabled", &enabled)) {
+      Profiler::setEnabled(enabled);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Save trace")) {
+      Profiler::writeChromeTrace("trace.json");
+    }
+
+    drawGpuTimings();
+
+    uint64_t frameStart, frameEnd;
+    if (!enabled || !Profiler::lastFrame(frameStart, frameEnd)) {
+      ImGui::End();
+      return;
+    }
+
+    // the last complete frame of every thread, one row per thread and nesting depth
+    m_profileEvents.clear();
+    Profiler::collect(frameStart, frameEnd, m_profileEvents);
+    std::sort(m_profileEvents.begin(), m_profileEvents.end(), [](const ProfileEvent &a, const ProfileEvent &b) {
+      return a.thread != b.thread ? a.thread < b.thread : a.depth < b.depth;
+    });
+
+    double frameMs = static_cast<double>(frameEnd - frameStart) / 1e6;
+    ImGui::Text("Frame: %.3f ms, %zu scopes", frameMs, m_profileEvents.size());
+
+    const float rowHeight = ImGui::GetTextLineHeight() + 2.0f;
+    const float width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    const ImVec2 mouse = ImGui::GetMousePos();
+    ImDrawList *drawList = ImGui::GetWindowDrawList();
+
+    // threads are separated by an empty row
+    uint32_t threadRow = 0;
+    uint32_t rows = 0;
+    const ProfileEvent *hovered = nullptr;
+    for (size_t i = 0; i < m_profileEvents.size(); i++) {
+      const ProfileEvent &event = m_profileEvents[i];
+      if (i > 0 && m_profileEvents[i - 1].thread != event.thread) {
+        threadRow = rows + 1;
+      }
+      uint32_t row = threadRow + event.depth;
+      rows = std::max(rows, row + 1);
+
+      uint64_t start = std::max(event.start, frameStart);
+      uint64_t end = std::min(event.end, frameEnd);
+      float x0 = origin.x + width * static_cast<float>(start - frameStart) / static_cast<float>(frameEnd - frameStart);
+      float x1 = origin.x + width * static_cast<float>(end - frameStart) / static_cast<float>(frameEnd - frameStart);
+      x1 = std::max(x1, x0 + 1.0f);
+      float y0 = origin.y + static_cast<float>(row) * rowHeight;
+      float y1 = y0 + rowHeight - 1.0f;
+
+      // names are literals, so the pointer gives every scope a stable color
+      auto hash = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(event.name) * 2654435761u);
+      ImU32 color = IM_COL32(96 + (hash >> 8) % 128, 96 + (hash >> 16) % 128, 96 + (hash >> 24) % 128, 255);
+      drawList->AddRectFilled({x0, y0}, {x1, y1}, color);
+      if (x1 - x0 > ImGui::CalcTextSize(event.name).x + 4.0f) {
+        drawList->AddText({x0 + 2.0f, y0 + 1.0f}, IM_COL32(0, 0, 0, 255), event.name);
+      }
+      if (mouse.x >= x0 && mouse.x < x1 && mouse.y >= y0 && mouse.y < y1) {
+        hovered = &event;
+      }
+    }
+
+    ImGui::Dummy({width, static_cast<float>(rows) * rowHeight});
+    if (hovered && ImGui::IsItemHovered()) {
+      ImGui::SetTooltip("%s\n%.3f ms", hovered->name, static_cast<double>(hovered->end - hovered->start) / 1e6);
+    }
+
+    ImGui::End();
+  }
+
+  void Editor::drawGpuTimings() {
+    const GpuProfiler &gpuProfiler = m_renderer.GetGpuProfiler();
+    const GpuFrameTiming &timing = gpuProfiler.lastFrame();
+    if (!gpuProfiler.timestampsSupported() && !gpuProfiler.statisticsSupported()) {
+      return;
+    }
+
+    if (gpuProfiler.timestampsSupported()) {
+      ImGui::Text("GPU frame: %.3f ms", timing.ms);
+    }
+    bool statistics = gpuProfiler.statisticsSupported();
+    if (ImGui::BeginTable("gpu passes", statistics ? 5 : 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+      ImGui::TableSetupColumn("Pass");
+      ImGui::TableSetupColumn("GPU ms");
+      if (statistics) {
+        ImGui::TableSetupColumn("Vertices");
+        ImGui::TableSetupColumn("Primitives");
+        ImGui::TableSetupColumn("Fragments");
+      }
+      ImGui::TableHeadersRow();
+      for (const auto &pass : timing.passes) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(pass.name.c_str());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", pass.ms);
+        if (statistics) {
+          // vertex shader invocations, primitives left after clipping, fragment shader invocations
+          ImGui::TableNextColumn();
+          ImGui::Text("%llu", static_cast<unsigned long long>(pass.statistics[2]));
+          ImGui::TableNextColumn();
+          ImGui::Text("%llu", static_cast<unsigned long long>(pass.statistics[3]));
+          ImGui::TableNextColumn();
+          ImGui::Text("%llu", static_cast<unsigned long long>(pass.statistics[4]));
+        }
+      }
+      ImGui::EndTable();
+    }
+  }
+
+  void Editor::drawMemory() {
+    static constexpr double MIB = 1024.0 * 1024.0;
+
+    ImGui::Begin("Memory");
+
+    if (ImGui::Button("Dump report")) {
+      std::ofstream report{"memory_report.txt", std::ios::trunc};
+      m_device.writeMemoryReport(report);
+      std::cout << "wrote memory_report.txt" << std::endl;
+    }
+
+    if (ImGui::BeginTable("memory tags", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+      ImGui::TableSetupColumn("Tag");
+      ImGui::TableSetupColumn("Device MiB");
+      ImGui::TableSetupColumn("Peak");
+      ImGui::TableSetupColumn("Allocations");
+      ImGui::TableSetupColumn("Host MiB");
+      ImGui::TableHeadersRow();
+      for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryTag::Count); i++) {
+        auto tag = static_cast<MemoryTag>(i);
+        auto device = MemoryTracker::counters(MemoryDomain::Device, tag);
+        auto host = MemoryTracker::counters(MemoryDomain::Host, tag);
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(memoryTagName(tag));
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", static_cast<double>(device.bytes) / MIB);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", static_cast<double>(device.peakBytes) / MIB);
+        ImGui::TableNextColumn();
+        ImGui::Text("%llu", static_cast<unsigned long long>(device.count));
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", static_cast<double>(host.bytes) / MIB);
+      }
+      ImGui::EndTable();
+    }
 
-      texture = m_renderer.GetTexture();
+    // usage against budget per heap, what other processes use is already taken
+    // out of the budget
+    ImGui::TextUnformatted(m_device.memoryBudgetSupported() ? "Heap budgets" : "Heaps (no memory budget, allocator usage)");
+    auto heaps = m_device.memoryHeaps();
+    for (size_t i = 0; i < heaps.size(); i++) {
+      const auto &heap = heaps[i];
+      char label[64];
+      std::snprintf(label, sizeof(label), "%.0f / %.0f MiB", static_cast<double>(heap.usage) / MIB,
+                    static_cast<double>(heap.budget) / MIB);
+      float fraction = heap.budget > 0 ? static_cast<float>(static_cast<double>(heap.usage) / static_cast<double>(heap.budget)) : 0.0f;
+      ImGui::Text("Heap %zu%s", i, heap.deviceLocal ? ", device local" : "");
+      ImGui::ProgressBar(fraction, {-1.0f, 0.0f}, label);
     }
 
+    ImGui::End();
   }
 
   float Editor::frand(float min, float max) {
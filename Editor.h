@@ -2,6 +2,7 @@
 
 #include "Device.h"
 #include "Pipeline.h"
+#include "PipelineRegistry.h"
 #include "Window.h"
 #include "Renderer.h"
 #include "Buffer.h"
@@ -9,6 +10,9 @@
 #include "Components.h"
 
 #include "FileManager.h"
+#include "FrameInfo.h"
+#include "OcclusionCuller.h"
+#include "Profiler.h"
 #include "ResourceManager.h"
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
@@ -52,6 +56,7 @@ namespace engine {
 
         Window m_window{WIDTH, HEIGHT, "App"};
         Device m_device{m_window};
+        PipelineRegistry m_pipelineRegistry{m_device};
         Renderer m_renderer{m_window, m_device, {100, 100}};
         ResourceManager m_resourceManager{m_device};
         FileManager m_fileManager;
@@ -61,9 +66,26 @@ namespace engine {
 
         Game<10, 5, 10> m_game;
         glm::vec3 m_backgroundColor;
+        VkPresentModeKHR m_requestedPresentMode;
+        // edited in the frame settings, handed to the resource manager once a slider is released
+        SamplerSettings m_samplerSettings{m_resourceManager.getSamplerSettings()};
+
+        // merged structure boxes rasterized per frame, the nearest and largest first
+        static constexpr size_t MAX_OCCLUDERS = 64;
+        OcclusionCuller m_occlusionCuller;
+        bool m_occlusionCulling{true};
+        std::vector<OccluderBox> m_occluderBoxes;
+        std::vector<glm::vec3> m_boundsMin;
+        std::vector<glm::vec3> m_boundsMax;
+        std::vector<uint32_t> m_boundsStructure;
+        std::vector<uint8_t> m_boundsVisible;
+        std::vector<uint8_t> m_structureVisibility;
+
+        // scopes of the last frame shown in the profiler panel
+        std::vector<ProfileEvent> m_profileEvents;
 
     public:
-      Editor();
+      explicit Editor(const FramePolicy &framePolicy = {});
         ~Editor();
         Editor(const Editor &) = delete;
         Editor &operator=(const Editor &) = delete;
@@ -74,6 +96,22 @@ namespace engine {
 
         static float frand(float min, float max);
 
+        void drawFrameSettings();
+
+        // fills frameInfo.structureVisibility from the occlusion culler
+        void cullStructures(FrameInfo &frameInfo);
+
+        void drawOcclusionStats();
+
+        // timeline of the last frame's profiled scopes, per thread
+        void drawProfiler();
+
+        // GPU time and pipeline statistics of the render graph's passes, a few frames old
+        void drawGpuTimings();
+
+        // device and host memory per tag and heap budgets
+        void drawMemory();
+
         glm::vec3 getCursorRayOriginDirection(const component::Camera& camera);
     };
 } // namespace engine
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+namespace engine {
+
+    // Result of an asynchronous import. The loader thread publishes the asset
+    // once, readers get the placeholder until then. Reading is a single atomic
+    // load, so the render thread never blocks on a loader.
+    template<typename T>
+    class AssetHandle {
+    public:
+        AssetHandle() = default;
+
+        explicit AssetHandle(std::shared_ptr<T> placeholder)
+            : m_state{std::make_shared<State>()}, m_placeholder{std::move(placeholder)} {}
+
+        [[nodiscard]] bool valid() const { return m_state != nullptr; }
+
+        [[nodiscard]] bool ready() const {
+            return m_state && m_state->status.load(std::memory_order_acquire) == Status::Ready;
+        }
+
+        [[nodiscard]] bool failed() const {
+            return m_state && m_state->status.load(std::memory_order_acquire) == Status::Failed;
+        }
+
+        // the asset once it is ready, the placeholder before that or if loading failed
+        [[nodiscard]] std::shared_ptr<T> get() const {
+            return ready() ? m_state->asset : m_placeholder;
+        }
+
+        // called once by the loader, the asset is written before the release store
+        void publish(std::shared_ptr<T> asset) const {
+            m_state->asset = std::move(asset);
+            m_state->status.store(Status::Ready, std::memory_order_release);
+        }
+
+        void fail() const {
+            m_state->status.store(Status::Failed, std::memory_order_release);
+        }
+
+    private:
+        enum class Status { Loading, Ready, Failed };
+
+        struct State {
+            std::atomic<Status> status{Status::Loading};
+            std::shared_ptr<T> asset;
+        };
+
+        std::shared_ptr<State> m_state;
+        std::shared_ptr<T> m_placeholder;
+    };
+
+} // namespace engine
@@ -0,0 +1,345 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace engine {
+
+    namespace {
+
+        constexpr uint32_t BLOCK_PIXELS = 16;
+
+        using Block = std::array<std::array<float, 4>, BLOCK_PIXELS>;
+
+        void fetchBlock(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY,
+                        Block &block) {
+            for (uint32_t y = 0; y < 4; y++) {
+                uint32_t py = std::min(blockY * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t px = std::min(blockX * 4 + x, width - 1);
+                    const uint8_t *src = pixels + (static_cast<size_t>(py) * width + px) * 4;
+                    for (uint32_t c = 0; c < 4; c++) {
+                        block[y * 4 + x][c] = static_cast<float>(src[c]);
+                    }
+                }
+            }
+        }
+
+        // End points of the block along its principal axis over the first
+        // channelCount channels, found with a few power iterations on the covariance.
+        void principalEndpoints(const Block &block, uint32_t channelCount,
+                                std::array<float, 4> &low, std::array<float, 4> &high) {
+            std::array<float, 4> mean{};
+            for (const auto &pixel : block) {
+                for (uint32_t c = 0; c < channelCount; c++) mean[c] += pixel[c];
+            }
+            for (uint32_t c = 0; c < channelCount; c++) mean[c] /= BLOCK_PIXELS;
+
+            float covariance[4][4]{};
+            for (const auto &pixel : block) {
+                for (uint32_t i = 0; i < channelCount; i++) {
+                    for (uint32_t j = 0; j < channelCount; j++) {
+                        covariance[i][j] += (pixel[i] - mean[i]) * (pixel[j] - mean[j]);
+                    }
+                }
+            }
+
+            std::array<float, 4> axis{1.0f, 1.0f, 1.0f, 1.0f};
+            for (uint32_t iteration = 0; iteration < 8; iteration++) {
+                std::array<float, 4> next{};
+                float length = 0.0f;
+                for (uint32_t i = 0; i < channelCount; i++) {
+                    for (uint32_t j = 0; j < channelCount; j++) next[i] += covariance[i][j] * axis[j];
+                    length = std::max(length, std::abs(next[i]));
+                }
+                if (length < 1e-6f) break;
+                for (uint32_t i = 0; i < channelCount; i++) axis[i] = next[i] / length;
+            }
+
+            float minProjection = 0.0f;
+            float maxProjection = 0.0f;
+            for (const auto &pixel : block) {
+                float projection = 0.0f;
+                for (uint32_t c = 0; c < channelCount; c++) projection += (pixel[c] - mean[c]) * axis[c];
+                minProjection = std::min(minProjection, projection);
+                maxProjection = std::max(maxProjection, projection);
+            }
+
+            float axisLength = 0.0f;
+            for (uint32_t c = 0; c < channelCount; c++) axisLength += axis[c] * axis[c];
+            axisLength = std::max(axisLength, 1e-6f);
+
+            for (uint32_t c = 0; c < channelCount; c++) {
+                low[c] = std::clamp(mean[c] + axis[c] * minProjection / axisLength, 0.0f, 255.0f);
+                high[c] = std::clamp(mean[c] + axis[c] * maxProjection / axisLength, 0.0f, 255.0f);
+            }
+        }
+
+        float distance(const std::array<float, 4> &a, const std::array<float, 4> &b, uint32_t channelCount) {
+            float sum = 0.0f;
+            for (uint32_t c = 0; c < channelCount; c++) sum += (a[c] - b[c]) * (a[c] - b[c]);
+            return sum;
+        }
+
+        uint16_t packRgb565(const std::array<float, 4> &color) {
+            auto r = static_cast<uint16_t>(std::lround(color[0] * 31.0f / 255.0f));
+            auto g = static_cast<uint16_t>(std::lround(color[1] * 63.0f / 255.0f));
+            auto b = static_cast<uint16_t>(std::lround(color[2] * 31.0f / 255.0f));
+            return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+        }
+
+        std::array<float, 4> unpackRgb565(uint16_t packed) {
+            uint32_t r = (packed >> 11) & 31;
+            uint32_t g = (packed >> 5) & 63;
+            uint32_t b = packed & 31;
+            return {static_cast<float>((r << 3) | (r >> 2)), static_cast<float>((g << 2) | (g >> 4)),
+                    static_cast<float>((b << 3) | (b >> 2)), 255.0f};
+        }
+
+        void encodeBC1(const Block &block, uint8_t *out) {
+            std::array<float, 4> low{}, high{};
+            principalEndpoints(block, 3, low, high);
+
+            uint16_t color0 = packRgb565(high);
+            uint16_t color1 = packRgb565(low);
+            // color0 > color1 selects the four colour mode without punch-through alpha
+            if (color0 < color1) std::swap(color0, color1);
+
+            uint32_t indices = 0;
+            if (color0 != color1) {
+                std::array<std::array<float, 4>, 4> palette{};
+                palette[0] = unpackRgb565(color0);
+                palette[1] = unpackRgb565(color1);
+                for (uint32_t c = 0; c < 3; c++) {
+                    palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+                    palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+                }
+
+                for (uint32_t i = 0; i < BLOCK_PIXELS; i++) {
+                    uint32_t best = 0;
+                    float bestDistance = distance(block[i], palette[0], 3);
+                    for (uint32_t p = 1; p < 4; p++) {
+                        float d = distance(block[i], palette[p], 3);
+                        if (d < bestDistance) {
+                            bestDistance = d;
+                            best = p;
+                        }
+                    }
+                    indices |= best << (i * 2);
+                }
+            }
+
+            out[0] = static_cast<uint8_t>(color0 & 0xff);
+            out[1] = static_cast<uint8_t>(color0 >> 8);
+            out[2] = static_cast<uint8_t>(color1 & 0xff);
+            out[3] = static_cast<uint8_t>(color1 >> 8);
+            std::memcpy(out + 4, &indices, sizeof(indices));
+        }
+
+        // BC4 style alpha block as used by BC3, always in the eight value mode
+        void encodeAlpha(const Block &block, uint8_t *out) {
+            float minAlpha = 255.0f;
+            float maxAlpha = 0.0f;
+            for (const auto &pixel : block) {
+                minAlpha = std::min(minAlpha, pixel[3]);
+                maxAlpha = std::max(maxAlpha, pixel[3]);
+            }
+
+            auto alpha0 = static_cast<uint8_t>(std::lround(maxAlpha));
+            auto alpha1 = static_cast<uint8_t>(std::lround(minAlpha));
+            out[0] = alpha0;
+            out[1] = alpha1;
+
+            uint64_t indices = 0;
+            if (alpha0 != alpha1) {
+                std::array<float, 8> palette{};
+                palette[0] = alpha0;
+                palette[1] = alpha1;
+                for (uint32_t i = 1; i < 7; i++) {
+                    palette[i + 1] = (static_cast<float>(7 - i) * alpha0 + static_cast<float>(i) * alpha1) / 7.0f;
+                }
+
+                for (uint32_t i = 0; i < BLOCK_PIXELS; i++) {
+                    uint64_t best = 0;
+                    float bestDistance = std::abs(block[i][3] - palette[0]);
+                    for (uint32_t p = 1; p < 8; p++) {
+                        float d = std::abs(block[i][3] - palette[p]);
+                        if (d < bestDistance) {
+                            bestDistance = d;
+                            best = p;
+                        }
+                    }
+                    indices |= best << (i * 3);
+                }
+            }
+
+            for (uint32_t i = 0; i < 6; i++) {
+                out[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+            }
+        }
+
+        void encodeBC3(const Block &block, uint8_t *out) {
+            encodeAlpha(block, out);
+            encodeBC1(block, out + 8);
+        }
+
+        class BitWriter {
+        public:
+            explicit BitWriter(uint8_t *out) : m_out(out) { std::memset(m_out, 0, 16); }
+
+            void write(uint32_t value, uint32_t bits) {
+                for (uint32_t i = 0; i < bits; i++, m_position++) {
+                    if (value & (1u << i)) m_out[m_position / 8] |= static_cast<uint8_t>(1u << (m_position % 8));
+                }
+            }
+
+        private:
+            uint8_t *m_out;
+            uint32_t m_position{0};
+        };
+
+        // rounds an end point to 7 bits per channel plus the p-bit shared by its channels
+        void quantizeBC7Endpoint(const std::array<float, 4> &endpoint, std::array<uint32_t, 4> &quantized,
+                                 uint32_t &pBit) {
+            float bestError = -1.0f;
+            for (uint32_t p = 0; p < 2; p++) {
+                std::array<uint32_t, 4> candidate{};
+                float error = 0.0f;
+                for (uint32_t c = 0; c < 4; c++) {
+                    float value = std::round((endpoint[c] - static_cast<float>(p)) / 2.0f);
+                    candidate[c] = static_cast<uint32_t>(std::clamp(value, 0.0f, 127.0f));
+                    float decoded = static_cast<float>((candidate[c] << 1) | p);
+                    error += (decoded - endpoint[c]) * (decoded - endpoint[c]);
+                }
+                if (bestError < 0.0f || error < bestError) {
+                    bestError = error;
+                    quantized = candidate;
+                    pBit = p;
+                }
+            }
+        }
+
+        void encodeBC7(const Block &block, uint8_t *out) {
+            static constexpr std::array<uint32_t, 16> WEIGHTS{0, 4, 9, 13, 17, 21, 26, 30,
+                                                              34, 38, 43, 47, 51, 55, 60, 64};
+
+            std::array<float, 4> low{}, high{};
+            principalEndpoints(block, 4, low, high);
+
+            std::array<std::array<uint32_t, 4>, 2> endpoints{};
+            std::array<uint32_t, 2> pBits{};
+            quantizeBC7Endpoint(low, endpoints[0], pBits[0]);
+            quantizeBC7Endpoint(high, endpoints[1], pBits[1]);
+
+            std::array<std::array<float, 4>, 16> palette{};
+            for (uint32_t w = 0; w < 16; w++) {
+                for (uint32_t c = 0; c < 4; c++) {
+                    uint32_t e0 = (endpoints[0][c] << 1) | pBits[0];
+                    uint32_t e1 = (endpoints[1][c] << 1) | pBits[1];
+                    palette[w][c] = static_cast<float>(((64 - WEIGHTS[w]) * e0 + WEIGHTS[w] * e1 + 32) >> 6);
+                }
+            }
+
+            std::array<uint32_t, BLOCK_PIXELS> indices{};
+            for (uint32_t i = 0; i < BLOCK_PIXELS; i++) {
+                float bestDistance = distance(block[i], palette[0], 4);
+                for (uint32_t p = 1; p < 16; p++) {
+                    float d = distance(block[i], palette[p], 4);
+                    if (d < bestDistance) {
+                        bestDistance = d;
+                        indices[i] = p;
+                    }
+                }
+            }
+
+            // the anchor index is stored without its top bit, which therefore has to be zero
+            if (indices[0] & 8) {
+                std::swap(endpoints[0], endpoints[1]);
+                std::swap(pBits[0], pBits[1]);
+                for (auto &index : indices) index = 15 - index;
+            }
+
+            BitWriter writer{out};
+            writer.write(1u << 6, 7);
+            for (uint32_t c = 0; c < 4; c++) {
+                writer.write(endpoints[0][c], 7);
+                writer.write(endpoints[1][c], 7);
+            }
+            writer.write(pBits[0], 1);
+            writer.write(pBits[1], 1);
+            writer.write(indices[0], 3);
+            for (uint32_t i = 1; i < BLOCK_PIXELS; i++) {
+                writer.write(indices[i], 4);
+            }
+        }
+
+    } // namespace
+
+    VkFormat codecFormat(TextureCodec codec, bool srgb) {
+        switch (codec) {
+            case TextureCodec::BC1:
+                return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+            case TextureCodec::BC3:
+                return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+            case TextureCodec::BC7:
+                return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+        }
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    uint32_t codecBlockSize(TextureCodec codec) {
+        return codec == TextureCodec::BC1 ? 8 : 16;
+    }
+
+    VkDeviceSize compressedSize(TextureCodec codec, uint32_t width, uint32_t height) {
+        VkDeviceSize blocksX = (width + 3) / 4;
+        VkDeviceSize blocksY = (height + 3) / 4;
+        return blocksX * blocksY * codecBlockSize(codec);
+    }
+
+    std::vector<uint8_t> compressImage(TextureCodec codec, const uint8_t *pixels, uint32_t width, uint32_t height) {
+        uint32_t blocksX = (width + 3) / 4;
+        uint32_t blocksY = (height + 3) / 4;
+        uint32_t blockSize = codecBlockSize(codec);
+        std::vector<uint8_t> out(compressedSize(codec, width, height));
+
+        auto encodeRows = [&](uint32_t firstRow, uint32_t lastRow) {
+            Block block{};
+            for (uint32_t by = firstRow; by < lastRow; by++) {
+                for (uint32_t bx = 0; bx < blocksX; bx++) {
+                    fetchBlock(pixels, width, height, bx, by, block);
+                    uint8_t *dst = out.data() + (static_cast<size_t>(by) * blocksX + bx) * blockSize;
+                    switch (codec) {
+                        case TextureCodec::BC1:
+                            encodeBC1(block, dst);
+                            break;
+                        case TextureCodec::BC3:
+                            encodeBC3(block, dst);
+                            break;
+                        case TextureCodec::BC7:
+                            encodeBC7(block, dst);
+                            break;
+                    }
+                }
+            }
+        };
+
+        uint32_t workerCount = std::max(1u, std::min(std::thread::hardware_concurrency(), blocksY));
+        uint32_t rowsPerWorker = (blocksY + workerCount - 1) / workerCount;
+
+        std::vector<std::thread> workers;
+        for (uint32_t first = rowsPerWorker; first < blocksY; first += rowsPerWorker) {
+            workers.emplace_back(encodeRows, first, std::min(first + rowsPerWorker, blocksY));
+        }
+        encodeRows(0, std::min(rowsPerWorker, blocksY));
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        return out;
+    }
+
+} // namespace engine
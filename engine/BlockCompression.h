@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace engine {
+
+    enum class TextureCodec : uint32_t {
+        // opaque colour, 8 bytes per 4x4 block
+        BC1,
+        // colour plus interpolated alpha, 16 bytes per block
+        BC3,
+        // single subset mode 6, higher quality colour and alpha, 16 bytes per block
+        BC7,
+    };
+
+    VkFormat codecFormat(TextureCodec codec, bool srgb);
+
+    uint32_t codecBlockSize(TextureCodec codec);
+
+    // size of the encoded image, partial blocks at the edges are rounded up
+    VkDeviceSize compressedSize(TextureCodec codec, uint32_t width, uint32_t height);
+
+    // Encodes RGBA8 pixels into 4x4 blocks, rows of blocks are spread over
+    // std::thread::hardware_concurrency() workers. Pixels outside of the image
+    // repeat the last row/column.
+    std::vector<uint8_t> compressImage(TextureCodec codec, const uint8_t *pixels, uint32_t width, uint32_t height);
+
+} // namespace engine
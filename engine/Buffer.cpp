@@ -27,6 +27,7 @@ namespace engine {
             uint32_t instanceCount,
             VkBufferUsageFlags usageFlags,
             VkMemoryPropertyFlags memoryPropertyFlags,
+            MemoryTag tag,
             VkDeviceSize minOffsetAlignment)
             : _device{device}, _instanceSize{instanceSize},
           _instanceCount{instanceCount}, _usageFlags{usageFlags},
@@ -34,18 +35,20 @@ namespace engine {
         _alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
         _bufferSize = _alignmentSize * instanceCount;
         device.createBuffer(_bufferSize, usageFlags, memoryPropertyFlags,
-                            _buffer, _memory);
+                            _buffer, _memory, tag);
     }
 
     Buffer::~Buffer() {
         unmap();
-        vkDeviceWaitIdle(_device.device());
-        vkDestroyBuffer(_device.device(), _buffer, nullptr);
-        vkFreeMemory(_device.device(), _memory, nullptr);
+        _device.deletionQueue().push([&device = _device, buffer = _buffer, memory = _memory]() mutable {
+            vkDestroyBuffer(device.device(), buffer, nullptr);
+            device.freeMemory(memory);
+        });
     }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
+ * Host visible memory is persistently mapped by the allocator, so this only hands out the pointer.
  *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
@@ -54,21 +57,21 @@ namespace engine {
  * @return VkResult of the buffer mapping call
  */
     VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
-        assert(_buffer && _memory && "Called map on buffer before create");
-        return vkMapMemory(_device.device(), _memory, offset, size, 0, &_mapped);
+        assert(_buffer && _memory.memory && "Called map on buffer before create");
+        if (!_memory.mapped) {
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        }
+        _mapped = static_cast<char *>(_memory.mapped) + offset;
+        return VK_SUCCESS;
     }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory cant fail
- * @note Does not return a result as vkUnmapMemory cant fail
+ * @note The memory block stays mapped until the allocator releases it
  */
     void Buffer::unmap() {
-        if (_mapped) {
-            vkUnmapMemory(_device.device(), _memory);
-            _mapped = nullptr;
-        }
+        _mapped = nullptr;
     }
 
 /**
@@ -104,12 +107,7 @@ namespace engine {
  * @return VkResult of the flush call
  */
     VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = _memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkFlushMappedMemoryRanges(_device.device(), 1, &mappedRange);
+        return _device.allocator().flush(_memory, size, offset);
     }
 
 /**
@@ -124,12 +122,7 @@ namespace engine {
  * @return VkResult of the invalidate call
  */
     VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = _memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkInvalidateMappedMemoryRanges(_device.device(), 1, &mappedRange);
+        return _device.allocator().invalidate(_memory, size, offset);
     }
 
 /**
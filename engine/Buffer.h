@@ -12,6 +12,7 @@ namespace engine {
                 uint32_t instanceCount,
                 VkBufferUsageFlags usageFlags,
                 VkMemoryPropertyFlags memoryPropertyFlags,
+                MemoryTag tag,
                 VkDeviceSize minOffsetAlignment = 1);
 
         ~Buffer();
@@ -69,7 +70,7 @@ namespace engine {
         Device &_device;
         void *_mapped = nullptr;
         VkBuffer _buffer = VK_NULL_HANDLE;
-        VkDeviceMemory _memory = VK_NULL_HANDLE;
+        Allocation _memory{};
 
         VkDeviceSize _bufferSize;
         uint32_t _instanceCount;
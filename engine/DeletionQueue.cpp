@@ -0,0 +1,60 @@
+#include "DeletionQueue.h"
+
+#include <utility>
+#include <vector>
+
+namespace engine {
+
+    DeletionQueue::~DeletionQueue() {
+        flush();
+    }
+
+    void DeletionQueue::push(std::function<void()> &&destroy) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_entries.push_back({m_frame, std::move(destroy)});
+    }
+
+    void DeletionQueue::beginFrame(uint32_t framesInFlight) {
+        std::vector<std::function<void()>> ready;
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_frame++;
+            while (!m_entries.empty() && m_entries.front().frame + framesInFlight <= m_frame) {
+                ready.push_back(std::move(m_entries.front().destroy));
+                m_entries.pop_front();
+            }
+        }
+
+        // run outside the lock, destroying one object may queue another
+        for (auto &destroy : ready) {
+            destroy();
+        }
+    }
+
+    void DeletionQueue::flush() {
+        while (true) {
+            std::deque<Entry> entries;
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                entries.swap(m_entries);
+            }
+            if (entries.empty()) {
+                return;
+            }
+            for (auto &entry : entries) {
+                entry.destroy();
+            }
+        }
+    }
+
+    uint64_t DeletionQueue::frame() const {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_frame;
+    }
+
+    size_t DeletionQueue::size() const {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_entries.size();
+    }
+
+} // namespace engine
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace engine {
+
+    // Destroys GPU objects once the frames that may still reference them have
+    // finished. Entries are tagged with the frame that was being recorded when they
+    // were queued and run when the renderer reuses that frame's fence, so freeing a
+    // resource never has to drain the queue.
+    class DeletionQueue {
+    public:
+        DeletionQueue() = default;
+
+        ~DeletionQueue();
+
+        DeletionQueue(const DeletionQueue &) = delete;
+
+        DeletionQueue &operator=(const DeletionQueue &) = delete;
+
+        void push(std::function<void()> &&destroy);
+
+        // called after the fence of the frame slot about to be recorded has signaled,
+        // runs everything queued framesInFlight or more frames ago
+        void beginFrame(uint32_t framesInFlight);
+
+        // runs everything, the device has to be idle
+        void flush();
+
+        [[nodiscard]] uint64_t frame() const;
+
+        [[nodiscard]] size_t size() const;
+
+    private:
+        struct Entry {
+            uint64_t frame;
+            std::function<void()> destroy;
+        };
+
+        mutable std::mutex m_mutex;
+        std::deque<Entry> m_entries;
+        uint64_t m_frame{0};
+    };
+
+} // namespace engine
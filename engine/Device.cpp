@@ -1,7 +1,9 @@
 #include "Device.h"
 
 // std headers
+#include <chrono>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <optional>
 #include <set>
@@ -45,25 +47,53 @@ namespace engine {
     }
 
 // class member functions
-    Device::Device(Window &window) : window{window} {
+    Device::Device(Window &window) : window_{&window} {
+        deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        init();
+    }
+
+    Device::Device() {
+        init();
+    }
+
+    void Device::init() {
         createInstance();
         setupDebugMessenger();
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
+        allocator_ = std::make_unique<MemoryAllocator>(physicalDevice_, device_);
         createCommandPool();
+        uploadQueue_ = std::make_unique<UploadQueue>(*this);
+        createPipelineCache();
     }
 
     Device::~Device() {
+        uploadQueue_.reset();
         vkDeviceWaitIdle(device_);
+        deletionQueue_.flush();
+        savePipelineCache();
+        vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
         vkDestroyCommandPool(device_, commandPool, nullptr);
+        allocator_->printStats(std::cout);
+        // everything that allocated through this device should be gone by now
+        for (uint32_t tag = 0; tag < static_cast<uint32_t>(MemoryTag::Count); tag++) {
+            auto counters = MemoryTracker::counters(MemoryDomain::Device, static_cast<MemoryTag>(tag));
+            if (counters.count > 0) {
+                std::cerr << "leaked " << counters.count << " " << memoryTagName(static_cast<MemoryTag>(tag))
+                          << " allocations, " << counters.bytes / 1024 << " KiB" << std::endl;
+            }
+        }
+        allocator_.reset();
         vkDestroyDevice(device_, nullptr);
 
         if (enableValidationLayers) {
             DestroyDebugUtilsMessengerEXT(instance_, debugMessenger, nullptr);
         }
 
-        vkDestroySurfaceKHR(instance_, surface_, nullptr);
+        if (surface_ != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(instance_, surface_, nullptr);
+        }
         vkDestroyInstance(instance_, nullptr);
     }
 
@@ -131,6 +161,18 @@ namespace engine {
 
         vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
         std::cout << "physical device: " << properties.deviceName << std::endl;
+
+        // optional, the memory panel falls back to heap sizes and the allocator's usage
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(physicalDevice_, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice_, nullptr, &extensionCount, extensions.data());
+        for (const auto &extension : extensions) {
+            if (std::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+                deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+                memoryBudget_ = true;
+            }
+        }
     }
 
     void Device::createLogicalDevice() {
@@ -139,6 +181,9 @@ namespace engine {
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily,
                                                   indices.presentFamily};
+        if (indices.transferFamilyHasValue) {
+            uniqueQueueFamilies.insert(indices.transferFamily);
+        }
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily: uniqueQueueFamilies) {
@@ -150,10 +195,18 @@ namespace engine {
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice_, &supportedFeatures);
+
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
         deviceFeatures.fillModeNonSolid = VK_TRUE;
         deviceFeatures.geometryShader = VK_TRUE;
+        // cooked textures are BC compressed, without support the source images are used
+        deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+        // per pass statistics in the GPU profiler, timestamps don't need a feature
+        deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+        enabledFeatures = deviceFeatures;
 
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -180,6 +233,10 @@ namespace engine {
 
         vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
         vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+        if (indices.transferFamilyHasValue) {
+            vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+            std::cout << "transfer queue family: " << indices.transferFamily << std::endl;
+        }
     }
 
     void Device::createCommandPool() {
@@ -197,8 +254,80 @@ namespace engine {
         }
     }
 
+    void Device::createPipelineCache() {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::vector<char> data;
+        std::ifstream file{pipelineCachePath, std::ios::ate | std::ios::binary};
+        if (file.is_open()) {
+            data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(data.data(), static_cast<std::streamsize>(data.size()));
+        }
+
+        // a cache written by another driver or gpu is rejected by the header check
+        // instead of being handed to the driver
+        if (!data.empty() && !isPipelineCacheCompatible(data)) {
+            std::cout << "pipeline cache: discarding incompatible " << pipelineCachePath << std::endl;
+            data.clear();
+        }
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = data.size();
+        cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+        if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+
+        auto elapsed = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "pipeline cache: loaded " << data.size() << " bytes in " << elapsed << " ms" << std::endl;
+    }
+
+    bool Device::isPipelineCacheCompatible(const std::vector<char> &data) const {
+        VkPipelineCacheHeaderVersionOne header{};
+        if (data.size() < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        return header.headerSize >= sizeof(header) &&
+               header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+               header.vendorID == properties.vendorID &&
+               header.deviceID == properties.deviceID &&
+               std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    void Device::savePipelineCache() {
+        if (pipelineCache_ == VK_NULL_HANDLE) {
+            return;
+        }
+
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device_, pipelineCache_, &size, nullptr) != VK_SUCCESS || size == 0) {
+            return;
+        }
+
+        std::vector<char> data(size);
+        if (vkGetPipelineCacheData(device_, pipelineCache_, &size, data.data()) != VK_SUCCESS) {
+            return;
+        }
+
+        std::ofstream file{pipelineCachePath, std::ios::binary | std::ios::trunc};
+        if (!file.is_open()) {
+            std::cerr << "pipeline cache: failed to write " << pipelineCachePath << std::endl;
+            return;
+        }
+        file.write(data.data(), static_cast<std::streamsize>(size));
+        std::cout << "pipeline cache: saved " << size << " bytes" << std::endl;
+    }
+
     void Device::createSurface() {
-        window.createWindowSurface(instance_, &surface_);
+        if (window_) {
+            window_->createWindowSurface(instance_, &surface_);
+        }
     }
 
     bool Device::isDeviceSuitable(VkPhysicalDevice device) {
@@ -206,8 +335,8 @@ namespace engine {
 
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
-        if (extensionsSupported) {
+        bool swapChainAdequate = headless();
+        if (extensionsSupported && !headless()) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() &&
                                 !swapChainSupport.presentModes.empty();
@@ -270,12 +399,14 @@ namespace engine {
     }
 
     std::vector<const char *> Device::getRequiredExtensions() {
-        uint32_t glfwExtensionCount = 0;
-        const char **glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-        std::vector<const char *> extensions(glfwExtensions,
-                                             glfwExtensions + glfwExtensionCount);
+        // GLFW is never initialized without a window and only knows the surface extensions
+        std::vector<const char *> extensions;
+        if (window_) {
+            uint32_t glfwExtensionCount = 0;
+            const char **glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -349,7 +480,12 @@ namespace engine {
                 indices.graphicsFamilyHasValue = true;
             }
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+            if (surface_ != VK_NULL_HANDLE) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+            } else {
+                // nothing is presented, the graphics family doubles as the present family
+                presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+            }
             if (queueFamily.queueCount > 0 && presentSupport) {
                 indices.presentFamily = i;
                 indices.presentFamilyHasValue = true;
@@ -361,6 +497,21 @@ namespace engine {
             i++;
         }
 
+        // a family with transfer but no graphics support is backed by the copy
+        // engines, only take it if it can copy images at texel granularity
+        for (uint32_t family = 0; family < queueFamilyCount; family++) {
+            const auto &queueFamily = queueFamilies[family];
+            VkExtent3D granularity = queueFamily.minImageTransferGranularity;
+            if (queueFamily.queueCount > 0 &&
+                (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+                granularity.width == 1 && granularity.height == 1 && granularity.depth == 1) {
+                indices.transferFamily = family;
+                indices.transferFamilyHasValue = true;
+                break;
+            }
+        }
+
         return indices;
     }
 
@@ -408,6 +559,13 @@ namespace engine {
         throw std::runtime_error("failed to find supported format!");
     }
 
+    VkFormat Device::findDepthFormat() {
+        return findSupportedFormat(
+                {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT,
+                 VK_FORMAT_D24_UNORM_S8_UINT},
+                VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    }
+
     uint32_t Device::findMemoryType(uint32_t typeFilter,
                                     VkMemoryPropertyFlags properties) {
         VkPhysicalDeviceMemoryProperties memProperties;
@@ -424,7 +582,7 @@ namespace engine {
 
     void Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                               VkMemoryPropertyFlags properties, VkBuffer &buffer,
-                              VkDeviceMemory &bufferMemory) {
+                              Allocation &bufferMemory, MemoryTag tag) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
@@ -438,18 +596,11 @@ namespace engine {
         VkMemoryRequirements memRequirements;
         vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex =
-                findMemoryType(memRequirements.memoryTypeBits, properties);
+        bufferMemory = allocator_->allocate(memRequirements, properties, true);
+        bufferMemory.tag = tag;
+        MemoryTracker::add(MemoryDomain::Device, tag, bufferMemory.size);
 
-        if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) !=
-            VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate vertex buffer memory!");
-        }
-
-        vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+        vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset);
     }
 
     VkCommandBuffer Device::beginSingleTimeCommands() {
@@ -478,12 +629,27 @@ namespace engine {
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
 
-        vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue_);
+        // wait for this submission only instead of draining the whole queue
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence;
+        vkCreateFence(device_, &fenceInfo, nullptr, &fence);
+
+        {
+            std::lock_guard<std::mutex> lock{queueMutex_};
+            vkQueueSubmit(graphicsQueue_, 1, &submitInfo, fence);
+        }
+        vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX);
+        vkDestroyFence(device_, fence, nullptr);
 
         vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
     }
 
+    void Device::waitIdle() {
+        std::lock_guard<std::mutex> lock{queueMutex_};
+        vkDeviceWaitIdle(device_);
+    }
+
     void Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer,
                             VkDeviceSize size) {
         VkCommandBuffer commandBuffer = beginSingleTimeCommands();
@@ -526,30 +692,85 @@ namespace engine {
 
     void Device::createImageWithInfo(const VkImageCreateInfo &imageInfo,
                                      VkMemoryPropertyFlags properties,
-                                     VkImage &image, VkDeviceMemory &imageMemory) {
+                                     VkImage &image, Allocation &imageMemory, MemoryTag tag) {
         if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
             throw std::runtime_error("failed to create image!");
         }
 
-        VkMemoryRequirements memRequirements;
-        vkGetImageMemoryRequirements(device_, image, &memRequirements);
+        VkMemoryDedicatedRequirements dedicatedRequirements{};
+        dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex =
-                findMemoryType(memRequirements.memoryTypeBits, properties);
+        VkMemoryRequirements2 memRequirements{};
+        memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        memRequirements.pNext = &dedicatedRequirements;
 
-        if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) !=
-            VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate image memory!");
+        VkImageMemoryRequirementsInfo2 requirementsInfo{};
+        requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+        requirementsInfo.image = image;
+        vkGetImageMemoryRequirements2(device_, &requirementsInfo, &memRequirements);
+
+        // render targets and other images the driver wants on their own memory
+        // skip the block allocator
+        if (dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation) {
+            imageMemory = allocator_->allocateDedicated(memRequirements.memoryRequirements, properties, image);
+        } else {
+            imageMemory = allocator_->allocate(memRequirements.memoryRequirements, properties,
+                                               imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
         }
+        imageMemory.tag = tag;
+        MemoryTracker::add(MemoryDomain::Device, tag, imageMemory.size);
 
-        if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+        if (vkBindImageMemory(device_, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS) {
             throw std::runtime_error("failed to bind image memory!");
         }
     }
 
+    void Device::freeMemory(Allocation &allocation) {
+        if (allocation.memory != VK_NULL_HANDLE) {
+            MemoryTracker::remove(MemoryDomain::Device, allocation.tag, allocation.size);
+        }
+        allocator_->free(allocation);
+    }
+
+    std::vector<MemoryHeapInfo> Device::memoryHeaps() {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+        budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+        VkPhysicalDeviceMemoryProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties2.pNext = memoryBudget_ ? &budget : nullptr;
+        vkGetPhysicalDeviceMemoryProperties2(physicalDevice_, &properties2);
+        const VkPhysicalDeviceMemoryProperties &memory = properties2.memoryProperties;
+
+        std::vector<MemoryHeapInfo> heaps(memory.memoryHeapCount);
+        for (uint32_t i = 0; i < memory.memoryHeapCount; i++) {
+            heaps[i].size = memory.memoryHeaps[i].size;
+            heaps[i].deviceLocal = (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+            heaps[i].budget = memoryBudget_ ? budget.heapBudget[i] : heaps[i].size;
+            heaps[i].usage = memoryBudget_ ? budget.heapUsage[i] : 0;
+        }
+        if (!memoryBudget_) {
+            for (uint32_t type = 0; type < memory.memoryTypeCount; type++) {
+                heaps[memory.memoryTypes[type].heapIndex].usage += allocator_->stats(type).reservedBytes;
+            }
+        }
+        return heaps;
+    }
+
+    void Device::writeMemoryReport(std::ostream &out) {
+        MemoryTracker::writeReport(out);
+
+        out << "Memory heaps" << (memoryBudget_ ? "" : " (no VK_EXT_memory_budget, usage is the allocator's)")
+            << ":" << std::endl;
+        auto heaps = memoryHeaps();
+        for (size_t i = 0; i < heaps.size(); i++) {
+            out << "  heap " << i << (heaps[i].deviceLocal ? " device local: " : " host: ")
+                << heaps[i].usage / (1024 * 1024) << " / " << heaps[i].budget / (1024 * 1024) << " MiB budget, "
+                << heaps[i].size / (1024 * 1024) << " MiB total" << std::endl;
+        }
+        allocator_->printStats(out);
+    }
+
     uint32_t Device::graphicsQueueFamily() const {
         return 0;
     }
@@ -1,9 +1,16 @@
 #pragma once
 
+#include "DeletionQueue.h"
+#include "MemoryAllocator.h"
+#include "MemoryTracker.h"
+#include "UploadQueue.h"
 #include "Window.h"
 
 // std lib headers
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <ostream>
 #include <string>
 #include <vector>
 #include <functional>
@@ -19,12 +26,25 @@ namespace engine {
     struct QueueFamilyIndices {
         uint32_t graphicsFamily;
         uint32_t presentFamily;
+        // transfer only family, used for uploads when present
+        uint32_t transferFamily;
         bool graphicsFamilyHasValue = false;
         bool presentFamilyHasValue = false;
+        bool transferFamilyHasValue = false;
 
         bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
 
+    struct MemoryHeapInfo {
+        VkDeviceSize size;
+        // how much this process may use before performance suffers, the heap size
+        // without VK_EXT_memory_budget
+        VkDeviceSize budget;
+        // by this process, only what the allocator reserved without VK_EXT_memory_budget
+        VkDeviceSize usage;
+        bool deviceLocal;
+    };
+
     class Device {
     public:
 #ifdef NDEBUG
@@ -35,6 +55,11 @@ namespace engine {
 
         Device(Window &window);
 
+        // Headless, for benchmark runs and CI: there is no surface, nothing can be
+        // presented and the swap chain extension isn't required, so software
+        // implementations like lavapipe qualify.
+        Device();
+
         ~Device();
 
         // Not copyable or movable
@@ -52,14 +77,33 @@ namespace engine {
 
         VkSurfaceKHR surface() { return surface_; }
 
+        bool headless() const { return window_ == nullptr; }
+
         VkQueue graphicsQueue() { return graphicsQueue_; }
 
         VkQueue presentQueue() { return presentQueue_; }
 
+        VkQueue transferQueue() { return transferQueue_; }
+
+        // guards submissions to the queues above, uploads may be submitted from loader threads
+        std::mutex &queueMutex() { return queueMutex_; }
+
+        // vkDeviceWaitIdle needs every queue externally synchronized, so it holds queueMutex
+        void waitIdle();
+
         VkPhysicalDevice physicalDevice() { return physicalDevice_; }
 
         VkInstance instance() { return instance_; }
 
+        VkPipelineCache pipelineCache() { return pipelineCache_; }
+
+        MemoryAllocator &allocator() { return *allocator_; }
+
+        UploadQueue &uploads() { return *uploadQueue_; }
+
+        // for handles that may still be referenced by frames in flight
+        DeletionQueue &deletionQueue() { return deletionQueue_; }
+
         SwapChainSupportDetails getSwapChainSupport() {
             return querySwapChainSupport(physicalDevice_);
         }
@@ -75,10 +119,12 @@ namespace engine {
                                      VkImageTiling tiling,
                                      VkFormatFeatureFlags features);
 
+        VkFormat findDepthFormat();
+
         // Buffer Helper Functions
         void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                           VkMemoryPropertyFlags properties, VkBuffer &buffer,
-                          VkDeviceMemory &bufferMemory);
+                          Allocation &bufferMemory, MemoryTag tag);
 
         VkCommandBuffer beginSingleTimeCommands();
 
@@ -92,15 +138,30 @@ namespace engine {
 
         void createImageWithInfo(const VkImageCreateInfo &imageInfo,
                                  VkMemoryPropertyFlags properties, VkImage &image,
-                                 VkDeviceMemory &imageMemory);
+                                 Allocation &imageMemory, MemoryTag tag);
+
+        // returns memory from createBuffer/createImageWithInfo to the allocator
+        void freeMemory(Allocation &allocation);
+
+        bool memoryBudgetSupported() const { return memoryBudget_; }
+
+        // current budget and usage of every memory heap
+        std::vector<MemoryHeapInfo> memoryHeaps();
+
+        // memory per tag, heap budgets and allocator blocks
+        void writeMemoryReport(std::ostream &out);
 
 
         VkPhysicalDeviceProperties properties;
+        // features the logical device was created with
+        VkPhysicalDeviceFeatures enabledFeatures{};
 
         uint32_t graphicsQueueFamily() const;
 
 
     private:
+        void init();
+
         void createInstance();
 
         void setupDebugMessenger();
@@ -113,6 +174,12 @@ namespace engine {
 
         void createCommandPool();
 
+        void createPipelineCache();
+
+        void savePipelineCache();
+
+        bool isPipelineCacheCompatible(const std::vector<char> &data) const;
+
         // helper functions
         bool isDeviceSuitable(VkPhysicalDevice device);
 
@@ -134,19 +201,28 @@ namespace engine {
         VkInstance instance_;
         VkDebugUtilsMessengerEXT debugMessenger;
         VkPhysicalDevice physicalDevice_ = VK_NULL_HANDLE;
-        Window &window;
+        Window *window_ = nullptr;
         VkCommandPool commandPool;
 
         VkDevice device_;
-        VkSurfaceKHR surface_;
+        VkSurfaceKHR surface_ = VK_NULL_HANDLE;
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
+        VkQueue transferQueue_ = VK_NULL_HANDLE;
+        std::mutex queueMutex_;
+        VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+        std::unique_ptr<MemoryAllocator> allocator_;
+        std::unique_ptr<UploadQueue> uploadQueue_;
+        DeletionQueue deletionQueue_;
+        // VK_EXT_memory_budget is enabled
+        bool memoryBudget_ = false;
+
+        const std::string pipelineCachePath = "pipeline_cache.bin";
 
         const std::vector<const char *> validationLayers = {
                 "VK_LAYER_KHRONOS_validation"};
-        const std::vector<const char *> deviceExtensions = {
-                VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-                };
+        // the swap chain extension is added when there is a window
+        std::vector<const char *> deviceExtensions;
     };
 
 
@@ -0,0 +1,60 @@
+#include "FrameAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace engine {
+
+    FrameAllocator::FrameAllocator(Device &device, uint32_t framesInFlight, VkDeviceSize frameSize)
+            : m_frameSize{frameSize} {
+        const auto &limits = device.properties.limits;
+        m_uniformAlignment = std::max(limits.minUniformBufferOffsetAlignment,
+                                      limits.minStorageBufferOffsetAlignment);
+
+        m_buffer = std::make_unique<Buffer>(device, m_frameSize, framesInFlight,
+                                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                            VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                            MemoryTag::Uniforms,
+                                            m_uniformAlignment);
+        m_buffer->map();
+        // the buffer pads each region to the alignment, so regions start aligned
+        m_frameSize = m_buffer->getBufferSize() / framesInFlight;
+    }
+
+    void FrameAllocator::beginFrame(uint32_t frameIndex) {
+        m_frameBegin = m_frameSize * frameIndex;
+        m_head = m_frameBegin;
+        m_flushed = m_frameBegin;
+    }
+
+    void FrameAllocator::flush() {
+        if (m_head > m_flushed) {
+            m_buffer->flush(m_head - m_flushed, m_flushed);
+            m_flushed = m_head;
+        }
+    }
+
+    FrameAllocation FrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+        VkDeviceSize offset = (m_head + alignment - 1) / alignment * alignment;
+        if (offset + size > m_frameBegin + m_frameSize) {
+            throw std::runtime_error("frame allocator out of memory, raise the frame size!");
+        }
+        m_head = offset + size;
+        m_peak = std::max(m_peak, m_head - m_frameBegin);
+
+        FrameAllocation allocation{};
+        allocation.buffer = m_buffer->getBuffer();
+        allocation.offset = offset;
+        allocation.size = size;
+        allocation.data = static_cast<char *>(m_buffer->getMappedMemory()) + offset;
+        return allocation;
+    }
+
+    VkDescriptorBufferInfo FrameAllocator::descriptorInfo(VkDeviceSize range) const {
+        return {m_buffer->getBuffer(), 0, range};
+    }
+
+} // namespace engine
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Buffer.h"
+#include "Device.h"
+
+#include <cstring>
+#include <memory>
+
+namespace engine {
+
+    // A sub-range of the current frame's region, valid until the same frame slot
+    // comes around again
+    struct FrameAllocation {
+        VkBuffer buffer{VK_NULL_HANDLE};
+        VkDeviceSize offset{0};
+        VkDeviceSize size{0};
+        void *data{nullptr};
+
+        // for descriptors of type *_DYNAMIC, which are written once with offset 0
+        [[nodiscard]] uint32_t dynamicOffset() const { return static_cast<uint32_t>(offset); }
+    };
+
+    // Linear allocator over one persistently mapped buffer split into a region per
+    // frame in flight. Uniforms, instance data and debug geometry that only live for
+    // a frame are bump allocated from it and bound with dynamic offsets, so adding
+    // per-frame data needs neither new Buffers nor descriptor writes. A region is
+    // reset in beginFrame, after the renderer waited for that frame's fence.
+    class FrameAllocator {
+    public:
+        static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 4ull * 1024 * 1024;
+
+        FrameAllocator(Device &device, uint32_t framesInFlight, VkDeviceSize frameSize = DEFAULT_FRAME_SIZE);
+
+        FrameAllocator(const FrameAllocator &) = delete;
+
+        FrameAllocator &operator=(const FrameAllocator &) = delete;
+
+        void beginFrame(uint32_t frameIndex);
+
+        // makes the host writes of the current frame visible, called before submit
+        void flush();
+
+        FrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+        FrameAllocation allocateUniform(VkDeviceSize size) { return allocate(size, m_uniformAlignment); }
+
+        template<typename T>
+        FrameAllocation pushUniform(const T &value) {
+            FrameAllocation allocation = allocateUniform(sizeof(T));
+            std::memcpy(allocation.data, &value, sizeof(T));
+            return allocation;
+        }
+
+        // range for a dynamic uniform/storage buffer descriptor that covers one allocation
+        [[nodiscard]] VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) const;
+
+        [[nodiscard]] VkBuffer buffer() const { return m_buffer->getBuffer(); }
+
+        [[nodiscard]] VkDeviceSize frameSize() const { return m_frameSize; }
+
+        [[nodiscard]] VkDeviceSize used() const { return m_head - m_frameBegin; }
+
+        [[nodiscard]] VkDeviceSize peakUsage() const { return m_peak; }
+
+    private:
+        std::unique_ptr<Buffer> m_buffer;
+        VkDeviceSize m_frameSize;
+        VkDeviceSize m_uniformAlignment;
+
+        VkDeviceSize m_frameBegin{0};
+        VkDeviceSize m_head{0};
+        VkDeviceSize m_flushed{0};
+        VkDeviceSize m_peak{0};
+    };
+
+} // namespace engine
@@ -3,6 +3,7 @@
 
 #include <vulkan/vulkan.h>
 
+#include "FrameAllocator.h"
 #include "ResourceManager.h"
 #include "Structure.h"
 #include <entt/entt.hpp>
@@ -26,8 +27,19 @@ namespace engine {
         float dt;
         VkCommandBuffer commandBuffer;
         std::vector<VkDescriptorSet> descriptorSets;
+        // one per dynamic binding in descriptorSets, in set and binding order
+        std::vector<uint32_t> dynamicOffsets;
         const std::vector<std::optional<Structure>> &structures;
         ResourceManager &resourceManager;
+        FrameAllocator &frameAllocator;
+        // render systems pick mesh LODs from these, see Model::SelectLod, and cull
+        // meshlets against the view frustum, see makeCullView
+        glm::vec3 cameraPosition{0.0f};
+        float projectionScale{0.0f};
+        glm::mat4 viewProjection{1.0f};
+        // one entry per structure when culling ran, 0 where it is hidden behind
+        // occluders, null when occlusion culling is off
+        const std::vector<uint8_t> *structureVisibility{nullptr};
     };
 }
 
@@ -0,0 +1,202 @@
+#include "GpuProfiler.h"
+
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace engine {
+
+    namespace {
+        // results are written in the order of the flag bits
+        constexpr VkQueryPipelineStatisticFlags STATISTICS =
+                VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+                VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+                VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+    } // namespace
+
+    const char *GpuPassTiming::statisticName(uint32_t statistic) {
+        static constexpr const char *names[STATISTIC_COUNT] = {
+                "inputVertices", "inputPrimitives", "vertexInvocations", "clippedPrimitives", "fragmentInvocations"};
+        assert(statistic < STATISTIC_COUNT && "Unknown pipeline statistic");
+        return names[statistic];
+    }
+
+    GpuProfiler::GpuProfiler(Device &device, uint32_t framesInFlight)
+            : m_device{device}, m_slots(framesInFlight) {
+        createPools();
+    }
+
+    GpuProfiler::~GpuProfiler() {
+        if (m_timestampPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(m_device.device(), m_timestampPool, nullptr);
+        }
+        if (m_statisticsPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(m_device.device(), m_statisticsPool, nullptr);
+        }
+    }
+
+    void GpuProfiler::createPools() {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(m_device.physicalDevice(), &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(m_device.physicalDevice(), &familyCount, families.data());
+
+        uint32_t validBits = families[m_device.graphicsQueueFamily()].timestampValidBits;
+        if (validBits == 0) {
+            std::cout << "gpu profiler: the graphics queue has no timestamps, GPU times are not measured" << std::endl;
+        } else {
+            m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+            m_timestampPeriod = m_device.properties.limits.timestampPeriod;
+
+            VkQueryPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            poolInfo.queryCount = timestampsPerSlot() * static_cast<uint32_t>(m_slots.size());
+            if (vkCreateQueryPool(m_device.device(), &poolInfo, nullptr, &m_timestampPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create timestamp query pool!");
+            }
+        }
+
+        if (m_device.enabledFeatures.pipelineStatisticsQuery) {
+            VkQueryPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            poolInfo.queryCount = MAX_PASSES * static_cast<uint32_t>(m_slots.size());
+            poolInfo.pipelineStatistics = STATISTICS;
+            if (vkCreateQueryPool(m_device.device(), &poolInfo, nullptr, &m_statisticsPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create pipeline statistics query pool!");
+            }
+        }
+    }
+
+    void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+        assert(frameIndex < m_slots.size() && "Frame index out of range");
+        read(frameIndex);
+
+        m_current = frameIndex;
+        m_inPass = false;
+        Slot &slot = m_slots[frameIndex];
+        slot.pending = true;
+        slot.frame = m_nextFrame++;
+        slot.passes.clear();
+
+        if (m_timestampPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(commandBuffer, m_timestampPool, frameIndex * timestampsPerSlot(), timestampsPerSlot());
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampPool,
+                                frameIndex * timestampsPerSlot());
+        }
+        if (m_statisticsPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(commandBuffer, m_statisticsPool, frameIndex * MAX_PASSES, MAX_PASSES);
+        }
+    }
+
+    void GpuProfiler::endFrame(VkCommandBuffer commandBuffer) {
+        assert(!m_inPass && "Frame ended inside a pass");
+        if (m_timestampPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampPool,
+                                m_current * timestampsPerSlot() + 1);
+        }
+    }
+
+    void GpuProfiler::beginPass(VkCommandBuffer commandBuffer, const std::string &name) {
+        assert(!m_inPass && "GPU profiler passes don't nest");
+        Slot &slot = m_slots[m_current];
+        if (slot.passes.size() >= MAX_PASSES) {
+            return;
+        }
+        auto pass = static_cast<uint32_t>(slot.passes.size());
+        slot.passes.push_back(name);
+        m_inPass = true;
+
+        if (m_timestampPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampPool,
+                                m_current * timestampsPerSlot() + 2 + 2 * pass);
+        }
+        if (m_statisticsPool != VK_NULL_HANDLE) {
+            vkCmdBeginQuery(commandBuffer, m_statisticsPool, m_current * MAX_PASSES + pass, 0);
+        }
+    }
+
+    void GpuProfiler::endPass(VkCommandBuffer commandBuffer) {
+        if (!m_inPass) {
+            return;
+        }
+        m_inPass = false;
+        auto pass = static_cast<uint32_t>(m_slots[m_current].passes.size() - 1);
+
+        if (m_statisticsPool != VK_NULL_HANDLE) {
+            vkCmdEndQuery(commandBuffer, m_statisticsPool, m_current * MAX_PASSES + pass);
+        }
+        if (m_timestampPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampPool,
+                                m_current * timestampsPerSlot() + 3 + 2 * pass);
+        }
+    }
+
+    void GpuProfiler::readAll() {
+        // oldest frame first, so the callback sees them in order
+        for (uint32_t i = 1; i <= m_slots.size(); i++) {
+            read((m_current + i) % static_cast<uint32_t>(m_slots.size()));
+        }
+    }
+
+    void GpuProfiler::read(uint32_t frameIndex) {
+        Slot &slot = m_slots[frameIndex];
+        if (!slot.pending) {
+            return;
+        }
+        slot.pending = false;
+
+        GpuFrameTiming timing{};
+        timing.frame = slot.frame;
+        timing.passes.resize(slot.passes.size());
+        for (size_t i = 0; i < slot.passes.size(); i++) {
+            timing.passes[i].name = slot.passes[i];
+        }
+
+        // no wait flag, the frame's fence was waited on and a result that still
+        // isn't available drops the frame instead of stalling
+        if (m_timestampPool != VK_NULL_HANDLE) {
+            uint32_t count = 2 + 2 * static_cast<uint32_t>(slot.passes.size());
+            m_results.resize(count);
+            if (vkGetQueryPoolResults(m_device.device(), m_timestampPool, frameIndex * timestampsPerSlot(), count,
+                                      count * sizeof(uint64_t), m_results.data(), sizeof(uint64_t),
+                                      VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+                return;
+            }
+            auto elapsedMs = [&](uint32_t first) {
+                uint64_t ticks = ((m_results[first + 1] & m_timestampMask) - (m_results[first] & m_timestampMask)) &
+                                 m_timestampMask;
+                return static_cast<float>(static_cast<double>(ticks) * m_timestampPeriod * 1e-6);
+            };
+            timing.ms = elapsedMs(0);
+            for (uint32_t i = 0; i < timing.passes.size(); i++) {
+                timing.passes[i].ms = elapsedMs(2 + 2 * i);
+            }
+        }
+
+        if (m_statisticsPool != VK_NULL_HANDLE && !slot.passes.empty()) {
+            auto count = static_cast<uint32_t>(slot.passes.size());
+            m_results.resize(count * GpuPassTiming::STATISTIC_COUNT);
+            if (vkGetQueryPoolResults(m_device.device(), m_statisticsPool, frameIndex * MAX_PASSES, count,
+                                      m_results.size() * sizeof(uint64_t), m_results.data(),
+                                      GpuPassTiming::STATISTIC_COUNT * sizeof(uint64_t),
+                                      VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+                return;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                for (uint32_t s = 0; s < GpuPassTiming::STATISTIC_COUNT; s++) {
+                    timing.passes[i].statistics[s] = m_results[i * GpuPassTiming::STATISTIC_COUNT + s];
+                }
+            }
+        }
+
+        m_lastFrame = std::move(timing);
+        if (m_callback) {
+            m_callback(m_lastFrame);
+        }
+    }
+
+} // namespace engine
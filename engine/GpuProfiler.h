@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Device.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace engine {
+
+    struct GpuPassTiming {
+        static constexpr uint32_t STATISTIC_COUNT = 5;
+
+        static const char *statisticName(uint32_t statistic);
+
+        std::string name;
+        float ms{0.0f};
+        // input vertices, input primitives, vertex shader invocations, clipped
+        // primitives and fragment shader invocations, zero without statistics support
+        uint64_t statistics[STATISTIC_COUNT]{};
+    };
+
+    struct GpuFrameTiming {
+        // number of the frame on the profiler, counted by beginFrame
+        uint64_t frame{0};
+        // first to last command of the frame
+        float ms{0.0f};
+        std::vector<GpuPassTiming> passes;
+    };
+
+    // Brackets the frame and the passes recorded in it with timestamp and, where
+    // the device supports them, pipeline statistics queries. Every frame in flight
+    // has its own range of queries, read back without waiting once the renderer
+    // has waited for that frame's fence, so results arrive framesInFlight frames
+    // late. Pass times start when the pass may begin, passes overlapping on the
+    // GPU add up to more than the frame.
+    class GpuProfiler {
+    public:
+        // passes beyond this many in a frame are not measured
+        static constexpr uint32_t MAX_PASSES = 32;
+
+        GpuProfiler(Device &device, uint32_t framesInFlight);
+
+        ~GpuProfiler();
+
+        GpuProfiler(const GpuProfiler &) = delete;
+
+        GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+        [[nodiscard]] bool timestampsSupported() const { return m_timestampPool != VK_NULL_HANDLE; }
+
+        [[nodiscard]] bool statisticsSupported() const { return m_statisticsPool != VK_NULL_HANDLE; }
+
+        // reads back what this frame slot recorded last time and resets its queries,
+        // the slot's fence must have been waited on
+        void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+        void endFrame(VkCommandBuffer commandBuffer);
+
+        // passes don't nest and are begun and ended outside of render passes
+        void beginPass(VkCommandBuffer commandBuffer, const std::string &name);
+
+        void endPass(VkCommandBuffer commandBuffer);
+
+        // number the next beginFrame will give its frame
+        [[nodiscard]] uint64_t nextFrame() const { return m_nextFrame; }
+
+        // the latest frame that was read back
+        [[nodiscard]] const GpuFrameTiming &lastFrame() const { return m_lastFrame; }
+
+        // called for every frame that is read back, in submission order
+        void setFrameCallback(std::function<void(const GpuFrameTiming &)> callback) {
+            m_callback = std::move(callback);
+        }
+
+        // reads back all frames still pending, the device has to be idle
+        void readAll();
+
+    private:
+        struct Slot {
+            bool pending{false};
+            uint64_t frame{0};
+            std::vector<std::string> passes;
+        };
+
+        void createPools();
+
+        void read(uint32_t frameIndex);
+
+        uint32_t timestampsPerSlot() const { return 2 + 2 * MAX_PASSES; }
+
+        Device &m_device;
+        std::vector<Slot> m_slots;
+        uint32_t m_current{0};
+        bool m_inPass{false};
+        uint64_t m_nextFrame{0};
+
+        VkQueryPool m_timestampPool{VK_NULL_HANDLE};
+        VkQueryPool m_statisticsPool{VK_NULL_HANDLE};
+        // nanoseconds per tick
+        float m_timestampPeriod{0.0f};
+        uint64_t m_timestampMask{0};
+
+        GpuFrameTiming m_lastFrame;
+        std::function<void(const GpuFrameTiming &)> m_callback;
+        std::vector<uint64_t> m_results;
+    };
+
+} // namespace engine
@@ -75,7 +75,7 @@ namespace engine {
         init_info.Device = device.device();
         init_info.QueueFamily = device.graphicsQueueFamily();
         init_info.Queue = device.graphicsQueue();
-        init_info.PipelineCache = VK_NULL_HANDLE;
+        init_info.PipelineCache = device.pipelineCache();
         init_info.DescriptorPool = descriptorPool;
         init_info.RenderPass = renderPass;
         init_info.Subpass = 0;
@@ -122,7 +122,7 @@ namespace engine {
     }
 
     void Imgui::removeTexture(VkDescriptorSet id) {
-        vkDeviceWaitIdle(mDevice.device());
+        mDevice.waitIdle();
         ImGui_ImplVulkan_RemoveTexture(id);
     }
 
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace engine {
+
+    // Read only view of a whole file through the virtual memory system, pages are
+    // faulted in as they are touched instead of being copied into a buffer first.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+
+        // throws std::runtime_error if the file cannot be opened or mapped
+        explicit MappedFile(const std::string &path);
+
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        MappedFile(MappedFile &&other) noexcept;
+
+        MappedFile &operator=(MappedFile &&other) noexcept;
+
+        // null for empty files
+        [[nodiscard]] const uint8_t *data() const { return m_data; }
+
+        [[nodiscard]] size_t size() const { return m_size; }
+
+    private:
+        void unmap();
+
+        const uint8_t *m_data{nullptr};
+        size_t m_size{0};
+#ifdef _WIN32
+        void *m_file{nullptr};
+        void *m_mapping{nullptr};
+#endif
+    };
+
+} // namespace engine
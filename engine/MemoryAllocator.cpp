@@ -0,0 +1,378 @@
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace engine {
+
+    MemoryAllocator::MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device) : m_device(device) {
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        m_nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+
+        m_dedicatedStats.resize(m_memoryProperties.memoryTypeCount);
+    }
+
+    MemoryAllocator::~MemoryAllocator() {
+        Stats total = stats();
+        if (total.allocationCount > 0) {
+            std::cerr << "MemoryAllocator: " << total.allocationCount << " allocations ("
+                      << total.usedBytes << " bytes) still alive at shutdown" << std::endl;
+        }
+
+        for (auto &pool : m_pools) {
+            for (auto &block : pool.blocks) {
+                if (block) {
+                    destroyBlock(*block);
+                }
+            }
+        }
+    }
+
+    uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+        for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) &&
+                (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    uint32_t MemoryAllocator::orderFor(VkDeviceSize size) {
+        uint32_t order = 0;
+        while ((MIN_ALLOCATION_SIZE << order) < size) {
+            order++;
+        }
+        return order;
+    }
+
+    Allocation MemoryAllocator::allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                                         bool linear) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+
+        uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+
+        int32_t poolIndex;
+        Pool &pool = getPool(memoryType, linear, poolIndex);
+
+        // buddy ranges are aligned to their own size, so rounding the size up to
+        // the alignment is enough to satisfy it
+        VkDeviceSize size = std::max(requirements.size, requirements.alignment);
+        if (size > pool.blockSize / 2) {
+            return createDedicated(requirements.size, memoryType, VK_NULL_HANDLE);
+        }
+
+        Allocation allocation{};
+        allocation.size = requirements.size;
+        allocation.memoryType = memoryType;
+        allocation.pool = poolIndex;
+        allocation.order = orderFor(size);
+
+        Block *target = nullptr;
+        int32_t emptySlot = -1;
+        for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+            auto &block = pool.blocks[i];
+            if (!block) {
+                emptySlot = emptySlot < 0 ? static_cast<int32_t>(i) : emptySlot;
+                continue;
+            }
+            if (allocateFromBlock(*block, allocation.order, allocation.offset)) {
+                target = block.get();
+                allocation.block = i;
+                break;
+            }
+        }
+
+        if (target == nullptr) {
+            auto block = createBlock(memoryType, pool.blockSize);
+            if (emptySlot < 0) {
+                emptySlot = static_cast<int32_t>(pool.blocks.size());
+                pool.blocks.push_back(nullptr);
+            }
+            pool.blocks[emptySlot] = std::move(block);
+            target = pool.blocks[emptySlot].get();
+            allocation.block = static_cast<uint32_t>(emptySlot);
+
+            if (!allocateFromBlock(*target, allocation.order, allocation.offset)) {
+                throw std::runtime_error("failed to sub-allocate from a fresh memory block!");
+            }
+        }
+
+        target->used += MIN_ALLOCATION_SIZE << allocation.order;
+        target->allocationCount++;
+
+        allocation.memory = target->memory;
+        if (target->mapped != nullptr) {
+            allocation.mapped = static_cast<char *>(target->mapped) + allocation.offset;
+        }
+        return allocation;
+    }
+
+    Allocation MemoryAllocator::allocateDedicated(const VkMemoryRequirements &requirements,
+                                                  VkMemoryPropertyFlags properties, VkImage image) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return createDedicated(requirements.size, findMemoryType(requirements.memoryTypeBits, properties), image);
+    }
+
+    Allocation MemoryAllocator::createDedicated(VkDeviceSize size, uint32_t memoryType, VkImage image) {
+        VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+        dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+        dedicatedInfo.image = image;
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.pNext = image != VK_NULL_HANDLE ? &dedicatedInfo : nullptr;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        Allocation allocation{};
+        if (vkAllocateMemory(m_device, &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate dedicated memory!");
+        }
+        allocation.size = size;
+        allocation.memoryType = memoryType;
+        allocation.mapped = mapMemory(allocation.memory, memoryType);
+
+        Stats &stats = m_dedicatedStats[memoryType];
+        stats.dedicatedCount++;
+        stats.allocationCount++;
+        stats.reservedBytes += size;
+        stats.usedBytes += size;
+        return allocation;
+    }
+
+    void MemoryAllocator::free(Allocation &allocation) {
+        if (allocation.memory == VK_NULL_HANDLE) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock{m_mutex};
+
+        if (allocation.dedicated()) {
+            if (allocation.mapped != nullptr) {
+                vkUnmapMemory(m_device, allocation.memory);
+            }
+            vkFreeMemory(m_device, allocation.memory, nullptr);
+
+            Stats &stats = m_dedicatedStats[allocation.memoryType];
+            stats.dedicatedCount--;
+            stats.allocationCount--;
+            stats.reservedBytes -= allocation.size;
+            stats.usedBytes -= allocation.size;
+            allocation = {};
+            return;
+        }
+
+        Pool &pool = m_pools[allocation.pool];
+        Block &block = *pool.blocks[allocation.block];
+        freeToBlock(block, allocation.offset, allocation.order);
+        block.used -= MIN_ALLOCATION_SIZE << allocation.order;
+        block.allocationCount--;
+
+        // keep a single empty block around per pool so that a resource being
+        // recreated every frame does not hit vkAllocateMemory each time
+        if (block.allocationCount == 0) {
+            bool otherEmpty = false;
+            for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+                if (i != allocation.block && pool.blocks[i] && pool.blocks[i]->allocationCount == 0) {
+                    otherEmpty = true;
+                    break;
+                }
+            }
+            if (otherEmpty) {
+                destroyBlock(block);
+                pool.blocks[allocation.block].reset();
+            }
+        }
+
+        allocation = {};
+    }
+
+    VkResult MemoryAllocator::flush(const Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) {
+        VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+        return vkFlushMappedMemoryRanges(m_device, 1, &range);
+    }
+
+    VkResult MemoryAllocator::invalidate(const Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) {
+        VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+        return vkInvalidateMappedMemoryRanges(m_device, 1, &range);
+    }
+
+    VkMappedMemoryRange MemoryAllocator::mappedRange(const Allocation &allocation, VkDeviceSize size,
+                                                     VkDeviceSize offset) const {
+        // non coherent ranges have to start and end on nonCoherentAtomSize. Pooled
+        // ranges are at least MIN_ALLOCATION_SIZE aligned so rounding never leaves
+        // the range owned by this allocation
+        VkDeviceSize capacity = allocation.dedicated() ? allocation.size : MIN_ALLOCATION_SIZE << allocation.order;
+        VkDeviceSize begin = allocation.offset + offset;
+        VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + capacity : begin + size;
+
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = allocation.memory;
+        range.offset = begin / m_nonCoherentAtomSize * m_nonCoherentAtomSize;
+        if (allocation.dedicated() && end >= allocation.size) {
+            range.size = VK_WHOLE_SIZE;
+        } else {
+            range.size = (end + m_nonCoherentAtomSize - 1) / m_nonCoherentAtomSize * m_nonCoherentAtomSize -
+                         range.offset;
+        }
+        return range;
+    }
+
+    MemoryAllocator::Pool &MemoryAllocator::getPool(uint32_t memoryType, bool linear, int32_t &poolIndex) {
+        for (uint32_t i = 0; i < m_pools.size(); i++) {
+            if (m_pools[i].memoryType == memoryType && m_pools[i].linear == linear) {
+                poolIndex = static_cast<int32_t>(i);
+                return m_pools[i];
+            }
+        }
+
+        // small heaps (e.g. 256MiB BAR memory) get proportionally smaller blocks
+        VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[memoryType].heapIndex].size;
+        VkDeviceSize blockSize = MAX_BLOCK_SIZE;
+        while (blockSize > MIN_ALLOCATION_SIZE && blockSize > heapSize / 8) {
+            blockSize >>= 1;
+        }
+
+        Pool pool{};
+        pool.memoryType = memoryType;
+        pool.linear = linear;
+        pool.blockSize = blockSize;
+        m_pools.push_back(std::move(pool));
+
+        poolIndex = static_cast<int32_t>(m_pools.size() - 1);
+        return m_pools.back();
+    }
+
+    std::unique_ptr<MemoryAllocator::Block> MemoryAllocator::createBlock(uint32_t memoryType, VkDeviceSize size) {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        auto block = std::make_unique<Block>();
+        if (vkAllocateMemory(m_device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate memory block!");
+        }
+        block->size = size;
+        block->mapped = mapMemory(block->memory, memoryType);
+
+        uint32_t topOrder = orderFor(size);
+        block->freeLists.resize(topOrder + 1);
+        block->freeLists[topOrder].insert(0);
+        return block;
+    }
+
+    void MemoryAllocator::destroyBlock(Block &block) {
+        if (block.mapped != nullptr) {
+            vkUnmapMemory(m_device, block.memory);
+        }
+        vkFreeMemory(m_device, block.memory, nullptr);
+        block.memory = VK_NULL_HANDLE;
+        block.mapped = nullptr;
+    }
+
+    void *MemoryAllocator::mapMemory(VkDeviceMemory memory, uint32_t memoryType) {
+        // host visible memory stays mapped for its whole lifetime, mapping is not free
+        // on every driver and buffers used to map/unmap on each update
+        if (!(m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+            return nullptr;
+        }
+
+        void *mapped = nullptr;
+        if (vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+            throw std::runtime_error("failed to map memory block!");
+        }
+        return mapped;
+    }
+
+    bool MemoryAllocator::allocateFromBlock(Block &block, uint32_t order, VkDeviceSize &offset) {
+        uint32_t current = order;
+        while (current < block.freeLists.size() && block.freeLists[current].empty()) {
+            current++;
+        }
+        if (current >= block.freeLists.size()) {
+            return false;
+        }
+
+        auto first = block.freeLists[current].begin();
+        offset = *first;
+        block.freeLists[current].erase(first);
+
+        // split down to the requested size, the upper halves become free buddies
+        while (current > order) {
+            current--;
+            block.freeLists[current].insert(offset + (MIN_ALLOCATION_SIZE << current));
+        }
+        return true;
+    }
+
+    void MemoryAllocator::freeToBlock(Block &block, VkDeviceSize offset, uint32_t order) {
+        uint32_t topOrder = static_cast<uint32_t>(block.freeLists.size() - 1);
+        while (order < topOrder) {
+            VkDeviceSize buddy = offset ^ (MIN_ALLOCATION_SIZE << order);
+            auto it = block.freeLists[order].find(buddy);
+            if (it == block.freeLists[order].end()) {
+                break;
+            }
+            block.freeLists[order].erase(it);
+            offset = std::min(offset, buddy);
+            order++;
+        }
+        block.freeLists[order].insert(offset);
+    }
+
+    MemoryAllocator::Stats MemoryAllocator::stats() const {
+        Stats total{};
+        for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+            Stats type = stats(i);
+            total.blockCount += type.blockCount;
+            total.dedicatedCount += type.dedicatedCount;
+            total.allocationCount += type.allocationCount;
+            total.reservedBytes += type.reservedBytes;
+            total.usedBytes += type.usedBytes;
+        }
+        return total;
+    }
+
+    MemoryAllocator::Stats MemoryAllocator::stats(uint32_t memoryType) const {
+        std::lock_guard<std::mutex> lock{m_mutex};
+
+        Stats result = m_dedicatedStats[memoryType];
+        for (const auto &pool : m_pools) {
+            if (pool.memoryType != memoryType) {
+                continue;
+            }
+            for (const auto &block : pool.blocks) {
+                if (!block) {
+                    continue;
+                }
+                result.blockCount++;
+                result.allocationCount += block->allocationCount;
+                result.reservedBytes += block->size;
+                result.usedBytes += block->used;
+            }
+        }
+        return result;
+    }
+
+    void MemoryAllocator::printStats(std::ostream &out) const {
+        out << "Device memory:" << std::endl;
+        for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+            Stats type = stats(i);
+            if (type.blockCount == 0 && type.dedicatedCount == 0) {
+                continue;
+            }
+            out << "  type " << i << ": " << type.allocationCount << " allocations in "
+                << type.blockCount << " blocks + " << type.dedicatedCount << " dedicated, "
+                << type.usedBytes / 1024 << " / " << type.reservedBytes / 1024 << " KiB used" << std::endl;
+        }
+    }
+
+} // namespace engine
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "MemoryTracker.h"
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <vector>
+
+namespace engine {
+
+    // A sub-range of a VkDeviceMemory handed out by the MemoryAllocator. Resources
+    // bind at memory + offset; mapped is set for host visible memory.
+    struct Allocation {
+        VkDeviceMemory memory{VK_NULL_HANDLE};
+        VkDeviceSize offset{0};
+        VkDeviceSize size{0};
+        void *mapped{nullptr};
+        uint32_t memoryType{0};
+        // set by Device, which counts the allocation under it
+        MemoryTag tag{};
+
+        // bookkeeping for the allocator, a negative pool marks a dedicated allocation
+        int32_t pool{-1};
+        uint32_t block{0};
+        uint32_t order{0};
+
+        [[nodiscard]] bool dedicated() const { return pool < 0; }
+    };
+
+    // Block based GPU memory allocator. Each memory type gets large blocks that are
+    // split with a buddy allocator, so resources no longer need a vkAllocateMemory
+    // each. Buffers and optimally tiled images are kept in separate blocks, which
+    // satisfies bufferImageGranularity without padding every allocation.
+    class MemoryAllocator {
+    public:
+        struct Stats {
+            uint32_t blockCount{0};
+            uint32_t dedicatedCount{0};
+            uint32_t allocationCount{0};
+            VkDeviceSize reservedBytes{0};
+            VkDeviceSize usedBytes{0};
+        };
+
+        static constexpr VkDeviceSize MIN_ALLOCATION_SIZE = 256;
+        static constexpr VkDeviceSize MAX_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+        MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device);
+
+        ~MemoryAllocator();
+
+        MemoryAllocator(const MemoryAllocator &) = delete;
+
+        MemoryAllocator &operator=(const MemoryAllocator &) = delete;
+
+        // linear is true for buffers and linearly tiled images
+        Allocation allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                            bool linear);
+
+        // gives the resource its own VkDeviceMemory, passing the image lets the
+        // driver apply VK_KHR_dedicated_allocation optimisations
+        Allocation allocateDedicated(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                                     VkImage image = VK_NULL_HANDLE);
+
+        void free(Allocation &allocation);
+
+        VkResult flush(const Allocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+        VkResult invalidate(const Allocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+        [[nodiscard]] Stats stats() const;
+
+        [[nodiscard]] Stats stats(uint32_t memoryType) const;
+
+        void printStats(std::ostream &out) const;
+
+    private:
+        struct Block {
+            VkDeviceMemory memory{VK_NULL_HANDLE};
+            void *mapped{nullptr};
+            VkDeviceSize size{0};
+            VkDeviceSize used{0};
+            uint32_t allocationCount{0};
+            // offsets of free ranges, index n holds ranges of MIN_ALLOCATION_SIZE << n
+            std::vector<std::set<VkDeviceSize>> freeLists;
+        };
+
+        struct Pool {
+            uint32_t memoryType;
+            bool linear;
+            VkDeviceSize blockSize;
+            std::vector<std::unique_ptr<Block>> blocks;
+        };
+
+        uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+        Allocation createDedicated(VkDeviceSize size, uint32_t memoryType, VkImage image);
+
+        Pool &getPool(uint32_t memoryType, bool linear, int32_t &poolIndex);
+
+        std::unique_ptr<Block> createBlock(uint32_t memoryType, VkDeviceSize size);
+
+        void destroyBlock(Block &block);
+
+        void *mapMemory(VkDeviceMemory memory, uint32_t memoryType);
+
+        VkMappedMemoryRange mappedRange(const Allocation &allocation, VkDeviceSize size, VkDeviceSize offset) const;
+
+        static bool allocateFromBlock(Block &block, uint32_t order, VkDeviceSize &offset);
+
+        static void freeToBlock(Block &block, VkDeviceSize offset, uint32_t order);
+
+        static uint32_t orderFor(VkDeviceSize size);
+
+        VkDevice m_device;
+        VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+        VkDeviceSize m_nonCoherentAtomSize;
+
+        mutable std::mutex m_mutex;
+        std::vector<Pool> m_pools;
+        std::vector<Stats> m_dedicatedStats;
+    };
+
+} // namespace engine
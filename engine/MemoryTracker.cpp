@@ -0,0 +1,95 @@
+#include "MemoryTracker.h"
+
+#include <atomic>
+#include <cassert>
+#include <iomanip>
+
+namespace engine {
+
+    namespace {
+        struct AtomicCounters {
+            std::atomic<uint64_t> bytes{0};
+            std::atomic<uint64_t> peakBytes{0};
+            std::atomic<uint64_t> count{0};
+            std::atomic<uint64_t> totalCount{0};
+        };
+
+        AtomicCounters s_counters[static_cast<uint32_t>(MemoryDomain::Count)]
+                                 [static_cast<uint32_t>(MemoryTag::Count)];
+
+        AtomicCounters &get(MemoryDomain domain, MemoryTag tag) {
+            assert(domain < MemoryDomain::Count && tag < MemoryTag::Count && "Unknown memory domain or tag");
+            return s_counters[static_cast<uint32_t>(domain)][static_cast<uint32_t>(tag)];
+        }
+    } // namespace
+
+    const char *memoryTagName(MemoryTag tag) {
+        switch (tag) {
+            case MemoryTag::Models:
+                return "models";
+            case MemoryTag::Textures:
+                return "textures";
+            case MemoryTag::Shadow:
+                return "shadow";
+            case MemoryTag::RenderTargets:
+                return "render targets";
+            case MemoryTag::Uniforms:
+                return "uniforms";
+            case MemoryTag::Staging:
+                return "staging";
+            case MemoryTag::Count:
+                break;
+        }
+        assert(false && "Unknown memory tag");
+        return "unknown";
+    }
+
+    void MemoryTracker::add(MemoryDomain domain, MemoryTag tag, uint64_t bytes) {
+        AtomicCounters &counters = get(domain, tag);
+        uint64_t total = counters.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        counters.count.fetch_add(1, std::memory_order_relaxed);
+        counters.totalCount.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+        while (total > peak && !counters.peakBytes.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {
+        }
+    }
+
+    void MemoryTracker::remove(MemoryDomain domain, MemoryTag tag, uint64_t bytes) {
+        AtomicCounters &counters = get(domain, tag);
+        assert(counters.bytes.load(std::memory_order_relaxed) >= bytes && "Freed more memory than was tracked");
+        counters.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        counters.count.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    MemoryTracker::Counters MemoryTracker::counters(MemoryDomain domain, MemoryTag tag) {
+        const AtomicCounters &counters = get(domain, tag);
+        return {counters.bytes.load(std::memory_order_relaxed),
+                counters.peakBytes.load(std::memory_order_relaxed),
+                counters.count.load(std::memory_order_relaxed),
+                counters.totalCount.load(std::memory_order_relaxed)};
+    }
+
+    void MemoryTracker::writeReport(std::ostream &out) {
+        static constexpr const char *domainNames[] = {"device", "host"};
+
+        std::ios flags{nullptr};
+        flags.copyfmt(out);
+        out << std::fixed << std::setprecision(2);
+        out << std::left << std::setw(8) << "domain" << std::setw(16) << "tag" << std::right
+            << std::setw(12) << "MiB" << std::setw(12) << "peak MiB" << std::setw(10) << "live"
+            << std::setw(10) << "total" << std::endl;
+        for (uint32_t domain = 0; domain < static_cast<uint32_t>(MemoryDomain::Count); domain++) {
+            for (uint32_t tag = 0; tag < static_cast<uint32_t>(MemoryTag::Count); tag++) {
+                Counters c = counters(static_cast<MemoryDomain>(domain), static_cast<MemoryTag>(tag));
+                out << std::left << std::setw(8) << domainNames[domain]
+                    << std::setw(16) << memoryTagName(static_cast<MemoryTag>(tag)) << std::right
+                    << std::setw(12) << static_cast<double>(c.bytes) / (1024.0 * 1024.0)
+                    << std::setw(12) << static_cast<double>(c.peakBytes) / (1024.0 * 1024.0)
+                    << std::setw(10) << c.count << std::setw(10) << c.totalCount << std::endl;
+            }
+        }
+        out.copyfmt(flags);
+    }
+
+} // namespace engine
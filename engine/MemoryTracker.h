@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <utility>
+
+namespace engine {
+
+    // Owner of a device allocation or of host memory kept by an asset
+    enum class MemoryTag : uint32_t {
+        Models,         // vertex, index and meshlet data
+        Textures,       // material textures and their decoded pixels
+        Shadow,         // shadow map
+        RenderTargets,  // viewport attachments, swap chain images belong to the presentation engine
+        Uniforms,       // per frame uniforms and instance data
+        Staging,        // upload staging buffers
+        Count
+    };
+
+    enum class MemoryDomain : uint32_t {
+        Device,
+        Host,
+        Count
+    };
+
+    const char *memoryTagName(MemoryTag tag);
+
+    // Live bytes, peak bytes and allocation counts per domain and tag. Device
+    // allocations are counted by Device, host memory by the assets that keep it.
+    // Counters are atomics, loader threads update them without a lock.
+    class MemoryTracker {
+    public:
+        struct Counters {
+            uint64_t bytes{0};
+            uint64_t peakBytes{0};
+            // live allocations and all allocations ever made
+            uint64_t count{0};
+            uint64_t totalCount{0};
+        };
+
+        static void add(MemoryDomain domain, MemoryTag tag, uint64_t bytes);
+
+        static void remove(MemoryDomain domain, MemoryTag tag, uint64_t bytes);
+
+        static Counters counters(MemoryDomain domain, MemoryTag tag);
+
+        // a table of all counters
+        static void writeReport(std::ostream &out);
+    };
+
+    // Counts host memory kept by an asset for as long as the owner lives. Copies
+    // count again, moves hand the bytes over.
+    class HostMemory {
+    public:
+        HostMemory() = default;
+
+        HostMemory(MemoryTag tag, uint64_t bytes) : m_tag{tag}, m_bytes{bytes} {
+            if (m_bytes > 0) {
+                MemoryTracker::add(MemoryDomain::Host, m_tag, m_bytes);
+            }
+        }
+
+        ~HostMemory() { release(); }
+
+        HostMemory(const HostMemory &other) : HostMemory(other.m_tag, other.m_bytes) {}
+
+        HostMemory(HostMemory &&other) noexcept : m_tag{other.m_tag}, m_bytes{other.m_bytes} {
+            other.m_bytes = 0;
+        }
+
+        HostMemory &operator=(HostMemory other) noexcept {
+            std::swap(m_tag, other.m_tag);
+            std::swap(m_bytes, other.m_bytes);
+            return *this;
+        }
+
+        [[nodiscard]] uint64_t bytes() const { return m_bytes; }
+
+    private:
+        void release() {
+            if (m_bytes > 0) {
+                MemoryTracker::remove(MemoryDomain::Host, m_tag, m_bytes);
+                m_bytes = 0;
+            }
+        }
+
+        MemoryTag m_tag{MemoryTag::Models};
+        uint64_t m_bytes{0};
+    };
+
+} // namespace engine
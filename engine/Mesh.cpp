@@ -38,23 +38,13 @@ void Mesh::CreateVertexBuffer(std::vector<Vertex> &vertices) {
   VkDeviceSize bufferSize = sizeof(vertices[0]) * m_vertexCount;
   uint32_t vertexSize = sizeof(vertices[0]);
 
-  Buffer stagingBuffer{
-      m_device,
-      vertexSize,
-      m_vertexCount,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-  };
-
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void *) vertices.data());
-
   m_vertexBuffer = std::make_unique<Buffer>(m_device, vertexSize, m_vertexCount,
                                             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                            MemoryTag::Models
   );
 
-  m_device.copyBuffer(stagingBuffer.getBuffer(), m_vertexBuffer->getBuffer(), bufferSize);
+  m_device.uploads().uploadBuffer(m_vertexBuffer->getBuffer(), vertices.data(), bufferSize);
 }
 
 void Mesh::CreateIndexBuffer(std::vector<uint32_t> &indices) {
@@ -63,28 +53,17 @@ void Mesh::CreateIndexBuffer(std::vector<uint32_t> &indices) {
   VkDeviceSize bufferSize = sizeof(indices[0]) * m_indexCount;
   uint32_t indexSize = sizeof(indices[0]);
 
-  Buffer stagingBuffer{
-      m_device,
-      indexSize,
-      m_indexCount,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-  };
-
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void *) indices.data());
-
   m_indexBuffer = std::make_unique<Buffer>(
       m_device,
       indexSize,
       m_indexCount,
       VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
           VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      MemoryTag::Models
   );
 
-  m_device.copyBuffer(stagingBuffer.getBuffer(), m_indexBuffer->getBuffer(), bufferSize);
+  m_device.uploads().uploadBuffer(m_indexBuffer->getBuffer(), indices.data(), bufferSize);
 }
 
 void Mesh::Bind(VkCommandBuffer commandBuffer) {
@@ -0,0 +1,168 @@
+#include "MeshCooker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace engine {
+
+    namespace {
+        constexpr uint64_t BLOB_ALIGNMENT = 16;
+
+        uint64_t alignBlob(uint64_t offset) {
+            return (offset + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1);
+        }
+
+        bool blobInFile(uint64_t offset, uint64_t size, uint64_t fileSize) {
+            return offset % BLOB_ALIGNMENT == 0 && offset <= fileSize && size <= fileSize - offset;
+        }
+    } // namespace
+
+    std::string cookedMeshPath(const std::string &sourcePath) {
+        return std::filesystem::path(sourcePath).replace_extension(".cmesh").string();
+    }
+
+    bool isCookedMesh(const std::string &path) {
+        return std::filesystem::path(path).extension() == ".cmesh";
+    }
+
+    bool hasCookedMesh(const std::string &sourcePath) {
+        std::error_code error;
+        std::filesystem::path cooked = cookedMeshPath(sourcePath);
+        if (!std::filesystem::exists(cooked, error)) {
+            return false;
+        }
+        return std::filesystem::last_write_time(cooked, error) >= std::filesystem::last_write_time(sourcePath, error);
+    }
+
+    void cookMesh(const std::string &sourcePath) {
+        Model::Builder builder{};
+        if (!builder.LoadModel(sourcePath) || builder.vertices.empty()) {
+            throw std::runtime_error("failed to load model: " + sourcePath);
+        }
+
+        CookedMeshHeader header{};
+        std::memcpy(header.identifier, CookedMeshHeader::IDENTIFIER, sizeof(header.identifier));
+        header.vertexStride = sizeof(Model::Vertex);
+        header.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+        header.indexCount = static_cast<uint32_t>(builder.indices.size());
+        header.submeshCount = static_cast<uint32_t>(builder.submeshes.size());
+        header.lodCount = static_cast<uint32_t>(builder.lods.size());
+        header.meshletCount = static_cast<uint32_t>(builder.meshlets.size());
+
+        glm::vec3 minExtent = builder.vertices.front().position;
+        glm::vec3 maxExtent = minExtent;
+        for (const auto &vertex : builder.vertices) {
+            minExtent = glm::min(minExtent, vertex.position);
+            maxExtent = glm::max(maxExtent, vertex.position);
+        }
+        std::memcpy(header.boundsMin, &minExtent, sizeof(header.boundsMin));
+        std::memcpy(header.boundsMax, &maxExtent, sizeof(header.boundsMax));
+
+        uint64_t vertexBytes = sizeof(Model::Vertex) * static_cast<uint64_t>(header.vertexCount);
+        uint64_t indexBytes = sizeof(uint32_t) * static_cast<uint64_t>(header.indexCount);
+        uint64_t submeshBytes = sizeof(Model::Submesh) * static_cast<uint64_t>(header.submeshCount);
+        uint64_t lodBytes = sizeof(Model::Lod) * static_cast<uint64_t>(header.lodCount);
+        uint64_t meshletBytes = sizeof(Model::Meshlet) * static_cast<uint64_t>(header.meshletCount);
+        header.vertexOffset = alignBlob(sizeof(header));
+        header.indexOffset = alignBlob(header.vertexOffset + vertexBytes);
+        header.submeshOffset = alignBlob(header.indexOffset + indexBytes);
+        header.lodOffset = alignBlob(header.submeshOffset + submeshBytes);
+        header.meshletOffset = alignBlob(header.lodOffset + lodBytes);
+
+        std::string cookedPath = cookedMeshPath(sourcePath);
+        std::ofstream file{cookedPath, std::ios::binary | std::ios::trunc};
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file: " + cookedPath);
+        }
+
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.seekp(static_cast<std::streamoff>(header.vertexOffset));
+        file.write(reinterpret_cast<const char *>(builder.vertices.data()), static_cast<std::streamsize>(vertexBytes));
+        file.seekp(static_cast<std::streamoff>(header.indexOffset));
+        file.write(reinterpret_cast<const char *>(builder.indices.data()), static_cast<std::streamsize>(indexBytes));
+        file.seekp(static_cast<std::streamoff>(header.submeshOffset));
+        file.write(reinterpret_cast<const char *>(builder.submeshes.data()), static_cast<std::streamsize>(submeshBytes));
+        file.seekp(static_cast<std::streamoff>(header.lodOffset));
+        file.write(reinterpret_cast<const char *>(builder.lods.data()), static_cast<std::streamsize>(lodBytes));
+        file.seekp(static_cast<std::streamoff>(header.meshletOffset));
+        file.write(reinterpret_cast<const char *>(builder.meshlets.data()), static_cast<std::streamsize>(meshletBytes));
+        if (!file) {
+            throw std::runtime_error("failed to write file: " + cookedPath);
+        }
+
+        std::cout << "cooked " << sourcePath << " -> " << cookedPath << " ("
+                  << (header.meshletOffset + meshletBytes) / 1024 << " KiB, " << header.vertexCount << " vertices, "
+                  << header.indexCount << " indices, " << header.lodCount << " LODs, " << header.meshletCount
+                  << " meshlets)" << std::endl;
+    }
+
+    CookedMesh loadCookedMesh(const std::string &path) {
+        CookedMesh mesh{};
+        mesh.file = MappedFile{path};
+        uint64_t fileSize = mesh.file.size();
+
+        CookedMeshHeader header{};
+        if (fileSize < sizeof(header)) {
+            throw std::runtime_error("not a cooked mesh: " + path);
+        }
+        std::memcpy(&header, mesh.file.data(), sizeof(header));
+        if (std::memcmp(header.identifier, CookedMeshHeader::IDENTIFIER, sizeof(header.identifier)) != 0) {
+            throw std::runtime_error("not a cooked mesh: " + path);
+        }
+        if (header.vertexStride != sizeof(Model::Vertex) || header.vertexCount == 0) {
+            throw std::runtime_error("unsupported cooked mesh layout: " + path);
+        }
+
+        if (!blobInFile(header.vertexOffset, sizeof(Model::Vertex) * static_cast<uint64_t>(header.vertexCount), fileSize) ||
+            !blobInFile(header.indexOffset, sizeof(uint32_t) * static_cast<uint64_t>(header.indexCount), fileSize) ||
+            !blobInFile(header.submeshOffset, sizeof(Model::Submesh) * static_cast<uint64_t>(header.submeshCount), fileSize) ||
+            !blobInFile(header.lodOffset, sizeof(Model::Lod) * static_cast<uint64_t>(header.lodCount), fileSize) ||
+            !blobInFile(header.meshletOffset, sizeof(Model::Meshlet) * static_cast<uint64_t>(header.meshletCount), fileSize)) {
+            throw std::runtime_error("truncated cooked mesh: " + path);
+        }
+
+        // Model::Draw indexes the LOD and meshlet tables without further checks
+        auto lods = reinterpret_cast<const Model::Lod *>(mesh.file.data() + header.lodOffset);
+        if (header.lodCount == 0) {
+            throw std::runtime_error("cooked mesh without LODs: " + path);
+        }
+        for (uint32_t i = 0; i < header.lodCount; i++) {
+            if (lods[i].firstIndex > header.indexCount || lods[i].indexCount > header.indexCount - lods[i].firstIndex) {
+                throw std::runtime_error("cooked mesh LOD out of range: " + path);
+            }
+        }
+        auto meshlets = reinterpret_cast<const Model::Meshlet *>(mesh.file.data() + header.meshletOffset);
+        for (uint32_t i = 0; i < header.meshletCount; i++) {
+            if (meshlets[i].firstIndex > lods[0].indexCount ||
+                meshlets[i].indexCount > lods[0].indexCount - meshlets[i].firstIndex) {
+                throw std::runtime_error("cooked mesh meshlet out of range: " + path);
+            }
+        }
+
+        // the mapping is page aligned and every blob 16 byte aligned within it
+        auto indices = reinterpret_cast<const uint32_t *>(mesh.file.data() + header.indexOffset);
+        // Model reads vertices[indices[i]] on the CPU for its bounds
+        if (header.indexCount > 0 && *std::max_element(indices, indices + header.indexCount) >= header.vertexCount) {
+            throw std::runtime_error("cooked mesh index out of range: " + path);
+        }
+
+        mesh.vertices = reinterpret_cast<const Model::Vertex *>(mesh.file.data() + header.vertexOffset);
+        mesh.vertexCount = header.vertexCount;
+        mesh.indices = indices;
+        mesh.indexCount = header.indexCount;
+        mesh.submeshes = reinterpret_cast<const Model::Submesh *>(mesh.file.data() + header.submeshOffset);
+        mesh.submeshCount = header.submeshCount;
+        mesh.lods = lods;
+        mesh.lodCount = header.lodCount;
+        mesh.meshlets = meshlets;
+        mesh.meshletCount = header.meshletCount;
+        mesh.minExtent = {header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]};
+        mesh.maxExtent = {header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]};
+        return mesh;
+    }
+
+} // namespace engine
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Model.h"
+
+#include <glm/glm.hpp>
+
+#include <string>
+
+namespace engine {
+
+    // Container written by cookMesh: header, the vertex blob in Model::Vertex layout,
+    // uint32 indices of all LODs, the submesh, LOD and meshlet tables, each blob
+    // aligned to 16 bytes so it can be used in place from a mapping.
+    struct CookedMeshHeader {
+        static constexpr uint8_t IDENTIFIER[12] = {0xAB, 'C', 'M', 'S', 'H', ' ', '1', '2', 0xBB, '\r', '\n', 0x1A};
+
+        uint8_t identifier[12];
+        // sizeof(Model::Vertex) at cook time, files from a different layout are rejected
+        uint32_t vertexStride;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t submeshCount;
+        uint32_t lodCount;
+        uint32_t meshletCount;
+        float boundsMin[3];
+        float boundsMax[3];
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint64_t submeshOffset;
+        uint64_t lodOffset;
+        uint64_t meshletOffset;
+    };
+
+    // Views into the mapped file, valid as long as the CookedMesh lives.
+    struct CookedMesh {
+        MappedFile file;
+        const Model::Vertex *vertices{nullptr};
+        uint32_t vertexCount{0};
+        const uint32_t *indices{nullptr};
+        uint32_t indexCount{0};
+        const Model::Submesh *submeshes{nullptr};
+        uint32_t submeshCount{0};
+        const Model::Lod *lods{nullptr};
+        uint32_t lodCount{0};
+        const Model::Meshlet *meshlets{nullptr};
+        uint32_t meshletCount{0};
+        glm::vec3 minExtent{0.0f};
+        glm::vec3 maxExtent{0.0f};
+    };
+
+    // sibling path the cooked version of a source mesh is written to
+    std::string cookedMeshPath(const std::string &sourcePath);
+
+    bool isCookedMesh(const std::string &path);
+
+    // true if a cooked file exists for sourcePath and is not older than it
+    bool hasCookedMesh(const std::string &sourcePath);
+
+    // Loads the OBJ at sourcePath through Model::Builder and writes the result to
+    // cookedMeshPath(sourcePath). Throws std::runtime_error on failure.
+    void cookMesh(const std::string &sourcePath);
+
+    // maps path and validates its layout, nothing is copied
+    CookedMesh loadCookedMesh(const std::string &path);
+
+} // namespace engine
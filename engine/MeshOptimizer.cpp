@@ -0,0 +1,202 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+
+namespace engine {
+
+    namespace {
+        // Compacts the vertices used by one index range to 0..n-1 so the per vertex
+        // state of the optimizer scales with the range instead of the whole mesh.
+        uint32_t compactRange(uint32_t *indices, size_t indexCount, std::vector<uint32_t> &original) {
+            std::unordered_map<uint32_t, uint32_t> local;
+            local.reserve(indexCount / 2);
+            original.clear();
+            for (size_t i = 0; i < indexCount; i++) {
+                auto [it, inserted] = local.try_emplace(indices[i], static_cast<uint32_t>(original.size()));
+                if (inserted) {
+                    original.push_back(indices[i]);
+                }
+                indices[i] = it->second;
+            }
+            return static_cast<uint32_t>(original.size());
+        }
+    } // namespace
+
+    std::vector<uint32_t> positionRemap(const std::vector<Model::Vertex> &vertices) {
+        std::vector<uint32_t> order(vertices.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            const glm::vec3 &pa = vertices[a].position;
+            const glm::vec3 &pb = vertices[b].position;
+            return std::tie(pa.x, pa.y, pa.z, a) < std::tie(pb.x, pb.y, pb.z, b);
+        });
+
+        std::vector<uint32_t> remap(vertices.size());
+        size_t run = 0;
+        for (size_t i = 0; i < order.size(); i++) {
+            if (vertices[order[i]].position != vertices[order[run]].position) {
+                run = i;
+            }
+            remap[order[i]] = order[run];
+        }
+        return remap;
+    }
+
+    float averageCacheMissRatio(const uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize) {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0) {
+            return 0.0f;
+        }
+
+        // a vertex is cached while fewer than cacheSize misses happened since it was loaded
+        std::vector<uint64_t> loadedAt(vertexCount, 0);
+        uint64_t misses = 0;
+        for (size_t i = 0; i < indexCount; i++) {
+            uint32_t vertex = indices[i];
+            if (loadedAt[vertex] == 0 || misses - loadedAt[vertex] >= cacheSize) {
+                misses++;
+                loadedAt[vertex] = misses;
+            }
+        }
+        return static_cast<float>(misses) / static_cast<float>(triangleCount);
+    }
+
+    void optimizeVertexCache(uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize) {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount < 2) {
+            return;
+        }
+
+        // triangles adjacent to each vertex, in compressed rows
+        std::vector<uint32_t> liveCount(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+            liveCount[indices[i]]++;
+        }
+        std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            adjacencyOffset[v + 1] = adjacencyOffset[v] + liveCount[v];
+        }
+        std::vector<uint32_t> adjacency(adjacencyOffset.back());
+        std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (size_t c = 0; c < 3; c++) {
+                adjacency[fill[indices[t * 3 + c]]++] = static_cast<uint32_t>(t);
+            }
+        }
+
+        std::vector<uint32_t> output;
+        output.reserve(triangleCount * 3);
+        std::vector<uint32_t> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> deadEnd;
+        std::vector<uint32_t> candidates;
+        uint32_t timeStamp = cacheSize + 1;
+        uint32_t cursor = 0;
+
+        int64_t fanning = 0;
+        while (fanning >= 0) {
+            auto fan = static_cast<uint32_t>(fanning);
+            candidates.clear();
+
+            for (uint32_t a = adjacencyOffset[fan]; a < adjacencyOffset[fan + 1]; a++) {
+                uint32_t t = adjacency[a];
+                if (emitted[t]) {
+                    continue;
+                }
+                for (size_t c = 0; c < 3; c++) {
+                    uint32_t v = indices[t * 3 + c];
+                    output.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    liveCount[v]--;
+                    if (timeStamp - cacheTime[v] > cacheSize) {
+                        cacheTime[v] = timeStamp++;
+                    }
+                }
+                emitted[t] = true;
+            }
+
+            // prefer the candidate that stays cached while its remaining triangles are
+            // emitted, and among those the one that entered the cache earliest
+            fanning = -1;
+            int64_t best = -1;
+            for (uint32_t v : candidates) {
+                if (liveCount[v] == 0) {
+                    continue;
+                }
+                int64_t priority = 0;
+                if (timeStamp - cacheTime[v] + 2 * liveCount[v] <= cacheSize) {
+                    priority = timeStamp - cacheTime[v];
+                }
+                if (priority > best) {
+                    best = priority;
+                    fanning = v;
+                }
+            }
+
+            // dead end, go back to a recently used vertex or else the next unfinished one
+            while (fanning < 0 && !deadEnd.empty()) {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveCount[v] > 0) {
+                    fanning = v;
+                }
+            }
+            while (fanning < 0 && cursor < vertexCount) {
+                if (liveCount[cursor] > 0) {
+                    fanning = cursor;
+                }
+                cursor++;
+            }
+        }
+
+        std::copy(output.begin(), output.end(), indices);
+    }
+
+    void optimizeVertexFetch(std::vector<Model::Vertex> &vertices, std::vector<uint32_t> &indices) {
+        constexpr uint32_t UNUSED = ~0u;
+        std::vector<uint32_t> remap(vertices.size(), UNUSED);
+        std::vector<Model::Vertex> ordered;
+        ordered.reserve(vertices.size());
+
+        for (auto &index : indices) {
+            if (remap[index] == UNUSED) {
+                remap[index] = static_cast<uint32_t>(ordered.size());
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices = std::move(ordered);
+    }
+
+    void optimizeVertexCacheRange(uint32_t *indices, size_t indexCount, uint32_t cacheSize) {
+        std::vector<uint32_t> original;
+        uint32_t localCount = compactRange(indices, indexCount, original);
+        optimizeVertexCache(indices, indexCount, localCount, cacheSize);
+        for (size_t i = 0; i < indexCount; i++) {
+            indices[i] = original[indices[i]];
+        }
+    }
+
+    MeshOptimizeStats optimizeMesh(Model::Builder &builder) {
+        auto vertexCount = static_cast<uint32_t>(builder.vertices.size());
+        MeshOptimizeStats stats{};
+        stats.acmrBefore = averageCacheMissRatio(builder.indices.data(), builder.indices.size(), vertexCount);
+
+        if (builder.submeshes.empty()) {
+            optimizeVertexCacheRange(builder.indices.data(), builder.indices.size());
+        }
+        for (const auto &submesh : builder.submeshes) {
+            optimizeVertexCacheRange(builder.indices.data() + submesh.firstIndex, submesh.indexCount);
+        }
+
+        optimizeVertexFetch(builder.vertices, builder.indices);
+        stats.acmrAfter = averageCacheMissRatio(builder.indices.data(), builder.indices.size(),
+                                                static_cast<uint32_t>(builder.vertices.size()));
+        return stats;
+    }
+
+} // namespace engine
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Model.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace engine {
+
+    // Size of the FIFO post-transform cache that is simulated, a conservative
+    // stand-in for the varying caches of real GPUs.
+    constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+    // Maps every vertex to the lowest vertex with the same position, so topology
+    // can be followed across normal and uv seams.
+    std::vector<uint32_t> positionRemap(const std::vector<Model::Vertex> &vertices);
+
+    // Average cache miss ratio: vertex shader invocations per triangle, between
+    // 0.5 for an ideal grid and 3 for no reuse at all.
+    float averageCacheMissRatio(const uint32_t *indices, size_t indexCount, uint32_t vertexCount,
+                                uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    // Reorders the triangles of indices in place so consecutive triangles share
+    // vertices still in the cache (Tipsify, Sander et al. 2007).
+    void optimizeVertexCache(uint32_t *indices, size_t indexCount, uint32_t vertexCount,
+                             uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    // Same for a range that only references a few of the mesh's vertices, e.g. one
+    // submesh or meshlet. The range is renumbered to local vertices first, so the
+    // cost scales with the range rather than the whole vertex buffer.
+    void optimizeVertexCacheRange(uint32_t *indices, size_t indexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    // Renumbers vertices in the order the index buffer first uses them, so vertex
+    // fetches walk memory mostly forward. Unreferenced vertices are dropped.
+    void optimizeVertexFetch(std::vector<Model::Vertex> &vertices, std::vector<uint32_t> &indices);
+
+    struct MeshOptimizeStats {
+        float acmrBefore;
+        float acmrAfter;
+    };
+
+    // Cache optimizes every submesh of builder separately, keeping their index
+    // ranges, and then reorders the vertices for fetch.
+    MeshOptimizeStats optimizeMesh(Model::Builder &builder);
+
+} // namespace engine
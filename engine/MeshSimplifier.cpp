@@ -0,0 +1,369 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+namespace engine {
+
+    namespace {
+        // Deviation a LOD may accumulate over the chain, relative to the diagonal of
+        // the mesh bounds. Beyond that the silhouette visibly falls apart.
+        constexpr float MAX_LOD_DEVIATION = 0.05f;
+
+        // Levels that keep more than this share of the previous level end the chain.
+        constexpr float MIN_LOD_REDUCTION = 0.8f;
+
+        // Sum of squared distances to a set of area weighted planes.
+        struct Quadric {
+            double a2{0}, b2{0}, c2{0}, d2{0};
+            double ab{0}, ac{0}, ad{0}, bc{0}, bd{0}, cd{0};
+            double weight{0};
+
+            void addPlane(const glm::dvec3 &normal, double distance, double planeWeight) {
+                a2 += planeWeight * normal.x * normal.x;
+                b2 += planeWeight * normal.y * normal.y;
+                c2 += planeWeight * normal.z * normal.z;
+                d2 += planeWeight * distance * distance;
+                ab += planeWeight * normal.x * normal.y;
+                ac += planeWeight * normal.x * normal.z;
+                ad += planeWeight * normal.x * distance;
+                bc += planeWeight * normal.y * normal.z;
+                bd += planeWeight * normal.y * distance;
+                cd += planeWeight * normal.z * distance;
+                weight += planeWeight;
+            }
+
+            Quadric &operator+=(const Quadric &other) {
+                a2 += other.a2;
+                b2 += other.b2;
+                c2 += other.c2;
+                d2 += other.d2;
+                ab += other.ab;
+                ac += other.ac;
+                ad += other.ad;
+                bc += other.bc;
+                bd += other.bd;
+                cd += other.cd;
+                weight += other.weight;
+                return *this;
+            }
+
+            // mean squared distance of point to the planes
+            [[nodiscard]] double error(const glm::dvec3 &point) const {
+                if (weight <= 0.0) {
+                    return 0.0;
+                }
+                double x = point.x, y = point.y, z = point.z;
+                double sum = a2 * x * x + b2 * y * y + c2 * z * z + d2 +
+                             2.0 * (ab * x * y + ac * x * z + ad * x + bc * y * z + bd * y + cd * z);
+                return std::abs(sum) / weight;
+            }
+        };
+
+        struct Collapse {
+            uint32_t from;
+            uint32_t to;
+            double error;
+        };
+
+        glm::dvec3 faceNormal(const glm::dvec3 &a, const glm::dvec3 &b, const glm::dvec3 &c) {
+            return glm::cross(b - a, c - a);
+        }
+    } // namespace
+
+    size_t simplifyMesh(uint32_t *destination, const uint32_t *indices, size_t indexCount,
+                        const std::vector<Model::Vertex> &vertices, const std::vector<uint32_t> &remap,
+                        size_t targetIndexCount, float targetError, float *error) {
+        // topology works on positions, triangles that are degenerate there are dropped
+        size_t count = 0;
+        for (size_t i = 0; i + 2 < indexCount; i += 3) {
+            uint32_t a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+            if (a != b && b != c && c != a) {
+                std::copy(indices + i, indices + i + 3, destination + count);
+                count += 3;
+            }
+        }
+
+        // The range is simplified in a local index space, its vertices and positions
+        // numbered in order of first use, so all state below scales with the range
+        // and not with the whole mesh. destination holds local vertices until the end.
+        std::vector<uint32_t> original;
+        std::vector<uint32_t> localRemap;
+        std::vector<glm::dvec3> points;
+        {
+            std::unordered_map<uint32_t, uint32_t> localVertex;
+            std::unordered_map<uint32_t, uint32_t> localPosition;
+            localVertex.reserve(count / 2);
+            localPosition.reserve(count / 2);
+            for (size_t i = 0; i < count; i++) {
+                auto [vertex, newVertex] = localVertex.try_emplace(destination[i], static_cast<uint32_t>(original.size()));
+                if (newVertex) {
+                    auto [point, newPoint] = localPosition.try_emplace(remap[destination[i]],
+                                                                       static_cast<uint32_t>(points.size()));
+                    if (newPoint) {
+                        points.emplace_back(vertices[destination[i]].position);
+                    }
+                    original.push_back(destination[i]);
+                    localRemap.push_back(point->second);
+                }
+                destination[i] = vertex->second;
+            }
+        }
+        auto vertexCount = static_cast<uint32_t>(original.size());
+        auto positionCount = static_cast<uint32_t>(points.size());
+        auto position = [&](uint32_t point) { return points[point]; };
+        auto vertex = [&](uint32_t local) -> const Model::Vertex & { return vertices[original[local]]; };
+
+        // vertices per position in compressed rows, in mesh order within a row
+        std::vector<uint32_t> wedgeOffset(positionCount + 1, 0);
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            wedgeOffset[localRemap[v] + 1]++;
+        }
+        std::partial_sum(wedgeOffset.begin(), wedgeOffset.end(), wedgeOffset.begin());
+        std::vector<uint32_t> wedges(vertexCount);
+        {
+            std::vector<uint32_t> fill(wedgeOffset.begin(), wedgeOffset.end() - 1);
+            for (uint32_t v = 0; v < vertexCount; v++) {
+                wedges[fill[localRemap[v]]++] = v;
+            }
+            for (uint32_t p = 0; p < positionCount; p++) {
+                std::sort(wedges.begin() + wedgeOffset[p], wedges.begin() + wedgeOffset[p + 1],
+                          [&](uint32_t a, uint32_t b) { return original[a] < original[b]; });
+            }
+        }
+
+        // Wedges that only differ in their normal, as in flat shaded meshes, move
+        // together. Positions whose wedges disagree on the uv sit on a seam and are
+        // locked, they are no collapse target either.
+        std::vector<bool> seam(positionCount, false);
+        for (uint32_t p = 0; p < positionCount; p++) {
+            for (uint32_t w = wedgeOffset[p] + 1; w < wedgeOffset[p + 1]; w++) {
+                if (vertex(wedges[w]).uv != vertex(wedges[wedgeOffset[p]]).uv) {
+                    seam[p] = true;
+                }
+            }
+        }
+        std::vector<bool> locked = seam;
+
+        // a moved corner takes the wedge of its new position with the closest normal
+        auto closestWedge = [&](uint32_t target, uint32_t corner) {
+            uint32_t best = wedges[wedgeOffset[target]];
+            float bestDot = -2.0f;
+            for (uint32_t w = wedgeOffset[target]; w < wedgeOffset[target + 1]; w++) {
+                float dot = glm::dot(vertex(wedges[w]).normal, vertex(corner).normal);
+                if (dot > bestDot) {
+                    bestDot = dot;
+                    best = wedges[w];
+                }
+            }
+            return best;
+        };
+
+        // open and non manifold edges keep their shape
+        std::vector<uint64_t> edges;
+        edges.reserve(count);
+        for (size_t i = 0; i < count; i += 3) {
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t a = localRemap[destination[i + k]];
+                uint32_t b = localRemap[destination[i + (k + 1) % 3]];
+                edges.push_back(static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size();) {
+            size_t end = i;
+            while (end < edges.size() && edges[end] == edges[i]) {
+                end++;
+            }
+            if (end - i != 2) {
+                locked[static_cast<uint32_t>(edges[i] >> 32)] = true;
+                locked[static_cast<uint32_t>(edges[i])] = true;
+            }
+            i = end;
+        }
+
+        std::vector<Quadric> quadrics(positionCount);
+        for (size_t i = 0; i < count; i += 3) {
+            uint32_t a = localRemap[destination[i]], b = localRemap[destination[i + 1]], c = localRemap[destination[i + 2]];
+            glm::dvec3 normal = faceNormal(position(a), position(b), position(c));
+            double length = glm::length(normal);
+            if (length <= 0.0) {
+                continue;
+            }
+            normal /= length;
+            double distance = -glm::dot(normal, position(a));
+            for (uint32_t corner : {a, b, c}) {
+                quadrics[corner].addPlane(normal, distance, 0.5 * length);
+            }
+        }
+
+        double limit = static_cast<double>(targetError) * static_cast<double>(targetError);
+        double worst = 0.0;
+        std::vector<uint32_t> adjacencyOffset(positionCount + 1);
+        std::vector<uint32_t> adjacency;
+        std::vector<Collapse> collapses;
+        std::vector<bool> dirty(positionCount);
+
+        // every pass collapses an independent set of the cheapest edges, the
+        // neighbourhoods it touched are only looked at again in the next pass
+        while (count > targetIndexCount) {
+            std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+            for (size_t i = 0; i < count; i++) {
+                adjacencyOffset[localRemap[destination[i]] + 1]++;
+            }
+            std::partial_sum(adjacencyOffset.begin(), adjacencyOffset.end(), adjacencyOffset.begin());
+            adjacency.resize(count);
+            std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (size_t i = 0; i < count; i++) {
+                adjacency[fill[localRemap[destination[i]]]++] = static_cast<uint32_t>(i / 3);
+            }
+
+            // each half edge once, an interior edge shows up in both directions
+            collapses.clear();
+            for (size_t i = 0; i < count; i += 3) {
+                for (size_t k = 0; k < 3; k++) {
+                    uint32_t from = localRemap[destination[i + k]];
+                    uint32_t to = localRemap[destination[i + (k + 1) % 3]];
+                    if (!locked[from] && !seam[to]) {
+                        collapses.push_back({from, to, quadrics[from].error(position(to))});
+                    }
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(),
+                      [](const Collapse &a, const Collapse &b) { return a.error < b.error; });
+
+            std::fill(dirty.begin(), dirty.end(), false);
+            size_t removed = 0;
+            bool progress = false;
+            for (const Collapse &collapse : collapses) {
+                if (collapse.error > limit || count - removed <= targetIndexCount) {
+                    break;
+                }
+                if (dirty[collapse.from] || dirty[collapse.to]) {
+                    continue;
+                }
+
+                // the triangles that survive the collapse must not turn over
+                bool flips = false;
+                for (uint32_t a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1] && !flips; a++) {
+                    const uint32_t *triangle = destination + adjacency[a] * 3;
+                    glm::dvec3 before[3], after[3];
+                    bool removedByCollapse = false;
+                    for (size_t k = 0; k < 3; k++) {
+                        uint32_t corner = localRemap[triangle[k]];
+                        removedByCollapse |= corner == collapse.to;
+                        before[k] = position(corner);
+                        after[k] = corner == collapse.from ? position(collapse.to) : before[k];
+                    }
+                    if (!removedByCollapse) {
+                        flips = glm::dot(faceNormal(before[0], before[1], before[2]),
+                                         faceNormal(after[0], after[1], after[2])) <= 0.0;
+                    }
+                }
+                if (flips) {
+                    continue;
+                }
+
+                for (uint32_t a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1]; a++) {
+                    uint32_t *triangle = destination + adjacency[a] * 3;
+                    bool degenerate = false;
+                    for (size_t k = 0; k < 3; k++) {
+                        uint32_t corner = localRemap[triangle[k]];
+                        degenerate |= corner == collapse.to;
+                        dirty[corner] = true;
+                        if (corner == collapse.from) {
+                            triangle[k] = closestWedge(collapse.to, triangle[k]);
+                        }
+                    }
+                    if (degenerate) {
+                        removed += 3;
+                    }
+                }
+                quadrics[collapse.to] += quadrics[collapse.from];
+                worst = std::max(worst, collapse.error);
+                progress = true;
+            }
+            if (!progress) {
+                break;
+            }
+
+            size_t kept = 0;
+            for (size_t i = 0; i < count; i += 3) {
+                uint32_t a = localRemap[destination[i]], b = localRemap[destination[i + 1]], c = localRemap[destination[i + 2]];
+                if (a != b && b != c && c != a) {
+                    std::copy(destination + i, destination + i + 3, destination + kept);
+                    kept += 3;
+                }
+            }
+            count = kept;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            destination[i] = original[destination[i]];
+        }
+        if (error) {
+            *error = static_cast<float>(std::sqrt(worst));
+        }
+        return count;
+    }
+
+    void generateLods(Model::Builder &builder) {
+        auto fullCount = static_cast<uint32_t>(builder.indices.size());
+        builder.lods.assign(1, Model::Lod{0, fullCount, 0.0f});
+        if (builder.vertices.empty() || fullCount == 0) {
+            return;
+        }
+
+        glm::vec3 minExtent = builder.vertices.front().position;
+        glm::vec3 maxExtent = minExtent;
+        for (const auto &vertex : builder.vertices) {
+            minExtent = glm::min(minExtent, vertex.position);
+            maxExtent = glm::max(maxExtent, vertex.position);
+        }
+        float maxError = MAX_LOD_DEVIATION * glm::length(maxExtent - minExtent);
+        // shared by every range of every level, sorting all vertices is the costly part
+        std::vector<uint32_t> remap = positionRemap(builder.vertices);
+
+        // every level is simplified from the previous one, range by range
+        std::vector<Model::Submesh> ranges = builder.submeshes;
+        if (ranges.empty()) {
+            ranges.push_back({0, fullCount, -1});
+        }
+        std::vector<Model::Submesh> next;
+        std::vector<uint32_t> simplified;
+
+        for (uint32_t level = 1; level < MAX_LODS; level++) {
+            const Model::Lod previous = builder.lods.back();
+            auto first = static_cast<uint32_t>(builder.indices.size());
+            float levelError = 0.0f;
+            next.clear();
+
+            for (const auto &range : ranges) {
+                simplified.resize(range.indexCount);
+                float rangeError = 0.0f;
+                size_t count = simplifyMesh(simplified.data(), builder.indices.data() + range.firstIndex,
+                                            range.indexCount, builder.vertices, remap, range.indexCount / 6 * 3,
+                                            maxError - previous.error, &rangeError);
+                optimizeVertexCacheRange(simplified.data(), count);
+
+                next.push_back({static_cast<uint32_t>(builder.indices.size()), static_cast<uint32_t>(count),
+                                range.materialId});
+                builder.indices.insert(builder.indices.end(), simplified.begin(),
+                                       simplified.begin() + static_cast<std::ptrdiff_t>(count));
+                levelError = std::max(levelError, rangeError);
+            }
+
+            auto indexCount = static_cast<uint32_t>(builder.indices.size()) - first;
+            if (indexCount == 0 || static_cast<float>(indexCount) > MIN_LOD_REDUCTION * static_cast<float>(previous.indexCount)) {
+                builder.indices.resize(first);
+                break;
+            }
+            builder.lods.push_back({first, indexCount, previous.error + levelError});
+            std::swap(ranges, next);
+        }
+    }
+
+} // namespace engine
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Model.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace engine {
+
+    // Levels generated per mesh including the full detail one.
+    constexpr uint32_t MAX_LODS = 5;
+
+    // Reduces the triangles of indices towards targetIndexCount by quadric error
+    // edge collapses (Garland and Heckbert 1997), stopping early once a collapse
+    // would move the surface further than targetError. Vertices only ever move
+    // onto a neighbour, so the result indexes the same vertex buffer. Vertices on
+    // open edges and on UV seams (one position with several uvs) are locked, which
+    // keeps submesh borders and texture seams watertight. Split normals alone, as
+    // in flat shaded meshes, do not lock a vertex.
+    // remap is positionRemap(vertices), computed once for all ranges of a mesh;
+    // everything else scales with the range.
+    // Writes at most indexCount indices to destination and returns how many, error
+    // receives the largest deviation in model units.
+    size_t simplifyMesh(uint32_t *destination, const uint32_t *indices, size_t indexCount,
+                        const std::vector<Model::Vertex> &vertices, const std::vector<uint32_t> &remap,
+                        size_t targetIndexCount, float targetError, float *error);
+
+    // Appends a chain of LODs behind the optimized indices of builder, each about
+    // half of the previous one, and fills builder.lods. Every submesh is simplified
+    // on its own so material boundaries stay in place. The chain ends early once a
+    // level hardly shrinks or deviates too far from the full mesh.
+    void generateLods(Model::Builder &builder);
+
+} // namespace engine
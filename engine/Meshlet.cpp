@@ -0,0 +1,252 @@
+#include "Meshlet.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+namespace engine {
+
+    namespace {
+        // Bounding sphere around the box of the meshlet's corners and the cone that
+        // contains all triangle normals, see meshletVisible for how it is used.
+        Model::Meshlet makeMeshlet(const Model::Builder &builder, uint32_t firstIndex, uint32_t indexCount) {
+            Model::Meshlet meshlet{};
+            meshlet.firstIndex = firstIndex;
+            meshlet.indexCount = indexCount;
+
+            const uint32_t *indices = builder.indices.data() + firstIndex;
+            glm::vec3 minCorner = builder.vertices[indices[0]].position;
+            glm::vec3 maxCorner = minCorner;
+            for (uint32_t i = 1; i < indexCount; i++) {
+                minCorner = glm::min(minCorner, builder.vertices[indices[i]].position);
+                maxCorner = glm::max(maxCorner, builder.vertices[indices[i]].position);
+            }
+            meshlet.center = (minCorner + maxCorner) * 0.5f;
+            for (uint32_t i = 0; i < indexCount; i++) {
+                meshlet.radius = std::max(meshlet.radius, glm::length(builder.vertices[indices[i]].position - meshlet.center));
+            }
+
+            glm::vec3 normals[MESHLET_MAX_TRIANGLES];
+            uint32_t normalCount = 0;
+            glm::vec3 axis{0.0f};
+            for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+                glm::vec3 a = builder.vertices[indices[i]].position;
+                glm::vec3 b = builder.vertices[indices[i + 1]].position;
+                glm::vec3 c = builder.vertices[indices[i + 2]].position;
+                glm::vec3 normal = glm::cross(b - a, c - a);
+                float length = glm::length(normal);
+                if (length > 0.0f) {
+                    normals[normalCount] = normal / length;
+                    axis += normals[normalCount];
+                    normalCount++;
+                }
+            }
+
+            // a cutoff of 1 never culls, used when the normals spread over a half space
+            meshlet.coneAxis = glm::vec3{0.0f, 0.0f, 1.0f};
+            meshlet.coneCutoff = 1.0f;
+            float axisLength = glm::length(axis);
+            if (normalCount == 0 || axisLength <= 0.0f) {
+                return meshlet;
+            }
+            axis /= axisLength;
+            float minDot = 1.0f;
+            for (uint32_t i = 0; i < normalCount; i++) {
+                minDot = std::min(minDot, glm::dot(axis, normals[i]));
+            }
+            meshlet.coneAxis = axis;
+            if (minDot > 0.0f) {
+                meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+            }
+            return meshlet;
+        }
+    } // namespace
+
+    void buildMeshlets(Model::Builder &builder) {
+        builder.meshlets.clear();
+        uint32_t lodIndexCount = builder.lods.empty() ? static_cast<uint32_t>(builder.indices.size())
+                                                      : builder.lods.front().indexCount;
+        if (lodIndexCount == 0) {
+            return;
+        }
+
+        std::vector<Model::Submesh> ranges = builder.submeshes;
+        if (ranges.empty()) {
+            ranges.push_back({0, lodIndexCount, -1});
+        }
+
+        // triangles around every position, flat shaded meshes share no vertices at all
+        const uint32_t *indices = builder.indices.data();
+        std::vector<uint32_t> remap = positionRemap(builder.vertices);
+        size_t vertexCount = builder.vertices.size();
+        std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+        for (uint32_t i = 0; i < lodIndexCount; i++) {
+            adjacencyOffset[remap[indices[i]] + 1]++;
+        }
+        std::partial_sum(adjacencyOffset.begin(), adjacencyOffset.end(), adjacencyOffset.begin());
+        std::vector<uint32_t> adjacency(lodIndexCount);
+        {
+            std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (uint32_t i = 0; i < lodIndexCount; i++) {
+                adjacency[fill[remap[indices[i]]]++] = i / 3;
+            }
+        }
+
+        auto centroid = [&](uint32_t triangle) {
+            return (builder.vertices[indices[triangle * 3]].position + builder.vertices[indices[triangle * 3 + 1]].position +
+                    builder.vertices[indices[triangle * 3 + 2]].position) / 3.0f;
+        };
+
+        // stamps hold the id of the meshlet that last touched a vertex, position or triangle
+        uint32_t triangleCount = lodIndexCount / 3;
+        std::vector<uint32_t> vertexStamp(vertexCount, ~0u);
+        std::vector<uint32_t> positionStamp(vertexCount, ~0u);
+        std::vector<uint32_t> candidateStamp(triangleCount, ~0u);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> ordered;
+        ordered.reserve(lodIndexCount);
+        std::vector<std::pair<uint32_t, uint32_t>> bounds;
+
+        // Meshlets grow greedily from a seed, preferring the neighbour that shares the
+        // most positions with the meshlet and then the one closest to its center. The
+        // next seed is the leftover neighbour closest to the meshlet just finished.
+        for (const auto &range : ranges) {
+            uint32_t rangeBegin = range.firstIndex / 3;
+            uint32_t rangeEnd = (range.firstIndex + range.indexCount) / 3;
+            uint32_t cursor = rangeBegin;
+            glm::vec3 previousCenter{0.0f};
+            candidates.clear();
+
+            while (true) {
+                auto id = static_cast<uint32_t>(bounds.size());
+                uint32_t seed = ~0u;
+                float seedDistance = 0.0f;
+                for (uint32_t triangle : candidates) {
+                    float distance = glm::length(centroid(triangle) - previousCenter);
+                    if (!emitted[triangle] && (seed == ~0u || distance < seedDistance)) {
+                        seed = triangle;
+                        seedDistance = distance;
+                    }
+                }
+                while (seed == ~0u && cursor < rangeEnd) {
+                    if (!emitted[cursor]) {
+                        seed = cursor;
+                    }
+                    cursor++;
+                }
+                if (seed == ~0u) {
+                    break;
+                }
+
+                candidates.clear();
+                auto first = static_cast<uint32_t>(ordered.size());
+                uint32_t meshletVertices = 0;
+                uint32_t meshletTriangles = 0;
+                glm::vec3 centroidSum{0.0f};
+                uint32_t next = seed;
+                while (next != ~0u) {
+                    emitted[next] = true;
+                    meshletTriangles++;
+                    centroidSum += centroid(next);
+                    for (uint32_t k = 0; k < 3; k++) {
+                        uint32_t vertex = indices[next * 3 + k];
+                        ordered.push_back(vertex);
+                        if (vertexStamp[vertex] != id) {
+                            vertexStamp[vertex] = id;
+                            meshletVertices++;
+                        }
+                        uint32_t position = remap[vertex];
+                        positionStamp[position] = id;
+                        for (uint32_t a = adjacencyOffset[position]; a < adjacencyOffset[position + 1]; a++) {
+                            uint32_t neighbour = adjacency[a];
+                            if (!emitted[neighbour] && candidateStamp[neighbour] != id &&
+                                neighbour >= rangeBegin && neighbour < rangeEnd) {
+                                candidateStamp[neighbour] = id;
+                                candidates.push_back(neighbour);
+                            }
+                        }
+                    }
+                    if (meshletTriangles == MESHLET_MAX_TRIANGLES) {
+                        break;
+                    }
+
+                    glm::vec3 center = centroidSum / static_cast<float>(meshletTriangles);
+                    next = ~0u;
+                    uint32_t bestShared = 0;
+                    float bestDistance = 0.0f;
+                    size_t kept = 0;
+                    for (uint32_t triangle : candidates) {
+                        if (emitted[triangle]) {
+                            continue;
+                        }
+                        candidates[kept++] = triangle;
+
+                        uint32_t shared = 0;
+                        uint32_t added = 0;
+                        for (uint32_t k = 0; k < 3; k++) {
+                            uint32_t vertex = indices[triangle * 3 + k];
+                            shared += positionStamp[remap[vertex]] == id ? 1 : 0;
+                            added += vertexStamp[vertex] != id ? 1 : 0;
+                        }
+                        if (meshletVertices + added > MESHLET_MAX_VERTICES) {
+                            continue;
+                        }
+                        float distance = glm::length(centroid(triangle) - center);
+                        if (next == ~0u || shared > bestShared || (shared == bestShared && distance < bestDistance)) {
+                            next = triangle;
+                            bestShared = shared;
+                            bestDistance = distance;
+                        }
+                    }
+                    candidates.resize(kept);
+                }
+
+                bounds.emplace_back(first, static_cast<uint32_t>(ordered.size()) - first);
+                previousCenter = centroidSum / static_cast<float>(meshletTriangles);
+            }
+        }
+
+        // ranges keep their place, only the triangles within each one are reordered
+        std::copy(ordered.begin(), ordered.end(), builder.indices.begin());
+        builder.meshlets.reserve(bounds.size());
+        for (const auto &[first, count] : bounds) {
+            optimizeVertexCacheRange(builder.indices.data() + first, count);
+            builder.meshlets.push_back(makeMeshlet(builder, first, count));
+        }
+    }
+
+    CullView makeCullView(const glm::mat4 &viewProjection, const glm::mat4 &modelMatrix,
+                          const glm::vec3 &cameraPosition) {
+        // planes of the clip volume pulled back into model space, Vulkan depth is 0..1
+        glm::mat4 clip = glm::transpose(viewProjection * modelMatrix);
+        CullView view{};
+        view.planes[0] = clip[3] + clip[0];
+        view.planes[1] = clip[3] - clip[0];
+        view.planes[2] = clip[3] + clip[1];
+        view.planes[3] = clip[3] - clip[1];
+        view.planes[4] = clip[2];
+        view.planes[5] = clip[3] - clip[2];
+        for (auto &plane : view.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        view.cameraPosition = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(cameraPosition, 1.0f));
+        return view;
+    }
+
+    bool meshletVisible(const Model::Meshlet &meshlet, const CullView &view) {
+        for (const auto &plane : view.planes) {
+            if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius) {
+                return false;
+            }
+        }
+
+        // every normal lies within the cone around the axis, if the whole sphere is
+        // seen from behind that cone all triangles are back facing
+        glm::vec3 toCenter = meshlet.center - view.cameraPosition;
+        return glm::dot(toCenter, meshlet.coneAxis) <= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+    }
+
+} // namespace engine
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Model.h"
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace engine {
+
+    // Cluster limits, the sizes mesh shading hardware is tuned for.
+    constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+    constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+    // Splits LOD 0 of builder into builder.meshlets. Meshlets grow over shared
+    // positions so they stay spatially compact, and the triangles of every submesh
+    // are reordered so each meshlet is one contiguous index range. Meshlets never
+    // span two submeshes. Run optimizeVertexFetch afterwards.
+    void buildMeshlets(Model::Builder &builder);
+
+    // Frustum planes and camera position in the space of one model instance, so
+    // meshlet bounds can be tested without transforming them.
+    struct CullView {
+        // xyz inward normal, w distance, normalized
+        glm::vec4 planes[6];
+        glm::vec3 cameraPosition;
+    };
+
+    CullView makeCullView(const glm::mat4 &viewProjection, const glm::mat4 &modelMatrix,
+                          const glm::vec3 &cameraPosition);
+
+    // false if the meshlet is outside the frustum or all its triangles face away
+    bool meshletVisible(const Model::Meshlet &meshlet, const CullView &view);
+
+} // namespace engine
@@ -0,0 +1,163 @@
+#include "MipChain.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace engine {
+
+    namespace {
+
+        constexpr uint32_t CHANNELS = 4;
+        constexpr uint32_t ENCODE_STEPS = 4096;
+
+        struct SrgbTables {
+            std::array<float, 256> decode{};
+            std::array<uint8_t, ENCODE_STEPS + 1> encode{};
+
+            SrgbTables() {
+                for (uint32_t i = 0; i < decode.size(); i++) {
+                    float c = static_cast<float>(i) / 255.0f;
+                    decode[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                }
+                for (uint32_t i = 0; i <= ENCODE_STEPS; i++) {
+                    float l = static_cast<float>(i) / ENCODE_STEPS;
+                    float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                    encode[i] = static_cast<uint8_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+                }
+            }
+        };
+
+        const SrgbTables &srgbTables() {
+            static const SrgbTables tables;
+            return tables;
+        }
+
+        // Source columns of output pixel x, the last column is clamped for odd widths.
+        inline void sourceColumns(uint32_t x, uint32_t srcWidth, uint32_t &x0, uint32_t &x1) {
+            x0 = std::min(x * 2, srcWidth - 1) * CHANNELS;
+            x1 = std::min(x * 2 + 1, srcWidth - 1) * CHANNELS;
+        }
+
+        // Averages unorm channels. Pixels whose 2x2 footprint lies inside the row go
+        // through a loop without clamps or branches, only the odd last column doesn't.
+        void downsampleLinear(const uint8_t *row0, const uint8_t *row1, uint32_t srcWidth, uint8_t *out,
+                              uint32_t dstWidth) {
+            uint32_t inner = std::min(dstWidth, srcWidth / 2);
+            for (uint32_t i = 0; i < inner * CHANNELS; i++) {
+                uint32_t x0 = (i / CHANNELS) * 2 * CHANNELS + i % CHANNELS;
+                out[i] = static_cast<uint8_t>((row0[x0] + row0[x0 + CHANNELS] + row1[x0] + row1[x0 + CHANNELS] + 2) / 4);
+            }
+            for (uint32_t x = inner; x < dstWidth; x++) {
+                uint32_t x0, x1;
+                sourceColumns(x, srcWidth, x0, x1);
+                for (uint32_t c = 0; c < CHANNELS; c++) {
+                    out[x * CHANNELS + c] = static_cast<uint8_t>(
+                            (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+                }
+            }
+        }
+
+        // Averages color in linear space through the lookup tables, alpha as unorm.
+        // The table lookups keep this path scalar.
+        void downsampleSrgb(const uint8_t *row0, const uint8_t *row1, uint32_t srcWidth, uint8_t *out,
+                            uint32_t dstWidth) {
+            const SrgbTables &tables = srgbTables();
+            for (uint32_t x = 0; x < dstWidth; x++) {
+                uint32_t x0, x1;
+                sourceColumns(x, srcWidth, x0, x1);
+                for (uint32_t c = 0; c < 3; c++) {
+                    float l = (tables.decode[row0[x0 + c]] + tables.decode[row0[x1 + c]] +
+                               tables.decode[row1[x0 + c]] + tables.decode[row1[x1 + c]]) * 0.25f;
+                    out[x * CHANNELS + c] = tables.encode[static_cast<uint32_t>(l * ENCODE_STEPS + 0.5f)];
+                }
+                out[x * CHANNELS + 3] = static_cast<uint8_t>(
+                        (row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) / 4);
+            }
+        }
+
+        // 2x2 box filter of one layer, odd edges clamp to the last row/column. The
+        // color space is chosen once per layer, not per pixel.
+        void downsample(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight,
+                        uint8_t *dst, uint32_t dstWidth, uint32_t dstHeight, bool srgb) {
+            for (uint32_t y = 0; y < dstHeight; y++) {
+                const uint8_t *row0 = src + static_cast<size_t>(std::min(y * 2, srcHeight - 1)) * srcWidth * CHANNELS;
+                const uint8_t *row1 = src + static_cast<size_t>(std::min(y * 2 + 1, srcHeight - 1)) * srcWidth * CHANNELS;
+                uint8_t *out = dst + static_cast<size_t>(y) * dstWidth * CHANNELS;
+                if (srgb) {
+                    downsampleSrgb(row0, row1, srcWidth, out, dstWidth);
+                } else {
+                    downsampleLinear(row0, row1, srcWidth, out, dstWidth);
+                }
+            }
+        }
+
+    } // namespace
+
+    uint32_t mipLevelCount(VkExtent2D extent) {
+        return static_cast<uint32_t>(std::floor(std::log2(std::max(extent.width, extent.height)))) + 1;
+    }
+
+    bool supportsLinearBlit(VkPhysicalDevice physicalDevice, VkFormat format) {
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+        VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        return (formatProperties.optimalTilingFeatures & required) == required;
+    }
+
+    std::vector<uint8_t> buildMipChain(const uint8_t *pixels, VkExtent2D extent, uint32_t layerCount,
+                                       uint32_t levelCount, bool srgb, std::vector<VkBufferImageCopy> &regions) {
+        VkDeviceSize totalSize = 0;
+        uint32_t width = extent.width;
+        uint32_t height = extent.height;
+        for (uint32_t level = 0; level < levelCount; level++) {
+            totalSize += static_cast<VkDeviceSize>(width) * height * CHANNELS * layerCount;
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+
+        std::vector<uint8_t> chain(totalSize);
+        regions.clear();
+        regions.reserve(levelCount);
+
+        VkDeviceSize offset = 0;
+        VkDeviceSize previousOffset = 0;
+        width = extent.width;
+        height = extent.height;
+        for (uint32_t level = 0; level < levelCount; level++) {
+            VkDeviceSize layerSize = static_cast<VkDeviceSize>(width) * height * CHANNELS;
+
+            if (level == 0) {
+                std::memcpy(chain.data(), pixels, layerSize * layerCount);
+            } else {
+                uint32_t srcWidth = std::max(extent.width >> (level - 1), 1u);
+                uint32_t srcHeight = std::max(extent.height >> (level - 1), 1u);
+                VkDeviceSize srcLayerSize = static_cast<VkDeviceSize>(srcWidth) * srcHeight * CHANNELS;
+                for (uint32_t layer = 0; layer < layerCount; layer++) {
+                    downsample(chain.data() + previousOffset + layer * srcLayerSize, srcWidth, srcHeight,
+                               chain.data() + offset + layer * layerSize, width, height, srgb);
+                }
+            }
+
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = layerCount;
+            region.imageExtent = {width, height, 1};
+            regions.push_back(region);
+
+            previousOffset = offset;
+            offset += layerSize * layerCount;
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+
+        return chain;
+    }
+
+} // namespace engine
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace engine {
+
+    // Number of levels of a full mip chain down to 1x1.
+    uint32_t mipLevelCount(VkExtent2D extent);
+
+    // Whether mips of format can be generated with vkCmdBlitImage on this device.
+    bool supportsLinearBlit(VkPhysicalDevice physicalDevice, VkFormat format);
+
+    // CPU fallback for formats that cannot be blitted. Takes layerCount RGBA8 layers
+    // of extent stored back to back and returns every level of the chain, level by
+    // level with all layers of a level adjacent. regions receives one copy per level
+    // with buffer offsets relative to the returned data. With srgb the 2x2 box filter
+    // averages in linear space.
+    std::vector<uint8_t> buildMipChain(const uint8_t *pixels, VkExtent2D extent, uint32_t layerCount,
+                                       uint32_t levelCount, bool srgb, std::vector<VkBufferImageCopy> &regions);
+
+} // namespace engine
@@ -1,88 +1,95 @@
 #include "Model.h"
 #include "Error.h"
+#include "MeshCooker.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlet.h"
+#include "ObjLoader.h"
+#include "VertexQuantizer.h"
 
 #include <vulkan/vulkan_core.h>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-
-#include "Component.h"
-#include "tiny_obj_loader/tiny_obj_loader.h"
-
-#define GLM_ENABLE_EXPERIMENTAL
-
-#include <glm/gtx/hash.hpp>
-
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <memory>
 
-namespace std {
-    template<>
-    struct hash<engine::Model::Vertex> {
-        size_t operator()(engine::Model::Vertex const &vertex) const {
-            size_t seed = 0;
-            engine::HashCombine(seed, vertex.position, vertex.uv);
-            return seed;
-        }
-    };
-}
-
 namespace engine {
-    Model::Model(Device &device, const Builder &builder, uint32_t maxInstances)
+    Model::Model(Device &device, const Builder &builder, uint32_t maxInstances, VertexFormat format)
             : m_device(device), m_maxInstances(maxInstances) {
-        CreateVertexBuffers(builder.vertices);
-        CreateIndexBuffer(builder.indices);
         FindMinMaxExtent(builder.vertices);
+        CreateVertexBuffers(builder.vertices.data(), static_cast<uint32_t>(builder.vertices.size()), format);
+        CreateIndexBuffer(builder.indices.data(), static_cast<uint32_t>(builder.indices.size()));
+        m_lods = builder.lods;
+        if (m_lods.empty()) {
+            m_lods.push_back({0, m_IndexCount, 0.0f});
+        }
+        m_meshlets = builder.meshlets;
+        m_hostMemory = HostMemory(MemoryTag::Models, m_lods.size() * sizeof(Lod) + m_meshlets.size() * sizeof(Meshlet));
+        FindSolidBox(builder.vertices.data(), builder.indices.data(), m_lods[0].indexCount);
     }
 
-    void Model::CreateVertexBuffers(const std::vector<Vertex> &vertices) {
-        m_VertexCount = static_cast<uint32_t>(vertices.size());
-        assert(m_VertexCount >= 3 && "Vertex count must be at least 3");
-        VkDeviceSize bufferSize = sizeof(vertices[0]) * m_VertexCount;
-        uint32_t vertexSize = sizeof(vertices[0]);
+    Model::Model(Device &device, const CookedMesh &mesh, uint32_t maxInstances, VertexFormat format)
+            : m_device(device), m_maxInstances(maxInstances) {
+        mMinExtent = mesh.minExtent;
+        mMaxExtent = mesh.maxExtent;
+        CreateVertexBuffers(mesh.vertices, mesh.vertexCount, format);
+        CreateIndexBuffer(mesh.indices, mesh.indexCount);
+        m_lods.assign(mesh.lods, mesh.lods + mesh.lodCount);
+        m_meshlets.assign(mesh.meshlets, mesh.meshlets + mesh.meshletCount);
+        m_hostMemory = HostMemory(MemoryTag::Models, m_lods.size() * sizeof(Lod) + m_meshlets.size() * sizeof(Meshlet));
+        FindSolidBox(mesh.vertices, mesh.indices, m_lods.empty() ? m_IndexCount : m_lods[0].indexCount);
+    }
 
-        Buffer stagingBuffer{m_device,
-                vertexSize,
-                m_VertexCount,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        };
+    void Model::CreateVertexBuffers(const Vertex *vertices, uint32_t vertexCount, VertexFormat format) {
+        m_VertexCount = vertexCount;
+        m_vertexFormat = format;
+        assert(m_VertexCount >= 3 && "Vertex count must be at least 3");
 
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *) vertices.data());
+        const void *data = vertices;
+        uint32_t vertexSize = sizeof(Vertex);
+        std::vector<CompactVertex> compact;
+        if (format == VertexFormat::Compact) {
+            compact.resize(m_VertexCount);
+            compactVertices(vertices, m_VertexCount, mMinExtent, mMaxExtent, compact.data());
+            m_positionTransform = dequantizeTransform(mMinExtent, mMaxExtent);
+            data = compact.data();
+            vertexSize = sizeof(CompactVertex);
+        }
+        VkDeviceSize bufferSize = static_cast<VkDeviceSize>(vertexSize) * m_VertexCount;
 
         m_VertexBuffer = std::make_unique<Buffer>(m_device, vertexSize, m_VertexCount,
                                                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                  MemoryTag::Models
         );
 
-        m_device.copyBuffer(stagingBuffer.getBuffer(), m_VertexBuffer->getBuffer(), bufferSize);
+        m_device.uploads().uploadBuffer(m_VertexBuffer->getBuffer(), data, bufferSize);
     }
 
-    void Model::CreateIndexBuffer(const std::vector<uint32_t> &indices) {
-        m_IndexCount = static_cast<uint32_t>(indices.size());
+    void Model::CreateIndexBuffer(const uint32_t *indices, uint32_t indexCount) {
+        m_IndexCount = indexCount;
         m_HasIndexBuffer = m_IndexCount > 0;
 
         if (!m_HasIndexBuffer) {
             return;
         }
 
-        VkDeviceSize bufferSize = sizeof(indices[0]) * m_IndexCount;
-        uint32_t indexSize = sizeof(indices[0]);
-
-        Buffer stagingBuffer{
-            m_device,
-                indexSize,
-                m_IndexCount,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *) indices.data());
+        // 0xFFFF stays unused so the indices remain valid with primitive restart
+        const void *data = indices;
+        uint32_t indexSize = sizeof(uint32_t);
+        std::vector<uint16_t> shortIndices;
+        if (m_VertexCount < std::numeric_limits<uint16_t>::max()) {
+            shortIndices.assign(indices, indices + m_IndexCount);
+            data = shortIndices.data();
+            indexSize = sizeof(uint16_t);
+            m_IndexType = VK_INDEX_TYPE_UINT16;
+        }
+        VkDeviceSize bufferSize = static_cast<VkDeviceSize>(indexSize) * m_IndexCount;
 
         m_IndexBuffer = std::make_unique<Buffer>(
             m_device,
@@ -90,17 +97,43 @@ namespace engine {
                 m_IndexCount,
                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                MemoryTag::Models
         );
 
-        m_device.copyBuffer(stagingBuffer.getBuffer(), m_IndexBuffer->getBuffer(), bufferSize);
+        m_device.uploads().uploadBuffer(m_IndexBuffer->getBuffer(), data, bufferSize);
     }
 
-    void Model::Draw(VkCommandBuffer commandBuffer) const {
-        if (m_HasIndexBuffer) {
-            vkCmdDrawIndexed(commandBuffer, m_IndexCount, 1, 0, 0, 0);
-        } else {
+    void Model::Draw(VkCommandBuffer commandBuffer, uint32_t lod, const CullView *view) const {
+        if (!m_HasIndexBuffer) {
             vkCmdDraw(commandBuffer, m_VertexCount, 1, 0, 0);
+            return;
+        }
+
+        lod = std::min(lod, GetLodCount() - 1);
+        if (lod != 0 || !view || m_meshlets.size() < 2) {
+            vkCmdDrawIndexed(commandBuffer, m_lods[lod].indexCount, 1, m_lods[lod].firstIndex, 0, 0);
+            return;
+        }
+
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        for (const auto &meshlet : m_meshlets) {
+            if (!meshletVisible(meshlet, *view)) {
+                continue;
+            }
+            if (indexCount > 0 && firstIndex + indexCount == meshlet.firstIndex) {
+                indexCount += meshlet.indexCount;
+                continue;
+            }
+            if (indexCount > 0) {
+                vkCmdDrawIndexed(commandBuffer, indexCount, 1, firstIndex, 0, 0);
+            }
+            firstIndex = meshlet.firstIndex;
+            indexCount = meshlet.indexCount;
+        }
+        if (indexCount > 0) {
+            vkCmdDrawIndexed(commandBuffer, indexCount, 1, firstIndex, 0, 0);
         }
     }
 
@@ -110,17 +143,45 @@ namespace engine {
         vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
 
         if (m_HasIndexBuffer) {
-            vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+            vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer->getBuffer(), 0, m_IndexType);
         }
     }
 
     std::unique_ptr<Model> Model::CreateModelFromFile(Device &device, const std::string &filepath) {
+        if (isCookedMesh(filepath)) {
+            return std::make_unique<Model>(device, loadCookedMesh(filepath));
+        }
+
         Builder builder{};
         builder.LoadModel(filepath);
         std::cout << "Vertex count: " << builder.vertices.size() << std::endl;
         return std::make_unique<Model>(device, builder);
     }
 
+    uint32_t Model::SelectLod(const glm::mat4 &modelMatrix, const glm::vec3 &cameraPosition,
+                              float projectionScale) const {
+        if (m_lods.size() < 2 || projectionScale <= 0.0f) {
+            return 0;
+        }
+
+        // distance to the bounding sphere, the closest any part of the instance gets
+        float scale = std::max({glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1])),
+                                glm::length(glm::vec3(modelMatrix[2]))});
+        glm::vec3 center = modelMatrix * glm::vec4((mMinExtent + mMaxExtent) * 0.5f, 1.0f);
+        float radius = 0.5f * glm::length(mMaxExtent - mMinExtent) * scale;
+        float distance = glm::length(center - cameraPosition) - radius;
+        if (distance <= 0.0f) {
+            return 0;
+        }
+
+        float pixelsPerUnit = projectionScale * scale / distance;
+        uint32_t lod = 0;
+        while (lod + 1 < m_lods.size() && m_lods[lod + 1].error * pixelsPerUnit <= LOD_PIXEL_ERROR) {
+            lod++;
+        }
+        return lod;
+    }
+
     glm::vec3 Model::GetMinExtents() const {
         return mMinExtent;
     }
@@ -144,6 +205,39 @@ namespace engine {
         }
     }
 
+    void Model::FindSolidBox(const Vertex *vertices, const uint32_t *indices, uint32_t indexCount) {
+        m_solidBox = false;
+        glm::vec3 size = mMaxExtent - mMinExtent;
+        if (indexCount < 36 || size.x <= 0.0f || size.y <= 0.0f || size.z <= 0.0f) {
+            return;
+        }
+
+        // every triangle has to lie in one face of the box and together they have to
+        // cover its whole surface
+        float epsilon = 1e-4f * glm::length(size);
+        double area = 0.0;
+        for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+            glm::vec3 a = vertices[indices[i]].position;
+            glm::vec3 b = vertices[indices[i + 1]].position;
+            glm::vec3 c = vertices[indices[i + 2]].position;
+            bool onFace = false;
+            for (int axis = 0; axis < 3 && !onFace; axis++) {
+                for (float face : {mMinExtent[axis], mMaxExtent[axis]}) {
+                    onFace |= std::abs(a[axis] - face) <= epsilon && std::abs(b[axis] - face) <= epsilon &&
+                              std::abs(c[axis] - face) <= epsilon;
+                }
+            }
+            if (!onFace) {
+                return;
+            }
+            area += 0.5 * glm::length(glm::cross(b - a, c - a));
+        }
+
+        double surface = 2.0 * (static_cast<double>(size.x) * size.y + static_cast<double>(size.y) * size.z +
+                                static_cast<double>(size.z) * size.x);
+        m_solidBox = std::abs(area - surface) <= 1e-3 * surface;
+    }
+
     std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingsDescriptions() {
         std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
         bindingDescriptions[0].binding = 0;
@@ -163,77 +257,59 @@ namespace engine {
         return attributeDescriptions;
     }
 
+    std::vector<VkVertexInputBindingDescription> Model::CompactVertex::getBindingsDescriptions() {
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+        bindingDescriptions[0].binding = 0;
+        bindingDescriptions[0].stride = sizeof(CompactVertex);
+        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescriptions;
+    }
+
+    std::vector<VkVertexInputAttributeDescription>
+    Model::CompactVertex::getAttributeDescriptions() {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+        attributeDescriptions.push_back({0, 0, VK_FORMAT_R16G16B16A16_UNORM, (uint32_t) offsetof(CompactVertex, position)});
+        attributeDescriptions.push_back({1, 0, VK_FORMAT_R16G16_SNORM, (uint32_t) offsetof(CompactVertex, normal)});
+        attributeDescriptions.push_back({2, 0, VK_FORMAT_R16G16_SFLOAT, (uint32_t) offsetof(CompactVertex, uv)});
+
+        return attributeDescriptions;
+    }
+
+    std::vector<VkVertexInputBindingDescription> Model::getBindingsDescriptions(VertexFormat format) {
+        return format == VertexFormat::Compact ? CompactVertex::getBindingsDescriptions()
+                                               : Vertex::getBindingsDescriptions();
+    }
+
+    std::vector<VkVertexInputAttributeDescription> Model::getAttributeDescriptions(VertexFormat format) {
+        return format == VertexFormat::Compact ? CompactVertex::getAttributeDescriptions()
+                                               : Vertex::getAttributeDescriptions();
+    }
+
     bool Model::Builder::LoadModel(const std::string &filepath) {
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string err;
-
-        std::string mtlDir = filepath.substr(0, filepath.find_last_of('/') + 1);
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filepath.c_str(), mtlDir.c_str())) {
-//            ERROR(err);
+        try {
+            loadObj(filepath, *this);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
             return false;
         }
 
-        vertices.clear();
-        indices.clear();
-
-        std::unordered_map<Vertex, uint64_t> uniqueVertices{};
-        for (const auto &shape: shapes) {
-            size_t indexOffset = 0;
-            for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
-                int fv = shape.mesh.num_face_vertices[f];
-
-                // Get the material ID for the current face
-                int materialId = shape.mesh.material_ids[f];
-
-                for (size_t v = 0; v < fv; v++) {
-                    tinyobj::index_t index = shape.mesh.indices[indexOffset + v];
-
-                    Vertex vertex{};
-
-                    if (index.vertex_index >= 0) {
-                        vertex.position = {
-                                attrib.vertices[3 * index.vertex_index + 0],
-                                attrib.vertices[3 * index.vertex_index + 1],
-                                attrib.vertices[3 * index.vertex_index + 2]
-                        };
-                    }
-
-                    if (index.normal_index >= 0) {
-                        vertex.normal = {
-                                attrib.normals[3 * index.normal_index + 0],
-                                attrib.normals[3 * index.normal_index + 1],
-                                attrib.normals[3 * index.normal_index + 2]
-                        };
-                    }
-
-                    if (index.texcoord_index >= 0) {
-                        vertex.uv = {
-                                attrib.texcoords[2 * index.texcoord_index + 0],
-                                1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-                        };
-                    }
-
-                    // Use the material ID to access the corresponding material
-                    if (materialId >= 0 && materialId < materials.size()) {
-                        const tinyobj::material_t &material = materials[materialId];
-                        // Access material properties, texture maps, etc.
-                        // For example, to get the diffuse texture map:
-                        std::string diffuseTexName = material.diffuse_texname;
-                        // Load and assign the diffuse texture index to the vertex
-                    }
-
-                    if (uniqueVertices.count(vertex) == 0) {
-                        uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                        vertices.push_back(vertex);
-                    }
-                    indices.push_back(uniqueVertices[vertex]);
-                }
-                indexOffset += fv;
-            }
-        }
+        MeshOptimizeStats stats = optimizeMesh(*this);
 
+        // meshlets regroup the triangles, so vertices are put back in fetch order
+        buildMeshlets(*this);
+        optimizeVertexFetch(vertices, indices);
+
+        // measured on the order that is actually drawn, before the LODs are appended
+        float acmr = averageCacheMissRatio(indices.data(), indices.size(), static_cast<uint32_t>(vertices.size()));
+        std::cout << filepath << ": ACMR " << stats.acmrBefore << " -> " << acmr
+                  << " (FIFO " << VERTEX_CACHE_SIZE << ")" << std::endl;
+        generateLods(*this);
+        std::cout << filepath << ": " << meshlets.size() << " meshlets, LOD triangles";
+        for (const auto &lod : lods) {
+            std::cout << " " << lod.indexCount / 3;
+        }
+        std::cout << std::endl;
         return true;
     }
 } // namespace engine
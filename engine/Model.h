@@ -13,6 +13,9 @@
 
 class transform;
 namespace engine {
+    struct CookedMesh;
+    struct CullView;
+
     class Model {
     public:
         struct Vertex {
@@ -31,14 +34,81 @@ namespace engine {
             }
         };
 
+        // Half the size of Vertex: position as 16 bit unorm inside the mesh bounds,
+        // normal octahedral encoded as two snorms and uv as half floats. The bounds
+        // are undone by GetPositionTransform, normals by the vertex shader.
+        struct CompactVertex {
+            uint16_t position[4]{};
+            int16_t normal[2]{};
+            uint16_t uv[2]{};
+
+            static std::vector<VkVertexInputBindingDescription>
+            getBindingsDescriptions();
+
+            static std::vector<VkVertexInputAttributeDescription>
+            getAttributeDescriptions();
+        };
+
+        enum class VertexFormat {
+            Full,
+            Compact
+        };
+
+        static std::vector<VkVertexInputBindingDescription> getBindingsDescriptions(VertexFormat format);
+
+        static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(VertexFormat format);
+
+        // index range of one OBJ shape
+        struct Submesh {
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            int32_t materialId;
+        };
+
+        // index range of one level of detail, error is how far its surface deviates
+        // from the full detail mesh in model units
+        struct Lod {
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            float error;
+        };
+
+        // cluster of LOD 0 culled on its own, a bounding sphere and the cone that
+        // holds all triangle normals, in model space
+        struct Meshlet {
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            glm::vec3 center;
+            float radius;
+            glm::vec3 coneAxis;
+            float coneCutoff;
+        };
+
         struct Builder {
             std::vector<Vertex> vertices{};
             std::vector<uint32_t> indices{};
-
+            // ranges of LOD 0
+            std::vector<Submesh> submeshes{};
+            // LOD 0 first, the coarser levels index the same vertices, empty means the
+            // whole index buffer is the only level
+            std::vector<Lod> lods{};
+            // consecutive ranges covering LOD 0
+            std::vector<Meshlet> meshlets{};
+
+            // parses the OBJ, reorders it for the post-transform cache and vertex fetch,
+            // clusters it into meshlets and appends the LOD chain
             bool LoadModel(const std::string &filepath);
         };
 
-        Model(Device &device, const Builder &builder, uint32_t maxInstances = 2);
+        // largest error a selected LOD may show on screen, in pixels
+        static constexpr float LOD_PIXEL_ERROR = 1.0f;
+
+        Model(Device &device, const Builder &builder, uint32_t maxInstances = 2,
+              VertexFormat format = VertexFormat::Full);
+
+        // uploads straight from the mapped file, the mesh can be dropped once this returns
+        Model(Device &device, const CookedMesh &mesh, uint32_t maxInstances = 2,
+              VertexFormat format = VertexFormat::Full);
 
         ~Model() = default;
 
@@ -46,36 +116,67 @@ namespace engine {
 
         Model &operator=(const Model &) = delete;
 
+        // .cmesh files are mapped, anything else goes through Builder::LoadModel
         static std::unique_ptr<Model> CreateModelFromFile(Device &device, const std::string &filepath);
 
         void Bind(VkCommandBuffer commandBuffer);
 
-        void Draw(VkCommandBuffer commandBuffer) const;
+        // with a view, LOD 0 only draws the meshlets passing meshletVisible, one
+        // draw per run of consecutive visible meshlets
+        void Draw(VkCommandBuffer commandBuffer, uint32_t lod = 0, const CullView *view = nullptr) const;
+
+        uint32_t GetLodCount() const { return static_cast<uint32_t>(m_lods.size()); }
+
+        // Coarsest LOD whose error stays below LOD_PIXEL_ERROR for an instance drawn
+        // with modelMatrix. projectionScale is the height in pixels one world unit
+        // covers at distance 1 from cameraPosition, 0 always selects LOD 0.
+        uint32_t SelectLod(const glm::mat4 &modelMatrix, const glm::vec3 &cameraPosition, float projectionScale) const;
 
         glm::vec3 GetMinExtents() const;
         glm::vec3 GetMaxExtents() const;
 
+        // true if LOD 0 is exactly the closed surface of the extents, such models
+        // stand in for their box as occluders, see OcclusionCuller
+        bool IsSolidBox() const { return m_solidBox; }
+
+        VertexFormat GetVertexFormat() const { return m_vertexFormat; }
+
+        // maps the vertex buffer's positions to model space, identity for full vertices
+        // and the dequantization of compact ones, applied before the model matrix
+        const glm::mat4 &GetPositionTransform() const { return m_positionTransform; }
 
     private:
-        void CreateVertexBuffers(const std::vector<Vertex> &vertices);
+        void CreateVertexBuffers(const Vertex *vertices, uint32_t vertexCount, VertexFormat format);
 
-        void CreateIndexBuffer(const std::vector<uint32_t> &indices);
+        // 16 bit indices for meshes whose vertices all fit below the largest uint16
+        void CreateIndexBuffer(const uint32_t *indices, uint32_t indexCount);
 
         void FindMinMaxExtent(const std::vector<Vertex> &vertices);
 
+        void FindSolidBox(const Vertex *vertices, const uint32_t *indices, uint32_t indexCount);
+
         Device &m_device;
 
         std::unique_ptr<Buffer> m_VertexBuffer;
         uint32_t m_VertexCount;
 
+        VertexFormat m_vertexFormat{VertexFormat::Full};
+        glm::mat4 m_positionTransform{1.0f};
+
         bool m_HasIndexBuffer{false};
         std::unique_ptr<Buffer> m_IndexBuffer;
         uint32_t m_IndexCount;
+        VkIndexType m_IndexType{VK_INDEX_TYPE_UINT32};
+        std::vector<Lod> m_lods;
+        std::vector<Meshlet> m_meshlets;
+        // the LODs and meshlets kept for culling
+        HostMemory m_hostMemory;
 
         std::unique_ptr<Buffer> m_instanceBuffer;
         uint32_t m_instanceCount;
         uint32_t m_maxInstances;
 
         glm::vec3 mMinExtent, mMaxExtent;
+        bool m_solidBox{false};
     };
 } // namespace engine
@@ -0,0 +1,602 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+
+// materials are still read through tinyobjloader, mtl files are tiny
+#define TINYOBJLOADER_IMPLEMENTATION
+
+#include "tiny_obj_loader/tiny_obj_loader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace engine {
+
+    namespace {
+        // files below this are parsed on the calling thread alone
+        constexpr size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+        enum RelativeIndex : uint32_t {
+            RELATIVE_POSITION = 1,
+            RELATIVE_TEXCOORD = 2,
+            RELATIVE_NORMAL = 4,
+        };
+
+        // One triangle corner, -1 marks a missing attribute. Negative OBJ indices are
+        // resolved against the chunk's own counts and rebased once all chunks are parsed.
+        struct Corner {
+            int32_t position{-1};
+            int32_t texcoord{-1};
+            int32_t normal{-1};
+            uint32_t relative{0};
+        };
+
+        // statements that tinyobjloader processes in file order
+        struct Directive {
+            enum class Kind { UseMaterial, MaterialLibrary, Group };
+
+            Kind kind;
+            // faces and triangles of the chunk parsed before the directive
+            uint32_t faceCount;
+            uint32_t triangleCount;
+            std::string argument;
+        };
+
+        struct Chunk {
+            const char *begin;
+            const char *end;
+
+            std::vector<float> positions;
+            std::vector<float> normals;
+            std::vector<float> texcoords;
+            std::vector<Corner> corners;
+            std::vector<Directive> directives;
+            uint32_t faceCount{0};
+
+            uint32_t positionBase{0};
+            uint32_t normalBase{0};
+            uint32_t texcoordBase{0};
+            uint32_t triangleBase{0};
+            uint32_t firstIndex{0};
+
+            std::vector<Model::Vertex> vertices;
+            std::vector<uint32_t> indices;
+            std::vector<uint32_t> remap;
+
+            [[nodiscard]] uint32_t triangleCount() const { return static_cast<uint32_t>(corners.size() / 3); }
+        };
+
+        // triangle ranges tinyobjloader loses when a usemtl is directly followed by g or o
+        struct TriangleRange {
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        // hashes the bits, with -0 folded into +0 to stay consistent with Vertex::operator==
+        size_t hashVertex(const Model::Vertex &vertex) {
+            const float values[] = {vertex.position.x, vertex.position.y, vertex.position.z,
+                                    vertex.normal.x, vertex.normal.y, vertex.normal.z,
+                                    vertex.uv.x, vertex.uv.y};
+            size_t seed = 0;
+            for (float value : values) {
+                uint32_t bits = 0;
+                if (value != 0.0f) {
+                    std::memcpy(&bits, &value, sizeof(bits));
+                }
+                HashCombine(seed, bits);
+            }
+            return seed;
+        }
+
+        // Open addressing set of vertex indices, the vertices themselves live in the
+        // vector passed to find. Far fewer allocations than an unordered_map.
+        class VertexTable {
+        public:
+            explicit VertexTable(size_t expected) {
+                size_t capacity = 16;
+                while (capacity < expected * 2) {
+                    capacity *= 2;
+                }
+                m_slots.assign(capacity, EMPTY);
+            }
+
+            // index of vertex in vertices, appended if it is not there yet
+            uint32_t find(const Model::Vertex &vertex, std::vector<Model::Vertex> &vertices) {
+                if ((vertices.size() + 1) * 2 > m_slots.size()) {
+                    grow(vertices);
+                }
+
+                size_t mask = m_slots.size() - 1;
+                for (size_t slot = hashVertex(vertex) & mask;; slot = (slot + 1) & mask) {
+                    uint32_t index = m_slots[slot];
+                    if (index == EMPTY) {
+                        m_slots[slot] = static_cast<uint32_t>(vertices.size());
+                        vertices.push_back(vertex);
+                        return m_slots[slot];
+                    }
+                    if (vertices[index] == vertex) {
+                        return index;
+                    }
+                }
+            }
+
+        private:
+            static constexpr uint32_t EMPTY = ~0u;
+
+            void grow(const std::vector<Model::Vertex> &vertices) {
+                m_slots.assign(m_slots.size() * 2, EMPTY);
+                size_t mask = m_slots.size() - 1;
+                for (uint32_t index = 0; index < vertices.size(); index++) {
+                    size_t slot = hashVertex(vertices[index]) & mask;
+                    while (m_slots[slot] != EMPTY) {
+                        slot = (slot + 1) & mask;
+                    }
+                    m_slots[slot] = index;
+                }
+            }
+
+            std::vector<uint32_t> m_slots;
+        };
+
+        bool isSpace(char c) {
+            return c == ' ' || c == '\t';
+        }
+
+        bool isDigit(char c) {
+            return static_cast<unsigned>(c - '0') < 10;
+        }
+
+        char charAt(const char *p, const char *end, size_t offset) {
+            return p + offset < end ? p[offset] : '\0';
+        }
+
+        const char *skipSpaces(const char *p, const char *end) {
+            while (p < end && isSpace(*p)) {
+                p++;
+            }
+            return p;
+        }
+
+        bool isTokenEnd(char c) {
+            return c == ' ' || c == '\t' || c == '\r' || c == '\0';
+        }
+
+        bool isIndexEnd(char c) {
+            return c == '/' || isTokenEnd(c);
+        }
+
+        template<typename Stop>
+        const char *skipUntil(const char *p, const char *end, Stop stop) {
+            while (p < end && !stop(*p)) {
+                p++;
+            }
+            return p;
+        }
+
+        // atoi semantics, the cursor is left where it was
+        int parseInt(const char *p, const char *end) {
+            while (p < end && (isSpace(*p) || *p == '\v' || *p == '\f' || *p == '\r' || *p == '\n')) {
+                p++;
+            }
+            bool negative = p < end && *p == '-';
+            if (p < end && (*p == '-' || *p == '+')) {
+                p++;
+            }
+            int value = 0;
+            std::from_chars(p, end, value);
+            return negative ? -value : value;
+        }
+
+        // Same grammar as tinyobjloader: an optional sign followed by at least one
+        // digit, anything else yields 0. The value is rounded through double as there.
+        float parseFloat(const char *&p, const char *end) {
+            p = skipSpaces(p, end);
+            const char *tokenEnd = skipUntil(p, end, isTokenEnd);
+            const char *first = p;
+            p = tokenEnd;
+
+            const char *digits = first < tokenEnd && (*first == '+' || *first == '-') ? first + 1 : first;
+            if (digits == tokenEnd || !isDigit(*digits)) {
+                return 0.0f;
+            }
+
+            double value = 0.0;
+            auto [last, error] = std::from_chars(*first == '+' ? digits : first, tokenEnd, value);
+            // tinyobjloader rejects an exponent without digits instead of stopping before
+            // it, an e after a complete exponent is ignored like any other trailing text
+            auto isExponent = [](char c) { return c == 'e' || c == 'E'; };
+            if (error != std::errc{} ||
+                (last != tokenEnd && isExponent(*last) && std::none_of(first, last, isExponent))) {
+                return 0.0f;
+            }
+            return static_cast<float>(value);
+        }
+
+        int32_t parseIndex(const char *p, const char *end, uint32_t localCount, uint32_t relativeBit, Corner &corner) {
+            int index = parseInt(p, end);
+            if (index > 0) {
+                return index - 1;
+            }
+            if (index == 0) {
+                return 0;
+            }
+            corner.relative |= relativeBit;
+            return static_cast<int32_t>(localCount) + index;
+        }
+
+        // v, v/vt, v//vn and v/vt/vn
+        Corner parseCorner(const char *&p, const char *end, const Chunk &chunk) {
+            Corner corner{};
+            auto positions = static_cast<uint32_t>(chunk.positions.size() / 3);
+            auto texcoords = static_cast<uint32_t>(chunk.texcoords.size() / 2);
+            auto normals = static_cast<uint32_t>(chunk.normals.size() / 3);
+
+            corner.position = parseIndex(p, end, positions, RELATIVE_POSITION, corner);
+            p = skipUntil(p, end, isIndexEnd);
+            if (charAt(p, end, 0) != '/') {
+                return corner;
+            }
+            p++;
+
+            if (charAt(p, end, 0) == '/') {
+                p++;
+                corner.normal = parseIndex(p, end, normals, RELATIVE_NORMAL, corner);
+                p = skipUntil(p, end, isIndexEnd);
+                return corner;
+            }
+
+            corner.texcoord = parseIndex(p, end, texcoords, RELATIVE_TEXCOORD, corner);
+            p = skipUntil(p, end, isIndexEnd);
+            if (charAt(p, end, 0) != '/') {
+                return corner;
+            }
+            p++;
+
+            corner.normal = parseIndex(p, end, normals, RELATIVE_NORMAL, corner);
+            p = skipUntil(p, end, isIndexEnd);
+            return corner;
+        }
+
+        // first whitespace separated word, like sscanf("%s")
+        std::string parseWord(const char *p, const char *end) {
+            while (p < end && std::isspace(static_cast<unsigned char>(*p))) {
+                p++;
+            }
+            const char *wordEnd = p;
+            while (wordEnd < end && *wordEnd != '\0' && !std::isspace(static_cast<unsigned char>(*wordEnd))) {
+                wordEnd++;
+            }
+            return {p, wordEnd};
+        }
+
+        void parseLine(const char *p, const char *end, Chunk &chunk, std::vector<Corner> &face) {
+            p = skipSpaces(p, end);
+            if (p == end || *p == '\0' || *p == '#') {
+                return;
+            }
+
+            char c0 = p[0];
+            char c1 = charAt(p, end, 1);
+            if (c0 == 'v' && isSpace(c1)) {
+                p += 2;
+                for (int i = 0; i < 3; i++) {
+                    chunk.positions.push_back(parseFloat(p, end));
+                }
+            } else if (c0 == 'v' && c1 == 'n' && isSpace(charAt(p, end, 2))) {
+                p += 3;
+                for (int i = 0; i < 3; i++) {
+                    chunk.normals.push_back(parseFloat(p, end));
+                }
+            } else if (c0 == 'v' && c1 == 't' && isSpace(charAt(p, end, 2))) {
+                p += 3;
+                for (int i = 0; i < 2; i++) {
+                    chunk.texcoords.push_back(parseFloat(p, end));
+                }
+            } else if (c0 == 'f' && isSpace(c1)) {
+                p = skipSpaces(p + 2, end);
+                face.clear();
+                while (p < end && *p != '\0') {
+                    face.push_back(parseCorner(p, end, chunk));
+                    while (p < end && (isSpace(*p) || *p == '\r')) {
+                        p++;
+                    }
+                }
+
+                // triangle fan, as tinyobjloader triangulates
+                for (size_t k = 2; k < face.size(); k++) {
+                    chunk.corners.push_back(face[0]);
+                    chunk.corners.push_back(face[k - 1]);
+                    chunk.corners.push_back(face[k]);
+                }
+                chunk.faceCount++;
+            } else if (end - p > 6 && std::strncmp(p, "usemtl", 6) == 0 && isSpace(p[6])) {
+                chunk.directives.push_back({Directive::Kind::UseMaterial, chunk.faceCount, chunk.triangleCount(),
+                                            parseWord(p + 7, end)});
+            } else if (end - p > 6 && std::strncmp(p, "mtllib", 6) == 0 && isSpace(p[6])) {
+                chunk.directives.push_back({Directive::Kind::MaterialLibrary, chunk.faceCount, chunk.triangleCount(),
+                                            std::string(p + 7, end)});
+            } else if ((c0 == 'g' || c0 == 'o') && isSpace(c1)) {
+                chunk.directives.push_back({Directive::Kind::Group, chunk.faceCount, chunk.triangleCount(), {}});
+            }
+        }
+
+        void parseChunk(Chunk &chunk) {
+            std::vector<Corner> face;
+            const char *p = chunk.begin;
+            while (p < chunk.end) {
+                const char *lineEnd = p;
+                while (lineEnd < chunk.end && *lineEnd != '\n' && *lineEnd != '\r') {
+                    lineEnd++;
+                }
+                parseLine(p, lineEnd, chunk, face);
+                p = lineEnd + 1;
+            }
+        }
+
+        // Replays usemtl, mtllib, g and o across all chunks the way tinyobjloader
+        // groups faces into shapes, producing one submesh per shape it would emit.
+        class ShapeTracker {
+        public:
+            explicit ShapeTracker(const std::string &materialDir) : m_materialReader{materialDir} {}
+
+            void addFaces(uint32_t faces, uint32_t triangles) {
+                m_pendingFaces += faces;
+                m_pendingTriangles += triangles;
+            }
+
+            void apply(const Directive &directive) {
+                switch (directive.kind) {
+                    case Directive::Kind::UseMaterial: {
+                        auto it = m_materialMap.find(directive.argument);
+                        int material = it != m_materialMap.end() ? it->second : -1;
+                        if (material != m_material) {
+                            exportFaces();
+                            m_material = material;
+                        }
+                        break;
+                    }
+                    case Directive::Kind::MaterialLibrary:
+                        loadMaterials(directive.argument);
+                        break;
+                    case Directive::Kind::Group:
+                        if (exportFaces()) {
+                            pushShape();
+                        } else {
+                            dropShape();
+                        }
+                        break;
+                }
+            }
+
+            void finish() {
+                if (exportFaces() || m_shapeTriangles > 0) {
+                    pushShape();
+                }
+            }
+
+            [[nodiscard]] const std::vector<Model::Submesh> &submeshes() const { return m_submeshes; }
+
+            [[nodiscard]] const std::vector<TriangleRange> &dropped() const { return m_dropped; }
+
+        private:
+            bool exportFaces() {
+                if (m_pendingFaces == 0) {
+                    return false;
+                }
+                if (m_shapeTriangles == 0 && m_pendingTriangles > 0) {
+                    m_shapeMaterial = m_material;
+                }
+                m_shapeTriangles += m_pendingTriangles;
+                m_pendingFaces = 0;
+                m_pendingTriangles = 0;
+                return true;
+            }
+
+            void pushShape() {
+                m_submeshes.push_back({m_keptTriangles * 3, m_shapeTriangles * 3, m_shapeMaterial});
+                m_keptTriangles += m_shapeTriangles;
+                resetShape();
+            }
+
+            void dropShape() {
+                if (m_shapeTriangles > 0) {
+                    m_dropped.push_back({m_shapeBegin, m_shapeBegin + m_shapeTriangles});
+                }
+                resetShape();
+            }
+
+            void resetShape() {
+                m_shapeBegin += m_shapeTriangles;
+                m_shapeTriangles = 0;
+                m_shapeMaterial = -1;
+            }
+
+            void loadMaterials(const std::string &filenames) {
+                std::stringstream stream{filenames};
+                std::string filename;
+                while (std::getline(stream, filename, ' ')) {
+                    std::string warning;
+                    if (m_materialReader(filename, &m_materials, &m_materialMap, &warning)) {
+                        return;
+                    }
+                }
+            }
+
+            tinyobj::MaterialFileReader m_materialReader;
+            std::vector<tinyobj::material_t> m_materials;
+            std::map<std::string, int> m_materialMap;
+            int m_material{-1};
+
+            uint32_t m_pendingFaces{0};
+            uint32_t m_pendingTriangles{0};
+            uint32_t m_shapeBegin{0};
+            uint32_t m_shapeTriangles{0};
+            int m_shapeMaterial{-1};
+            uint32_t m_keptTriangles{0};
+
+            std::vector<Model::Submesh> m_submeshes;
+            std::vector<TriangleRange> m_dropped;
+        };
+
+        int32_t resolve(int32_t index, uint32_t relativeBit, const Corner &corner, uint32_t base) {
+            return corner.relative & relativeBit ? index + static_cast<int32_t>(base) : index;
+        }
+
+        template<size_t N>
+        const float *attribute(const std::vector<float> &values, int32_t index, const char *name) {
+            if (static_cast<size_t>(index) >= values.size() / N) {
+                throw std::runtime_error(std::string("obj ") + name + " index out of range: " + std::to_string(index + 1));
+            }
+            return values.data() + static_cast<size_t>(index) * N;
+        }
+
+        // deduplicates the chunk's kept corners against a chunk local table
+        void buildVertices(Chunk &chunk, const std::vector<TriangleRange> &dropped, const std::vector<float> &positions,
+                           const std::vector<float> &normals, const std::vector<float> &texcoords) {
+            VertexTable table{chunk.corners.size() / 2};
+            chunk.indices.reserve(chunk.corners.size());
+
+            auto range = dropped.begin();
+            for (uint32_t triangle = 0; triangle < chunk.triangleCount(); triangle++) {
+                uint32_t global = chunk.triangleBase + triangle;
+                while (range != dropped.end() && range->end <= global) {
+                    ++range;
+                }
+                if (range != dropped.end() && range->begin <= global) {
+                    continue;
+                }
+
+                for (uint32_t i = 0; i < 3; i++) {
+                    const Corner &corner = chunk.corners[triangle * 3 + i];
+                    Model::Vertex vertex{};
+
+                    int32_t position = resolve(corner.position, RELATIVE_POSITION, corner, chunk.positionBase);
+                    if (position >= 0) {
+                        const float *p = attribute<3>(positions, position, "vertex");
+                        vertex.position = {p[0], p[1], p[2]};
+                    }
+
+                    int32_t normal = resolve(corner.normal, RELATIVE_NORMAL, corner, chunk.normalBase);
+                    if (normal >= 0) {
+                        const float *n = attribute<3>(normals, normal, "normal");
+                        vertex.normal = {n[0], n[1], n[2]};
+                    }
+
+                    int32_t texcoord = resolve(corner.texcoord, RELATIVE_TEXCOORD, corner, chunk.texcoordBase);
+                    if (texcoord >= 0) {
+                        const float *t = attribute<2>(texcoords, texcoord, "texcoord");
+                        vertex.uv = {t[0], 1.0f - t[1]};
+                    }
+
+                    chunk.indices.push_back(table.find(vertex, chunk.vertices));
+                }
+            }
+
+            std::vector<Corner>().swap(chunk.corners);
+        }
+    } // namespace
+
+    void loadObj(const std::string &filepath, Model::Builder &builder, uint32_t chunkCount) {
+        MappedFile file{filepath};
+        const char *data = reinterpret_cast<const char *>(file.data());
+        size_t size = file.size();
+
+        // split at line starts, a boundary right inside \r\n just adds an empty line
+        if (chunkCount == 0) {
+            chunkCount = static_cast<uint32_t>(std::clamp<size_t>(size / MIN_CHUNK_SIZE, 1,
+                                                                  std::max(std::thread::hardware_concurrency(), 1u)));
+        }
+        std::vector<Chunk> chunks(chunkCount);
+        for (uint32_t i = 0; i < chunkCount; i++) {
+            const char *begin = data + size * i / chunkCount;
+            if (i > 0) {
+                while (begin < data + size && begin[-1] != '\n' && begin[-1] != '\r') {
+                    begin++;
+                }
+            }
+            chunks[i].begin = begin;
+            if (i > 0) {
+                chunks[i - 1].end = begin;
+            }
+        }
+        chunks.back().end = data + size;
+
+        parallelFor(chunkCount, [&](uint32_t i) { parseChunk(chunks[i]); });
+
+        // global attribute tables and the base every chunk's relative indices refer to
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<float> texcoords;
+        std::string materialDir = filepath.substr(0, filepath.find_last_of('/') + 1);
+        ShapeTracker shapes{materialDir};
+        uint32_t triangleBase = 0;
+        for (auto &chunk : chunks) {
+            chunk.positionBase = static_cast<uint32_t>(positions.size() / 3);
+            chunk.normalBase = static_cast<uint32_t>(normals.size() / 3);
+            chunk.texcoordBase = static_cast<uint32_t>(texcoords.size() / 2);
+            chunk.triangleBase = triangleBase;
+            positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+            normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+            texcoords.insert(texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+
+            uint32_t faces = 0;
+            uint32_t triangles = 0;
+            for (const auto &directive : chunk.directives) {
+                shapes.addFaces(directive.faceCount - faces, directive.triangleCount - triangles);
+                faces = directive.faceCount;
+                triangles = directive.triangleCount;
+                shapes.apply(directive);
+            }
+            shapes.addFaces(chunk.faceCount - faces, chunk.triangleCount() - triangles);
+            triangleBase += chunk.triangleCount();
+        }
+        shapes.finish();
+
+        const std::vector<TriangleRange> &dropped = shapes.dropped();
+        parallelFor(chunkCount, [&](uint32_t i) {
+            buildVertices(chunks[i], dropped, positions, normals, texcoords);
+        });
+
+        builder.vertices.clear();
+        builder.indices.clear();
+        builder.submeshes = shapes.submeshes();
+        if (chunkCount == 1) {
+            builder.vertices = std::move(chunks[0].vertices);
+            builder.indices = std::move(chunks[0].indices);
+            return;
+        }
+
+        // merging in chunk order keeps every vertex at its first use in the whole file
+        size_t vertexCount = 0;
+        for (const auto &chunk : chunks) {
+            vertexCount += chunk.vertices.size();
+        }
+        VertexTable table{vertexCount};
+        uint32_t indexCount = 0;
+        for (auto &chunk : chunks) {
+            chunk.firstIndex = indexCount;
+            indexCount += static_cast<uint32_t>(chunk.indices.size());
+
+            chunk.remap.resize(chunk.vertices.size());
+            for (size_t i = 0; i < chunk.vertices.size(); i++) {
+                chunk.remap[i] = table.find(chunk.vertices[i], builder.vertices);
+            }
+        }
+
+        builder.indices.resize(indexCount);
+        parallelFor(chunkCount, [&](uint32_t i) {
+            const Chunk &chunk = chunks[i];
+            uint32_t *out = builder.indices.data() + chunk.firstIndex;
+            for (size_t j = 0; j < chunk.indices.size(); j++) {
+                out[j] = chunk.remap[chunk.indices[j]];
+            }
+        });
+    }
+
+} // namespace engine
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Model.h"
+
+#include <cstdint>
+#include <string>
+
+namespace engine {
+
+    // Parses a Wavefront OBJ into builder. The file is mapped, split at line
+    // boundaries and parsed on all cores, the per chunk vertex tables are merged
+    // afterwards. The result matches what tinyobjloader produced through the old
+    // Model::Builder::LoadModel: fan triangulated faces, vertices deduplicated by
+    // value in order of first use and one submesh per tinyobj shape.
+    // Throws std::runtime_error if the file cannot be read or indexes out of range.
+    // chunkCount forces the number of chunks, 0 picks one per core for large files.
+    void loadObj(const std::string &filepath, Model::Builder &builder, uint32_t chunkCount = 0);
+
+} // namespace engine
@@ -0,0 +1,529 @@
+#include "OcclusionCuller.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <tuple>
+
+namespace engine {
+
+    namespace {
+        // below this many polygons rasterizing is cheaper than waking the workers
+        constexpr size_t PARALLEL_POLYGONS = 256;
+
+        const glm::vec3 BOX_CORNERS[8] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0},
+                                           {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1}};
+        const uint32_t BOX_INDICES[36] = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+                                          2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+
+        // strictly convex with either winding, a quad folding over its diagonal is not
+        bool isConvex(const glm::vec3 (&v)[4]) {
+            float sign = 0.0f;
+            for (uint32_t k = 0; k < 4; k++) {
+                glm::vec2 e0 = glm::vec2(v[(k + 1) % 4]) - glm::vec2(v[k]);
+                glm::vec2 e1 = glm::vec2(v[(k + 2) % 4]) - glm::vec2(v[(k + 1) % 4]);
+                float cross = e0.x * e1.y - e0.y * e1.x;
+                if (cross == 0.0f || cross * sign < 0.0f) {
+                    return false;
+                }
+                sign = cross;
+            }
+            return true;
+        }
+
+        float millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+            return std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - start).count();
+        }
+    } // namespace
+
+    OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+        : m_tilesX{std::max(1u, (width + TILE_SIZE - 1) / TILE_SIZE)},
+          m_tilesY{std::max(1u, (height + TILE_SIZE - 1) / TILE_SIZE)} {
+        m_width = m_tilesX * TILE_SIZE;
+        m_height = m_tilesY * TILE_SIZE;
+        m_depth.assign(static_cast<size_t>(m_width) * m_height, 1.0f);
+        m_tileMax.assign(static_cast<size_t>(m_tilesX) * m_tilesY, 1.0f);
+    }
+
+    void OcclusionCuller::beginFrame(const glm::mat4 &viewProjection) {
+        m_viewProjection = viewProjection;
+        // planes of the clip volume in world space, Vulkan depth is 0..1
+        glm::mat4 clip = glm::transpose(viewProjection);
+        m_planes[0] = clip[3] + clip[0];
+        m_planes[1] = clip[3] - clip[0];
+        m_planes[2] = clip[3] + clip[1];
+        m_planes[3] = clip[3] - clip[1];
+        m_planes[4] = clip[2];
+        m_planes[5] = clip[3] - clip[2];
+        m_polygons.clear();
+        m_stats = {};
+    }
+
+    void OcclusionCuller::addOccluder(const OccluderBox &box) {
+        glm::mat4 boxMatrix{1.0f};
+        boxMatrix[0].x = box.max.x - box.min.x;
+        boxMatrix[1].y = box.max.y - box.min.y;
+        boxMatrix[2].z = box.max.z - box.min.z;
+        boxMatrix[3] = glm::vec4(box.min, 1.0f);
+        addOccluder(boxMatrix, BOX_CORNERS, BOX_INDICES, 36);
+    }
+
+    void OcclusionCuller::addOccluder(const glm::mat4 &modelMatrix, const glm::vec3 *positions,
+                                      const uint32_t *indices, uint32_t indexCount) {
+        glm::mat4 modelViewProjection = m_viewProjection * modelMatrix;
+        auto width = static_cast<float>(m_width);
+        auto height = static_cast<float>(m_height);
+        size_t added = 0;
+
+        auto project = [&](const glm::vec3 &position, glm::vec3 &screen) {
+            glm::vec4 clip = modelViewProjection * glm::vec4(position, 1.0f);
+            if (clip.z < 0.0f || clip.w <= 0.0f) {
+                return false;
+            }
+            screen = {(clip.x / clip.w * 0.5f + 0.5f) * width, (clip.y / clip.w * 0.5f + 0.5f) * height,
+                      clip.z / clip.w};
+            return true;
+        };
+
+        for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+            ScreenPolygon polygon{};
+            polygon.vertexCount = 3;
+            const glm::vec3 p[3] = {positions[indices[i]], positions[indices[i + 1]], positions[indices[i + 2]]};
+            if (!project(p[0], polygon.vertices[0]) || !project(p[1], polygon.vertices[1]) ||
+                !project(p[2], polygon.vertices[2])) {
+                continue;
+            }
+            uint32_t triangles = 1;
+
+            // a following triangle across one of the edges in the same plane turns
+            // this one into a quad, as long as the quad stays convex on screen
+            if (i + 5 < indexCount) {
+                const glm::vec3 q[3] = {positions[indices[i + 3]], positions[indices[i + 4]],
+                                        positions[indices[i + 5]]};
+                for (uint32_t edge = 0; edge < 3 && triangles == 1; edge++) {
+                    const glm::vec3 &from = p[edge];
+                    const glm::vec3 &to = p[(edge + 1) % 3];
+                    for (uint32_t k = 0; k < 3; k++) {
+                        if (q[k] != from && q[k] != to && q[(k + 1) % 3] == to && q[(k + 2) % 3] == from) {
+                            glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+                            float distance = std::abs(glm::dot(normal, q[k] - p[0]));
+                            float scale = glm::length(normal) * (glm::length(q[k] - p[0]) + glm::length(to - from));
+                            ScreenPolygon quad{};
+                            quad.vertexCount = 4;
+                            quad.vertices[0] = polygon.vertices[edge];
+                            quad.vertices[2] = polygon.vertices[(edge + 1) % 3];
+                            quad.vertices[3] = polygon.vertices[(edge + 2) % 3];
+                            if (distance <= 1e-5f * scale && project(q[k], quad.vertices[1]) && isConvex(quad.vertices)) {
+                                polygon = quad;
+                                triangles = 2;
+                            }
+                            break;
+                        }
+                    }
+                }
+            }
+            if (triangles == 2) {
+                i += 3;
+            }
+
+            const glm::vec3 *v = polygon.vertices;
+            float minX = v[0].x;
+            float maxX = v[0].x;
+            polygon.minY = v[0].y;
+            polygon.maxY = v[0].y;
+            for (uint32_t k = 1; k < polygon.vertexCount; k++) {
+                minX = std::min(minX, v[k].x);
+                maxX = std::max(maxX, v[k].x);
+                polygon.minY = std::min(polygon.minY, v[k].y);
+                polygon.maxY = std::max(polygon.maxY, v[k].y);
+            }
+            if (maxX <= 0.0f || minX >= width || polygon.maxY <= 0.0f || polygon.minY >= height) {
+                continue;
+            }
+            m_polygons.push_back(polygon);
+            added += triangles;
+        }
+
+        if (added > 0) {
+            m_stats.occluders++;
+            m_stats.occluderTriangles += static_cast<uint32_t>(added);
+        }
+    }
+
+    void OcclusionCuller::rasterize() {
+        PROFILE_SCOPE("OcclusionCuller::rasterize");
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // bands of one tile row never share pixels, so they rasterize independently
+        if (m_polygons.size() < PARALLEL_POLYGONS) {
+            for (uint32_t tileRow = 0; tileRow < m_tilesY; tileRow++) {
+                rasterizeBand(tileRow);
+            }
+        } else {
+            m_workers.parallelFor(m_tilesY, [this](uint32_t tileRow) { rasterizeBand(tileRow); });
+        }
+
+        m_stats.rasterizeMs += millisecondsSince(start);
+    }
+
+    void OcclusionCuller::rasterizeBand(uint32_t tileRow) {
+        uint32_t rowBegin = tileRow * TILE_SIZE;
+        uint32_t rowEnd = rowBegin + TILE_SIZE;
+        std::fill(m_depth.begin() + static_cast<size_t>(rowBegin) * m_width,
+                  m_depth.begin() + static_cast<size_t>(rowEnd) * m_width, 1.0f);
+
+        for (const auto &polygon : m_polygons) {
+            if (polygon.maxY <= static_cast<float>(rowBegin) || polygon.minY >= static_cast<float>(rowEnd)) {
+                continue;
+            }
+
+            glm::vec3 v[4];
+            std::copy(polygon.vertices, polygon.vertices + 4, v);
+            uint32_t n = polygon.vertexCount;
+            float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+            if (std::abs(area) < 1e-6f) {
+                continue;
+            }
+            // both windings occlude, flip to a positive area so inside is e >= 0
+            if (area < 0.0f) {
+                std::reverse(v + 1, v + n);
+                area = -area;
+            }
+
+            // e(x, y) = a * x + b * y + c per edge. A pixel is completely covered once
+            // e at its center reaches half the pixel's extent along the edge normal.
+            // Triangles get a fourth edge that every pixel passes.
+            glm::vec4 a{0.0f};
+            glm::vec4 b{0.0f};
+            glm::vec4 c{1.0f};
+            for (uint32_t k = 0; k < n; k++) {
+                const glm::vec3 &from = v[k];
+                const glm::vec3 &to = v[(k + 1) % n];
+                a[k] = from.y - to.y;
+                b[k] = to.x - from.x;
+                c[k] = -(a[k] * from.x + b[k] * from.y);
+            }
+            glm::vec4 inset = 0.5f * (glm::abs(a) + glm::abs(b));
+
+            // the polygon is flat, depth is linear in screen space and the farthest
+            // depth inside a pixel sits half a pixel from its center along both gradients
+            glm::vec3 v0 = v[0];
+            glm::vec3 v1 = v[1];
+            glm::vec3 v2 = v[2];
+            float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+            float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+            float dz = v0.z - dzdx * v0.x - dzdy * v0.y + 0.5f * (std::abs(dzdx) + std::abs(dzdy));
+
+            float minX = std::min({v0.x, v1.x, v2.x, v[n - 1].x});
+            float maxX = std::max({v0.x, v1.x, v2.x, v[n - 1].x});
+            auto xBegin = static_cast<uint32_t>(std::clamp(std::ceil(minX), 0.0f, static_cast<float>(m_width)));
+            auto xEnd = static_cast<uint32_t>(std::clamp(std::floor(maxX), 0.0f, static_cast<float>(m_width)));
+            auto yBegin = std::max(rowBegin, static_cast<uint32_t>(std::clamp(std::ceil(polygon.minY), 0.0f,
+                                                                             static_cast<float>(m_height))));
+            auto yEnd = std::min(rowEnd, static_cast<uint32_t>(std::clamp(std::floor(polygon.maxY), 0.0f,
+                                                                         static_cast<float>(m_height))));
+
+            for (uint32_t y = yBegin; y < yEnd; y++) {
+                float py = static_cast<float>(y) + 0.5f;
+                glm::vec4 rowEdge = b * py + c - inset;
+                float rowDepth = dzdy * py + dz;
+
+                // narrow the bounding box to the span between the edges, give or take
+                // a pixel, the exact test stays in the loop below
+                auto spanBegin = static_cast<float>(xBegin);
+                auto spanEnd = static_cast<float>(xEnd);
+                for (int k = 0; k < 4; k++) {
+                    if (a[k] > 0.0f) {
+                        spanBegin = std::max(spanBegin, std::floor(-rowEdge[k] / a[k] - 0.5f));
+                    } else if (a[k] < 0.0f) {
+                        spanEnd = std::min(spanEnd, std::ceil(-rowEdge[k] / a[k] - 0.5f) + 1.0f);
+                    } else if (rowEdge[k] < 0.0f) {
+                        spanEnd = spanBegin;
+                    }
+                }
+                if (spanBegin >= spanEnd) {
+                    continue;
+                }
+
+                float *row = m_depth.data() + static_cast<size_t>(y) * m_width;
+                auto spanEndX = static_cast<uint32_t>(spanEnd);
+                // branch free so the compiler can vectorize the span
+                for (auto x = static_cast<uint32_t>(spanBegin); x < spanEndX; x++) {
+                    float px = static_cast<float>(x) + 0.5f;
+                    bool inside = (a.x * px + rowEdge.x >= 0.0f) & (a.y * px + rowEdge.y >= 0.0f) &
+                                  (a.z * px + rowEdge.z >= 0.0f) & (a.w * px + rowEdge.w >= 0.0f);
+                    float depth = std::min(row[x], dzdx * px + rowDepth);
+                    row[x] = inside ? depth : row[x];
+                }
+            }
+        }
+
+        for (uint32_t tileX = 0; tileX < m_tilesX; tileX++) {
+            float tileMax = 0.0f;
+            for (uint32_t y = rowBegin; y < rowEnd; y++) {
+                const float *row = m_depth.data() + static_cast<size_t>(y) * m_width + tileX * TILE_SIZE;
+                for (uint32_t x = 0; x < TILE_SIZE; x++) {
+                    tileMax = std::max(tileMax, row[x]);
+                }
+            }
+            m_tileMax[tileRow * m_tilesX + tileX] = tileMax;
+        }
+    }
+
+    void OcclusionCuller::classify(const glm::vec3 *mins, const glm::vec3 *maxs, uint32_t count,
+                                   Result *results) const {
+        const glm::mat4 &m = m_viewProjection;
+        auto width = static_cast<float>(m_width);
+        auto height = static_cast<float>(m_height);
+
+        for (uint32_t first = 0; first < count; first += LANES) {
+            // one box per lane, a short last group repeats its last box
+            uint32_t lanes = std::min(LANES, count - first);
+            const glm::vec3 *groupMins = mins + first;
+            const glm::vec3 *groupMaxs = maxs + first;
+            glm::vec3 paddedMins[LANES];
+            glm::vec3 paddedMaxs[LANES];
+            if (lanes < LANES) {
+                for (uint32_t lane = 0; lane < LANES; lane++) {
+                    paddedMins[lane] = groupMins[std::min(lane, lanes - 1)];
+                    paddedMaxs[lane] = groupMaxs[std::min(lane, lanes - 1)];
+                }
+                groupMins = paddedMins;
+                groupMaxs = paddedMaxs;
+            }
+            // transposed in a loop of its own, the interleaved loads would hold the
+            // plane tests to two lanes per instruction
+            float minX[LANES], minY[LANES], minZ[LANES];
+            float extentX[LANES], extentY[LANES], extentZ[LANES];
+            for (uint32_t lane = 0; lane < LANES; lane++) {
+                minX[lane] = groupMins[lane].x;
+                minY[lane] = groupMins[lane].y;
+                minZ[lane] = groupMins[lane].z;
+                extentX[lane] = groupMaxs[lane].x - minX[lane];
+                extentY[lane] = groupMaxs[lane].y - minY[lane];
+                extentZ[lane] = groupMaxs[lane].z - minZ[lane];
+            }
+
+            // the frustum planes reject most boxes before any corner is projected
+            int32_t outside[LANES];
+            for (uint32_t lane = 0; lane < LANES; lane++) {
+                float centerX = minX[lane] + extentX[lane] * 0.5f;
+                float centerY = minY[lane] + extentY[lane] * 0.5f;
+                float centerZ = minZ[lane] + extentZ[lane] * 0.5f;
+                int32_t out = 0;
+                for (const auto &plane : m_planes) {
+                    float distance = plane.x * centerX + plane.y * centerY + plane.z * centerZ + plane.w;
+                    float radius = std::abs(plane.x) * extentX[lane] + std::abs(plane.y) * extentY[lane] +
+                                   std::abs(plane.z) * extentZ[lane];
+                    out |= static_cast<int32_t>(distance < -0.5f * radius);
+                }
+                outside[lane] = out;
+            }
+
+            // groups entirely outside skip the projection
+            int32_t anyInside = 0;
+            for (uint32_t lane = 0; lane < LANES; lane++) {
+                anyInside |= outside[lane] ^ 1;
+            }
+            if (!anyInside) {
+                std::fill(results + first, results + first + lanes, Result::OutsideFrustum);
+                continue;
+            }
+
+            // corners are the projected min corner plus the projected edges of the box
+            int32_t crossesNear[LANES];
+            float ndcMinX[LANES], ndcMinY[LANES], ndcMinZ[LANES], ndcMaxX[LANES], ndcMaxY[LANES];
+            for (uint32_t lane = 0; lane < LANES; lane++) {
+                glm::vec4 base = m[0] * minX[lane] + m[1] * minY[lane] + m[2] * minZ[lane] + m[3];
+                glm::vec4 edgeX = m[0] * extentX[lane];
+                glm::vec4 edgeY = m[1] * extentY[lane];
+                glm::vec4 edgeZ = m[2] * extentZ[lane];
+
+                int32_t behind = 0;
+                glm::vec3 ndcMin{std::numeric_limits<float>::max()};
+                glm::vec2 ndcMax{std::numeric_limits<float>::lowest()};
+                auto add = [&](const glm::vec4 &corner) {
+                    // bitwise, a branch would keep the loop from vectorizing
+                    behind |= static_cast<int32_t>(corner.z < 0.0f) | static_cast<int32_t>(corner.w <= 0.0f);
+                    // such a lane is visible whatever its bounds, NaN from w = 0 is
+                    // clamped away below
+                    glm::vec3 ndc = glm::vec3(corner) * (1.0f / corner.w);
+                    ndcMin = glm::min(ndcMin, ndc);
+                    ndcMax = glm::max(ndcMax, glm::vec2(ndc));
+                };
+                glm::vec4 cornerX = base + edgeX;
+                glm::vec4 cornerY = base + edgeY;
+                glm::vec4 cornerXY = cornerX + edgeY;
+                add(base);
+                add(cornerX);
+                add(cornerY);
+                add(cornerXY);
+                add(base + edgeZ);
+                add(cornerX + edgeZ);
+                add(cornerY + edgeZ);
+                add(cornerXY + edgeZ);
+
+                crossesNear[lane] = behind;
+                ndcMinX[lane] = ndcMin.x;
+                ndcMinY[lane] = ndcMin.y;
+                ndcMinZ[lane] = ndcMin.z;
+                ndcMaxX[lane] = ndcMax.x;
+                ndcMaxY[lane] = ndcMax.y;
+            }
+
+            // every pixel the box touches, clamped to the screen before truncating,
+            // which floors once the value is not negative. NaN clamps to 0.
+            int32_t x0[LANES], x1[LANES], y0[LANES], y1[LANES];
+            for (uint32_t lane = 0; lane < LANES; lane++) {
+                x0[lane] = static_cast<int32_t>(std::min(std::max(0.0f, (ndcMinX[lane] * 0.5f + 0.5f) * width), width));
+                x1[lane] = static_cast<int32_t>(std::min(std::max(0.0f, (ndcMaxX[lane] * 0.5f + 0.5f) * width + 1.0f), width));
+                y0[lane] = static_cast<int32_t>(std::min(std::max(0.0f, (ndcMinY[lane] * 0.5f + 0.5f) * height), height));
+                y1[lane] = static_cast<int32_t>(std::min(std::max(0.0f, (ndcMaxY[lane] * 0.5f + 0.5f) * height + 1.0f), height));
+            }
+
+            // boxes within two tiles either way are mostly decided by the farthest
+            // depth of those tiles, the others go through every tile they touch
+            uint32_t tiles[4][LANES];
+            int32_t small[LANES];
+            for (uint32_t lane = 0; lane < LANES; lane++) {
+                // the bounds are not negative, x1 and y1 are past the last pixel
+                uint32_t tileX0 = std::min(static_cast<uint32_t>(x0[lane]) / TILE_SIZE, m_tilesX - 1);
+                uint32_t tileY0 = std::min(static_cast<uint32_t>(y0[lane]) / TILE_SIZE, m_tilesY - 1);
+                uint32_t tileX1 = std::min(static_cast<uint32_t>(std::max(x1[lane] - 1, 0)) / TILE_SIZE, m_tilesX - 1);
+                uint32_t tileY1 = std::min(static_cast<uint32_t>(std::max(y1[lane] - 1, 0)) / TILE_SIZE, m_tilesY - 1);
+                tiles[0][lane] = tileY0 * m_tilesX + tileX0;
+                tiles[1][lane] = tileY0 * m_tilesX + tileX1;
+                tiles[2][lane] = tileY1 * m_tilesX + tileX0;
+                tiles[3][lane] = tileY1 * m_tilesX + tileX1;
+                small[lane] = static_cast<int32_t>(tileX1 - tileX0 <= 1) & static_cast<int32_t>(tileY1 - tileY0 <= 1);
+            }
+            float farthest[LANES];
+            for (uint32_t lane = 0; lane < LANES; lane++) {
+                farthest[lane] = std::max(std::max(m_tileMax[tiles[0][lane]], m_tileMax[tiles[1][lane]]),
+                                          std::max(m_tileMax[tiles[2][lane]], m_tileMax[tiles[3][lane]]));
+            }
+            int32_t behindTiles[LANES];
+            for (uint32_t lane = 0; lane < LANES; lane++) {
+                behindTiles[lane] = small[lane] & static_cast<int32_t>(ndcMinZ[lane] > farthest[lane]);
+            }
+
+            for (uint32_t lane = 0; lane < lanes; lane++) {
+                Result &result = results[first + lane];
+                if (outside[lane]) {
+                    result = Result::OutsideFrustum;
+                } else if (crossesNear[lane]) {
+                    result = Result::Visible;
+                } else if (x0[lane] >= x1[lane] || y0[lane] >= y1[lane]) {
+                    result = Result::OutsideFrustum;
+                } else if (behindTiles[lane] || isOccluded(x0[lane], y0[lane], x1[lane], y1[lane], ndcMinZ[lane])) {
+                    result = Result::Occluded;
+                } else {
+                    result = Result::Visible;
+                }
+            }
+        }
+    }
+
+    bool OcclusionCuller::isOccluded(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, float depth) const {
+        for (uint32_t tileY = y0 / TILE_SIZE; tileY <= (y1 - 1) / TILE_SIZE; tileY++) {
+            for (uint32_t tileX = x0 / TILE_SIZE; tileX <= (x1 - 1) / TILE_SIZE; tileX++) {
+                if (depth > m_tileMax[tileY * m_tilesX + tileX]) {
+                    continue;
+                }
+                uint32_t rowBegin = std::max(y0, tileY * TILE_SIZE);
+                uint32_t rowEnd = std::min(y1, (tileY + 1) * TILE_SIZE);
+                uint32_t columnBegin = std::max(x0, tileX * TILE_SIZE);
+                uint32_t columnEnd = std::min(x1, (tileX + 1) * TILE_SIZE);
+                for (uint32_t y = rowBegin; y < rowEnd; y++) {
+                    const float *row = m_depth.data() + static_cast<size_t>(y) * m_width;
+                    for (uint32_t x = columnBegin; x < columnEnd; x++) {
+                        if (depth <= row[x]) {
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    bool OcclusionCuller::isVisible(const glm::vec3 &min, const glm::vec3 &max) const {
+        Result result;
+        classify(&min, &max, 1, &result);
+        return result == Result::Visible;
+    }
+
+    void OcclusionCuller::cullBoxes(const glm::vec3 *mins, const glm::vec3 *maxs, uint32_t count, uint8_t *visible) {
+        PROFILE_SCOPE("OcclusionCuller::cullBoxes");
+        auto start = std::chrono::high_resolution_clock::now();
+        std::atomic<uint32_t> frustumCulled{0};
+        std::atomic<uint32_t> occluded{0};
+
+        m_workers.parallelFor((count + BATCH_SIZE - 1) / BATCH_SIZE, [&](uint32_t batch) {
+            uint32_t batchFrustumCulled = 0;
+            uint32_t batchOccluded = 0;
+            uint32_t begin = batch * BATCH_SIZE;
+            uint32_t end = std::min(count, begin + BATCH_SIZE);
+            Result results[BATCH_SIZE];
+            classify(mins + begin, maxs + begin, end - begin, results);
+            for (uint32_t i = begin; i < end; i++) {
+                Result result = results[i - begin];
+                visible[i] = result == Result::Visible ? 1 : 0;
+                batchFrustumCulled += result == Result::OutsideFrustum ? 1 : 0;
+                batchOccluded += result == Result::Occluded ? 1 : 0;
+            }
+            frustumCulled += batchFrustumCulled;
+            occluded += batchOccluded;
+        });
+
+        m_stats.tested += count;
+        m_stats.frustumCulled += frustumCulled;
+        m_stats.occluded += occluded;
+        m_stats.testMs += millisecondsSince(start);
+    }
+
+    void mergeBoxes(std::vector<OccluderBox> &boxes) {
+        for (int axis : {0, 2, 1}) {
+            int b = (axis + 1) % 3;
+            int c = (axis + 2) % 3;
+            std::sort(boxes.begin(), boxes.end(), [&](const OccluderBox &l, const OccluderBox &r) {
+                return std::tie(l.min[b], l.max[b], l.min[c], l.max[c], l.min[axis]) <
+                       std::tie(r.min[b], r.max[b], r.min[c], r.max[c], r.min[axis]);
+            });
+
+            size_t merged = 0;
+            for (size_t i = 0; i < boxes.size(); i++) {
+                if (merged > 0) {
+                    OccluderBox &last = boxes[merged - 1];
+                    if (last.min[b] == boxes[i].min[b] && last.max[b] == boxes[i].max[b] &&
+                        last.min[c] == boxes[i].min[c] && last.max[c] == boxes[i].max[c] &&
+                        boxes[i].min[axis] <= last.max[axis]) {
+                        last.max[axis] = std::max(last.max[axis], boxes[i].max[axis]);
+                        continue;
+                    }
+                }
+                boxes[merged++] = boxes[i];
+            }
+            boxes.resize(merged);
+        }
+    }
+
+    void transformBox(const glm::mat4 &matrix, glm::vec3 &min, glm::vec3 &max) {
+        // Arvo's method, each output axis takes the smaller and larger product per input axis
+        glm::vec3 newMin = glm::vec3(matrix[3]);
+        glm::vec3 newMax = newMin;
+        for (int column = 0; column < 3; column++) {
+            glm::vec3 a = glm::vec3(matrix[column]) * min[column];
+            glm::vec3 b = glm::vec3(matrix[column]) * max[column];
+            newMin += glm::min(a, b);
+            newMax += glm::max(a, b);
+        }
+        min = newMin;
+        max = newMax;
+    }
+
+} // namespace engine
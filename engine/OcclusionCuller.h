@@ -0,0 +1,122 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace engine {
+
+    struct OccluderBox {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    struct OcclusionStats {
+        uint32_t occluders{0};
+        uint32_t occluderTriangles{0};
+        uint32_t tested{0};
+        uint32_t frustumCulled{0};
+        uint32_t occluded{0};
+        float rasterizeMs{0.0f};
+        float testMs{0.0f};
+    };
+
+    // Low resolution depth buffer rasterized on the CPU from a few large or near
+    // occluders, against which the screen bounds of boxes are tested before
+    // anything is drawn. Both sides are conservative: occluders only write pixels
+    // they cover completely with the farthest depth inside the pixel, and boxes
+    // are tested with every pixel they touch and their nearest corner. Nothing
+    // here touches Vulkan, so it runs and can be checked without a device.
+    class OcclusionCuller {
+    public:
+        // depth is kept per pixel and as the farthest depth of every tile
+        static constexpr uint32_t TILE_SIZE = 8;
+        // boxes tested by one thread at a time in cullBoxes
+        static constexpr uint32_t BATCH_SIZE = 4096;
+
+        // width and height are rounded up to whole tiles
+        explicit OcclusionCuller(uint32_t width = 320, uint32_t height = 192);
+
+        // drops the occluders of the last frame, viewProjection maps world space to
+        // Vulkan clip space (depth 0..1)
+        void beginFrame(const glm::mat4 &viewProjection);
+
+        // queues the twelve triangles of a solid world space box
+        void addOccluder(const OccluderBox &box);
+
+        // Queues the triangles of a mesh placed with modelMatrix. Triangles reaching
+        // in front of the near plane are skipped, they cannot be bounded on screen.
+        // Consecutive triangles forming a flat convex quad are drawn as one polygon,
+        // pixels on their diagonal would otherwise be covered by neither.
+        void addOccluder(const glm::mat4 &modelMatrix, const glm::vec3 *positions, const uint32_t *indices,
+                         uint32_t indexCount);
+
+        // clears the depth buffer and rasterizes the queued occluders on all cores
+        void rasterize();
+
+        // false if the world space box lies outside the frustum or behind the
+        // rasterized occluders
+        bool isVisible(const glm::vec3 &min, const glm::vec3 &max) const;
+
+        // isVisible for count boxes on all cores, visible[i] receives 1 or 0, and
+        // the box counters of stats() are updated
+        void cullBoxes(const glm::vec3 *mins, const glm::vec3 *maxs, uint32_t count, uint8_t *visible);
+
+        const OcclusionStats &stats() const { return m_stats; }
+
+        uint32_t width() const { return m_width; }
+        uint32_t height() const { return m_height; }
+
+        // rasterized depth of a pixel, 1 where no occluder was drawn
+        float depth(uint32_t x, uint32_t y) const { return m_depth[y * m_width + x]; }
+
+    private:
+        enum class Result { Visible, OutsideFrustum, Occluded };
+
+        // occluder triangle, or convex quad of two coplanar triangles, in pixels,
+        // z is the depth
+        struct ScreenPolygon {
+            glm::vec3 vertices[4];
+            uint32_t vertexCount;
+            float minY;
+            float maxY;
+        };
+
+        // boxes classified side by side, the frustum and projection math of a
+        // group runs over arrays the compiler turns into vector instructions
+        static constexpr uint32_t LANES = 8;
+
+        void classify(const glm::vec3 *mins, const glm::vec3 *maxs, uint32_t count, Result *results) const;
+        // whether the rasterized depth of every pixel in x0..x1, y0..y1 is nearer
+        // than depth
+        bool isOccluded(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, float depth) const;
+
+        void rasterizeBand(uint32_t tileRow);
+
+        uint32_t m_width;
+        uint32_t m_height;
+        uint32_t m_tilesX;
+        uint32_t m_tilesY;
+        glm::mat4 m_viewProjection{1.0f};
+        glm::vec4 m_planes[6]{};
+        std::vector<ScreenPolygon> m_polygons;
+        std::vector<float> m_depth;
+        // farthest depth of every tile, lets most boxes skip the per pixel test
+        std::vector<float> m_tileMax;
+        OcclusionStats m_stats;
+        // kept across frames, rasterize and cullBoxes run twice per frame
+        ThreadPool m_workers;
+    };
+
+    // Joins boxes that touch or overlap and share the same cross section, axis by
+    // axis, so rows and slabs of solid cells become a few large occluders. Pixels
+    // along the seam of two separate occluders are never fully covered by either.
+    void mergeBoxes(std::vector<OccluderBox> &boxes);
+
+    // axis aligned box around the box min..max transformed by matrix
+    void transformBox(const glm::mat4 &matrix, glm::vec3 &min, glm::vec3 &max);
+
+} // namespace engine
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Device.h"
+#include "Texture.h"
+
+#include <memory>
+#include <vulkan/vulkan.h>
+
+namespace engine {
+
+    // Color and depth attachments that the scene is rendered into. ImGui samples
+    // the color attachment directly, without copying out of the swap chain. The
+    // render pass neither transitions the attachments nor synchronizes with the
+    // passes around it, the RenderGraph places those barriers.
+    class OffscreenTarget {
+    public:
+        OffscreenTarget(Device &device, VkExtent2D extent, VkFormat colorFormat, VkFormat depthFormat);
+
+        ~OffscreenTarget();
+
+        OffscreenTarget(const OffscreenTarget &) = delete;
+
+        OffscreenTarget &operator=(const OffscreenTarget &) = delete;
+
+        // recreates the attachments and framebuffer, the render pass is kept so
+        // pipelines built against it stay valid. The caller must make sure the GPU
+        // no longer uses the old attachments.
+        void resize(VkExtent2D extent);
+
+        [[nodiscard]] VkRenderPass renderPass() const { return m_renderPass; }
+        [[nodiscard]] VkFramebuffer framebuffer() const { return m_framebuffer; }
+        [[nodiscard]] VkExtent2D extent() const { return m_extent; }
+        [[nodiscard]] std::shared_ptr<Texture> colorTexture() const { return m_color; }
+        [[nodiscard]] VkImage depthImage() const { return m_depth->image(); }
+
+    private:
+        void createRenderPass();
+        void createAttachments();
+        void createFramebuffer();
+        void destroyFramebuffer();
+
+        Device &m_device;
+        VkExtent2D m_extent;
+        VkFormat m_colorFormat;
+        VkFormat m_depthFormat;
+
+        std::shared_ptr<Texture> m_color;
+        std::unique_ptr<Texture> m_depth;
+        VkRenderPass m_renderPass{VK_NULL_HANDLE};
+        VkFramebuffer m_framebuffer{VK_NULL_HANDLE};
+    };
+
+} // namespace engine
@@ -1,8 +1,10 @@
 #include "Pipeline.h"
 #include "Model.h"
+#include "Profiler.h"
 
 #include <cassert>
 #include <fstream>
+#include <initializer_list>
 #include <vulkan/vulkan_core.h>
 
 namespace engine {
@@ -13,27 +15,20 @@ namespace engine {
     }
 
     Pipeline::~Pipeline() {
-        vkQueueWaitIdle(m_Device.graphicsQueue());
-
-        if (m_VertShaderModule != VK_NULL_HANDLE) {
-          vkDestroyShaderModule(m_Device.device(), m_VertShaderModule, nullptr);
-          m_VertShaderModule = VK_NULL_HANDLE;
-        }
-
-        if (m_FragShaderModule != VK_NULL_HANDLE) {
-          vkDestroyShaderModule(m_Device.device(), m_FragShaderModule, nullptr);
-          m_FragShaderModule = VK_NULL_HANDLE;
-        }
-
-        if (m_geomShaderModule != VK_NULL_HANDLE) {
-          vkDestroyShaderModule(m_Device.device(), m_geomShaderModule, nullptr);
-          m_geomShaderModule = VK_NULL_HANDLE;
-        }
-
-        if (m_GraphicsPipeline != VK_NULL_HANDLE) {
-          vkDestroyPipeline(m_Device.device(), m_GraphicsPipeline, nullptr);
-          m_GraphicsPipeline = VK_NULL_HANDLE;
-        }
+        // frames in flight may still be bound to this pipeline
+        m_Device.deletionQueue().push([device = m_Device.device(), vert = m_VertShaderModule,
+                                       frag = m_FragShaderModule, geom = m_geomShaderModule,
+                                       pipeline = m_GraphicsPipeline]() {
+            for (VkShaderModule module : {vert, frag, geom}) {
+                if (module != VK_NULL_HANDLE) {
+                    vkDestroyShaderModule(device, module, nullptr);
+                }
+            }
+
+            if (pipeline != VK_NULL_HANDLE) {
+                vkDestroyPipeline(device, pipeline, nullptr);
+            }
+        });
     }
 
     std::vector<char> Pipeline::readFile(const std::string &filepath) {
@@ -135,7 +130,8 @@ namespace engine {
         pipelineInfo.basePipelineIndex = -1;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-        if (vkCreateGraphicsPipelines(m_Device.device(), VK_NULL_HANDLE, 1,
+        PROFILE_SCOPE("Pipeline::createGraphicsPipeline");
+        if (vkCreateGraphicsPipelines(m_Device.device(), m_Device.pipelineCache(), 1,
                                       &pipelineInfo, nullptr,
                                       &m_GraphicsPipeline) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create graphics pipeline");
@@ -0,0 +1,190 @@
+#include "PipelineRegistry.h"
+
+#include <future>
+#include <type_traits>
+
+namespace engine {
+
+    namespace {
+        // Appends the raw bytes of a trivially copyable value to the key. Only plain
+        // fields are written, never whole create infos, so pNext pointers and
+        // padding never leak into the key.
+        template<typename T>
+        void append(std::string &key, const T &value) {
+            static_assert(std::is_trivially_copyable_v<T>, "key fields must be trivially copyable");
+            key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        void append(std::string &key, const std::string &value) {
+            append(key, value.size());
+            key.append(value);
+        }
+    }
+
+    PipelineRegistry::PipelineRegistry(Device &device) : m_device(device) {}
+
+    std::string PipelineRegistry::makeKey(const PipelineConfigInfo &configInfo) {
+        std::string key;
+
+        append(key, configInfo.vertPath);
+        append(key, configInfo.fragPath);
+        append(key, configInfo.geomPath);
+
+        append(key, configInfo.bindingDescriptions.size());
+        for (const auto &binding : configInfo.bindingDescriptions) {
+            append(key, binding.binding);
+            append(key, binding.stride);
+            append(key, binding.inputRate);
+        }
+
+        append(key, configInfo.attributeDescriptions.size());
+        for (const auto &attribute : configInfo.attributeDescriptions) {
+            append(key, attribute.location);
+            append(key, attribute.binding);
+            append(key, attribute.format);
+            append(key, attribute.offset);
+        }
+
+        append(key, configInfo.inputAssemblyInfo.topology);
+        append(key, configInfo.inputAssemblyInfo.primitiveRestartEnable);
+
+        append(key, configInfo.viewportInfo.viewportCount);
+        append(key, configInfo.viewportInfo.scissorCount);
+
+        const auto &raster = configInfo.rasterizationInfo;
+        append(key, raster.depthClampEnable);
+        append(key, raster.rasterizerDiscardEnable);
+        append(key, raster.polygonMode);
+        append(key, raster.cullMode);
+        append(key, raster.frontFace);
+        append(key, raster.depthBiasEnable);
+        append(key, raster.depthBiasConstantFactor);
+        append(key, raster.depthBiasClamp);
+        append(key, raster.depthBiasSlopeFactor);
+        append(key, raster.lineWidth);
+
+        append(key, configInfo.multisampleInfo.rasterizationSamples);
+        append(key, configInfo.multisampleInfo.sampleShadingEnable);
+        append(key, configInfo.multisampleInfo.minSampleShading);
+        append(key, configInfo.multisampleInfo.alphaToCoverageEnable);
+        append(key, configInfo.multisampleInfo.alphaToOneEnable);
+
+        const auto &blend = configInfo.colorBlendInfo;
+        append(key, blend.logicOpEnable);
+        append(key, blend.logicOp);
+        append(key, blend.attachmentCount);
+        for (uint32_t i = 0; i < blend.attachmentCount && blend.pAttachments; i++) {
+            const auto &attachment = blend.pAttachments[i];
+            append(key, attachment.blendEnable);
+            append(key, attachment.srcColorBlendFactor);
+            append(key, attachment.dstColorBlendFactor);
+            append(key, attachment.colorBlendOp);
+            append(key, attachment.srcAlphaBlendFactor);
+            append(key, attachment.dstAlphaBlendFactor);
+            append(key, attachment.alphaBlendOp);
+            append(key, attachment.colorWriteMask);
+        }
+        for (float constant : blend.blendConstants) {
+            append(key, constant);
+        }
+
+        const auto &depth = configInfo.depthStencilInfo;
+        append(key, depth.depthTestEnable);
+        append(key, depth.depthWriteEnable);
+        append(key, depth.depthCompareOp);
+        append(key, depth.depthBoundsTestEnable);
+        append(key, depth.stencilTestEnable);
+        append(key, depth.front);
+        append(key, depth.back);
+        append(key, depth.minDepthBounds);
+        append(key, depth.maxDepthBounds);
+
+        append(key, configInfo.dynamicStateEnables.size());
+        for (auto state : configInfo.dynamicStateEnables) {
+            append(key, state);
+        }
+
+        append(key, configInfo.pipelineLayout);
+        append(key, configInfo.renderPass);
+        append(key, configInfo.subpass);
+
+        return key;
+    }
+
+    std::shared_ptr<Pipeline> PipelineRegistry::getPipeline(const PipelineConfigInfo &configInfo) {
+        return getPipelines({&configInfo}).front();
+    }
+
+    std::vector<std::shared_ptr<Pipeline>>
+    PipelineRegistry::getPipelines(const std::vector<const PipelineConfigInfo *> &configInfos) {
+        std::vector<std::string> keys;
+        keys.reserve(configInfos.size());
+        for (const auto *configInfo : configInfos) {
+            keys.push_back(makeKey(*configInfo));
+        }
+
+        // collect each missing state once, even if it is requested several times
+        std::unordered_map<std::string, std::future<std::shared_ptr<Pipeline>>> pending;
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            for (size_t i = 0; i < configInfos.size(); i++) {
+                if (m_pipelines.count(keys[i]) || pending.count(keys[i])) {
+                    m_hits++;
+                    continue;
+                }
+                m_misses++;
+
+                // the config is only read by the worker and outlives this call
+                const PipelineConfigInfo *configInfo = configInfos[i];
+                pending.emplace(keys[i], std::async(std::launch::async, [this, configInfo]() {
+                    return std::make_shared<Pipeline>(m_device, *configInfo);
+                }));
+            }
+        }
+
+        std::unordered_map<std::string, std::shared_ptr<Pipeline>> created;
+        for (auto &[key, future] : pending) {
+            created[key] = future.get();
+        }
+
+        std::vector<std::shared_ptr<Pipeline>> pipelines;
+        pipelines.reserve(configInfos.size());
+
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (size_t i = 0; i < configInfos.size(); i++) {
+            auto it = created.find(keys[i]);
+            if (it != created.end()) {
+                m_pipelines.try_emplace(keys[i], Entry{it->second, configInfos[i]->pipelineLayout});
+            }
+            pipelines.push_back(m_pipelines.at(keys[i]).pipeline);
+        }
+        return pipelines;
+    }
+
+    void PipelineRegistry::evict(VkPipelineLayout pipelineLayout) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (auto it = m_pipelines.begin(); it != m_pipelines.end();) {
+            if (it->second.pipelineLayout == pipelineLayout) {
+                it = m_pipelines.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void PipelineRegistry::clear() {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_pipelines.clear();
+    }
+
+    size_t PipelineRegistry::size() const {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_pipelines.size();
+    }
+
+    PipelineRegistry::Stats PipelineRegistry::stats() const {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return {static_cast<uint32_t>(m_pipelines.size()), m_hits, m_misses};
+    }
+
+} // namespace engine
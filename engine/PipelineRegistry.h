@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Device.h"
+#include "Pipeline.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace engine {
+
+    // Deduplicates pipelines by their state. Render systems ask the registry for a
+    // pipeline instead of constructing one, so identical configurations share a
+    // single VkPipeline and are only compiled once.
+    class PipelineRegistry {
+    public:
+        struct Stats {
+            uint32_t pipelines{0};
+            // requests served from the registry and pipelines it had to compile
+            uint32_t hits{0};
+            uint32_t misses{0};
+        };
+
+        explicit PipelineRegistry(Device &device);
+
+        PipelineRegistry(const PipelineRegistry &) = delete;
+
+        PipelineRegistry &operator=(const PipelineRegistry &) = delete;
+
+        std::shared_ptr<Pipeline> getPipeline(const PipelineConfigInfo &configInfo);
+
+        // builds all missing pipelines concurrently, one worker per unique state
+        std::vector<std::shared_ptr<Pipeline>> getPipelines(const std::vector<const PipelineConfigInfo *> &configInfos);
+
+        // drops every entry created with this layout, call before destroying the layout
+        void evict(VkPipelineLayout pipelineLayout);
+
+        void clear();
+
+        [[nodiscard]] size_t size() const;
+
+        [[nodiscard]] Stats stats() const;
+
+    private:
+        struct Entry {
+            std::shared_ptr<Pipeline> pipeline;
+            VkPipelineLayout pipelineLayout;
+        };
+
+        static std::string makeKey(const PipelineConfigInfo &configInfo);
+
+        Device &m_device;
+        mutable std::mutex m_mutex;
+        std::unordered_map<std::string, Entry> m_pipelines;
+        uint32_t m_hits{0};
+        uint32_t m_misses{0};
+    };
+
+} // namespace engine
@@ -0,0 +1,209 @@
+#include "Profiler.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+namespace engine {
+
+    namespace {
+        // Single producer ring: only the owning thread writes, it publishes an
+        // event by bumping head after filling the slot.
+        struct ThreadBuffer {
+            std::unique_ptr<ProfileEvent[]> events{new ProfileEvent[Profiler::EVENTS_PER_THREAD]};
+            std::atomic<uint64_t> head{0};
+        };
+
+        // Buffers are never freed. Threads that exit hand theirs back for reuse, so
+        // short lived threads like parallelFor's don't grow the set, and the events
+        // they recorded stay readable until the next owner overwrites them.
+        struct Registry {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+            std::vector<ThreadBuffer *> unused;
+            std::vector<std::pair<uint32_t, const char *>> threadNames;
+            uint32_t nextThread{1};
+        };
+
+        Registry &registry() {
+            // leaked, threads may still return their buffers during static destruction
+            static auto *instance = new Registry();
+            return *instance;
+        }
+
+        struct ThreadState {
+            ThreadBuffer *buffer{nullptr};
+            uint32_t thread{0};
+            uint32_t depth{0};
+            const char *name{nullptr};
+
+            ~ThreadState() {
+                if (buffer) {
+                    Registry &reg = registry();
+                    std::lock_guard<std::mutex> lock{reg.mutex};
+                    reg.unused.push_back(buffer);
+                }
+            }
+
+            void acquire() {
+                Registry &reg = registry();
+                std::lock_guard<std::mutex> lock{reg.mutex};
+                if (reg.unused.empty()) {
+                    reg.buffers.push_back(std::make_unique<ThreadBuffer>());
+                    buffer = reg.buffers.back().get();
+                } else {
+                    buffer = reg.unused.back();
+                    reg.unused.pop_back();
+                }
+                thread = reg.nextThread++;
+                reg.threadNames.emplace_back(thread, name ? name : "thread");
+            }
+        };
+
+        thread_local ThreadState t_state;
+
+        const auto s_epoch = std::chrono::steady_clock::now();
+
+        std::atomic<uint64_t> s_frameStart{0};
+        std::atomic<uint64_t> s_previousFrameStart{0};
+
+        // Copies the events still in buffer. The oldest ones may be overwritten while
+        // copying and are dropped once head shows they were. With head at h the writer
+        // may already be filling the slot of event h, so event h - capacity counts as lost.
+        void copyEvents(const ThreadBuffer &buffer, uint64_t from, uint64_t to, std::vector<ProfileEvent> &events) {
+            const uint64_t capacity = Profiler::EVENTS_PER_THREAD;
+            uint64_t head = buffer.head.load(std::memory_order_acquire);
+            uint64_t first = head >= capacity ? head - capacity + 1 : 0;
+
+            size_t begin = events.size();
+            std::vector<uint64_t> indices;
+            for (uint64_t i = first; i < head; i++) {
+                const ProfileEvent &event = buffer.events[i % capacity];
+                if (event.end > from && event.start < to) {
+                    events.push_back(event);
+                    indices.push_back(i);
+                }
+            }
+
+            // the slot reads above must not move past the head they are validated against
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t headAfter = buffer.head.load(std::memory_order_relaxed);
+            uint64_t valid = headAfter >= capacity ? headAfter - capacity + 1 : 0;
+            size_t kept = begin;
+            for (size_t i = 0; i < indices.size(); i++) {
+                if (indices[i] >= valid) {
+                    events[kept++] = events[begin + i];
+                }
+            }
+            events.resize(kept);
+        }
+
+        void writeJsonString(std::ostream &out, const char *text) {
+            out << '"';
+            for (const char *c = text; *c; c++) {
+                if (*c == '"' || *c == '\\') {
+                    out << '\\';
+                }
+                out << *c;
+            }
+            out << '"';
+        }
+    } // namespace
+
+    uint64_t Profiler::now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - s_epoch).count());
+    }
+
+    void Profiler::setThreadName(const char *name) {
+        t_state.name = name;
+    }
+
+    void Profiler::markFrame() {
+        uint64_t time = now();
+        s_previousFrameStart.store(s_frameStart.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        s_frameStart.store(time, std::memory_order_relaxed);
+    }
+
+    bool Profiler::lastFrame(uint64_t &start, uint64_t &end) {
+        start = s_previousFrameStart.load(std::memory_order_relaxed);
+        end = s_frameStart.load(std::memory_order_relaxed);
+        return start != 0 && end > start;
+    }
+
+    uint32_t Profiler::enter() {
+        return t_state.depth++;
+    }
+
+    void Profiler::leave(const char *name, uint64_t start, uint32_t depth) {
+        uint64_t end = now();
+        ThreadState &state = t_state;
+        state.depth = depth;
+        if (!state.buffer) {
+            state.acquire();
+        }
+
+        ThreadBuffer &buffer = *state.buffer;
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        // keeps this slot's writes behind the previous head store, readers that see
+        // them also see that the event they overwrite is gone
+        std::atomic_thread_fence(std::memory_order_release);
+        buffer.events[head % EVENTS_PER_THREAD] = {name, start, end, state.thread, depth};
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    void Profiler::collect(uint64_t from, uint64_t to, std::vector<ProfileEvent> &events) {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock{reg.mutex};
+        for (const auto &buffer : reg.buffers) {
+            copyEvents(*buffer, from, to, events);
+        }
+    }
+
+    void Profiler::writeChromeTrace(const std::string &path) {
+        std::vector<ProfileEvent> events;
+        std::vector<std::pair<uint32_t, const char *>> threadNames;
+        {
+            Registry &reg = registry();
+            std::lock_guard<std::mutex> lock{reg.mutex};
+            for (const auto &buffer : reg.buffers) {
+                copyEvents(*buffer, 0, ~0ull, events);
+            }
+            threadNames = reg.threadNames;
+        }
+
+        std::ofstream file{path, std::ios::trunc};
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to write trace: " + path);
+        }
+
+        // complete events in microseconds, nesting is derived from the time ranges
+        file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        bool first = true;
+        for (const auto &[thread, name] : threadNames) {
+            file << (first ? "" : ",\n") << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": " << thread
+                 << ", \"args\": {\"name\": ";
+            writeJsonString(file, name);
+            file << "}}";
+            first = false;
+        }
+        file.precision(3);
+        file << std::fixed;
+        for (const auto &event : events) {
+            file << (first ? "" : ",\n") << "{\"ph\": \"X\", \"name\": ";
+            writeJsonString(file, event.name);
+            file << ", \"pid\": 1, \"tid\": " << event.thread
+                 << ", \"ts\": " << static_cast<double>(event.start) / 1000.0
+                 << ", \"dur\": " << static_cast<double>(event.end - event.start) / 1000.0 << "}";
+            first = false;
+        }
+        file << "\n]}\n";
+
+        std::cout << "profiler: wrote " << events.size() << " events to " << path << std::endl;
+    }
+
+} // namespace engine
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+    struct ProfileEvent {
+        // a string literal, events outlive the scopes that recorded them
+        const char *name;
+        // nanoseconds since the profiler started
+        uint64_t start;
+        uint64_t end;
+        uint32_t thread;
+        // number of enclosing scopes on the same thread
+        uint32_t depth;
+    };
+
+    // Hierarchical CPU scope timings. Every thread writes the scopes it leaves
+    // into a ring buffer of its own, without locks, and readers copy out what is
+    // still in the rings, so only the most recent EVENTS_PER_THREAD scopes of a
+    // thread can be inspected or exported. While disabled a scope costs one
+    // relaxed load and a branch.
+    class Profiler {
+    public:
+        static constexpr uint32_t EVENTS_PER_THREAD = 1u << 15;
+
+        static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        static void setEnabled(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+
+        static uint64_t now();
+
+        // shown in exported traces, name must be a string literal
+        static void setThreadName(const char *name);
+
+        // marks the start of a frame, called by the thread that drives the frames
+        static void markFrame();
+
+        // start and end of the last complete frame, false until two frames were marked
+        static bool lastFrame(uint64_t &start, uint64_t &end);
+
+        // appends the buffered events overlapping [from, to) of all threads
+        static void collect(uint64_t from, uint64_t to, std::vector<ProfileEvent> &events);
+
+        // writes all buffered events as Chrome trace JSON, for chrome://tracing or Perfetto
+        static void writeChromeTrace(const std::string &path);
+
+        // bookkeeping of ProfileScope
+        static uint32_t enter();
+
+        static void leave(const char *name, uint64_t start, uint32_t depth);
+
+    private:
+        static inline std::atomic<bool> s_enabled{false};
+    };
+
+    class ProfileScope {
+    public:
+        explicit ProfileScope(const char *name) : m_name{Profiler::enabled() ? name : nullptr} {
+            if (m_name) {
+                m_depth = Profiler::enter();
+                m_start = Profiler::now();
+            }
+        }
+
+        ~ProfileScope() {
+            if (m_name) {
+                Profiler::leave(m_name, m_start, m_depth);
+            }
+        }
+
+        ProfileScope(const ProfileScope &) = delete;
+
+        ProfileScope &operator=(const ProfileScope &) = delete;
+
+    private:
+        const char *m_name;
+        uint64_t m_start{0};
+        uint32_t m_depth{0};
+    };
+
+} // namespace engine
+
+#define ENGINE_PROFILE_CONCAT_INNER(a, b) a##b
+#define ENGINE_PROFILE_CONCAT(a, b) ENGINE_PROFILE_CONCAT_INNER(a, b)
+
+// times the rest of the enclosing block, name must be a string literal
+#define PROFILE_SCOPE(name) ::engine::ProfileScope ENGINE_PROFILE_CONCAT(profileScope, __LINE__){name}
@@ -7,7 +7,9 @@
 namespace engine {
     RayTracingModel::RayTracingModel(Device &device, Model::Builder &builder) : m_device(device) {
             CreateVertexBuffers(builder.vertices);
-            CreateIndexBuffer(builder.indices);
+            // the acceleration structure only needs the full detail level
+            size_t indexCount = builder.lods.empty() ? builder.indices.size() : builder.lods.front().indexCount;
+            CreateIndexBuffer({builder.indices.begin(), builder.indices.begin() + static_cast<std::ptrdiff_t>(indexCount)});
             CreateAccelerationStructure();
     }
 
@@ -17,23 +19,13 @@ namespace engine {
         VkDeviceSize bufferSize = sizeof(vertices[0]) * m_vertexCount;
         uint32_t vertexSize = sizeof(vertices[0]);
 
-        Buffer stagingBuffer{
-                m_device,
-                vertexSize,
-                m_vertexCount,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *) vertices.data());
-
         m_vertexBuffer = std::make_unique<Buffer>(m_device, vertexSize, m_vertexCount,
                                                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                  MemoryTag::Models
         );
 
-        m_device.copyBuffer(stagingBuffer.getBuffer(), m_vertexBuffer->getBuffer(), bufferSize);
+        m_device.uploads().uploadBuffer(m_vertexBuffer->getBuffer(), vertices.data(), bufferSize);
     }
 
     void RayTracingModel::CreateIndexBuffer(const std::vector<uint32_t> &indices) {
@@ -47,31 +39,23 @@ namespace engine {
         VkDeviceSize bufferSize = sizeof(indices[0]) * m_indexCount;
         uint32_t indexSize = sizeof(indices[0]);
 
-        Buffer stagingBuffer{
-                m_device,
-                indexSize,
-                m_indexCount,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *) indices.data());
-
         m_indexBuffer = std::make_unique<Buffer>(
                 m_device,
                 indexSize,
                 m_indexCount,
                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                MemoryTag::Models
         );
 
-        m_device.copyBuffer(stagingBuffer.getBuffer(), m_indexBuffer->getBuffer(), bufferSize);
+        m_device.uploads().uploadBuffer(m_indexBuffer->getBuffer(), indices.data(), bufferSize);
     }
 
     void RayTracingModel::CreateAccelerationStructure() {
+        // the build below reads the geometry right away, so the uploads have to land first
+        m_device.uploads().waitIdle();
+
         VkCommandBuffer cmdBuffer = m_device.beginSingleTimeCommands();
 
         VkDeviceAddress vertexBufferAddress = m_vertexBuffer->getBufferDeviceAddress();
@@ -121,7 +105,8 @@ namespace engine {
                                                 VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR
                                                 | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
                                                 | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT // idk if this flag is right
+                                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // idk if this flag is right
+                                                MemoryTag::Models
         );
 
         VkAccelerationStructureCreateInfoKHR createInfo{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
@@ -138,7 +123,8 @@ namespace engine {
                              1,
                              VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
                              | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                             VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                             VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             MemoryTag::Staging
         };
 
         buildInfo.scratchData.deviceAddress = scratchBuffer.getBufferDeviceAddress();
@@ -0,0 +1,184 @@
+#include "RenderGraph.h"
+#include "GpuProfiler.h"
+#include "Profiler.h"
+
+#include <cassert>
+#include <utility>
+
+namespace engine {
+
+    namespace {
+        struct UseInfo {
+            VkPipelineStageFlags stages;
+            VkAccessFlags access;
+            // the part of access that has to be made available to later uses
+            VkAccessFlags writes;
+            VkImageLayout layout;
+        };
+
+        UseInfo useInfo(RenderGraph::Use use) {
+            switch (use) {
+                case RenderGraph::Use::ColorAttachment:
+                    return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+                case RenderGraph::Use::DepthAttachment:
+                    return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+                case RenderGraph::Use::FragmentSampled:
+                    return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                            VK_ACCESS_SHADER_READ_BIT,
+                            0,
+                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            }
+            assert(false && "Unknown image use");
+            return {};
+        }
+    } // namespace
+
+    RenderGraph::ImageId RenderGraph::addImage(const std::string &name, VkImageAspectFlags aspect) {
+        return add(name, aspect, false, false);
+    }
+
+    RenderGraph::ImageId RenderGraph::addTransientImage(const std::string &name, VkImageAspectFlags aspect) {
+        return add(name, aspect, false, true);
+    }
+
+    // a different image is presented every frame, none of them keeps anything
+    RenderGraph::ImageId RenderGraph::addSwapChainImage(const std::string &name) {
+        return add(name, VK_IMAGE_ASPECT_COLOR_BIT, true, true);
+    }
+
+    RenderGraph::ImageId RenderGraph::add(const std::string &name, VkImageAspectFlags aspect, bool swapChain,
+                                          bool transient) {
+        Image image{};
+        image.name = name;
+        image.aspect = aspect;
+        image.swapChain = swapChain;
+        image.transient = transient;
+        // the acquire semaphore is waited on at color attachment output
+        if (swapChain) {
+            image.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        }
+        m_images.push_back(std::move(image));
+        return static_cast<ImageId>(m_images.size() - 1);
+    }
+
+    void RenderGraph::bindImage(ImageId image, VkImage handle) {
+        assert(image < m_images.size() && "Unknown render graph image");
+        Image &bound = m_images[image];
+        if (bound.handle != handle) {
+            bound.handle = handle;
+            bound.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            bound.used = false;
+        }
+    }
+
+    void RenderGraph::addPass(const std::string &name, std::vector<ImageUse> uses,
+                              std::function<void(VkCommandBuffer)> record) {
+        for (size_t i = 0; i < uses.size(); i++) {
+            assert(uses[i].image < m_images.size() && "Unknown render graph image");
+            for (size_t j = 0; j < i; j++) {
+                assert(uses[i].image != uses[j].image && "A pass may use an image only once");
+            }
+        }
+        m_passes.push_back({name, std::move(uses), std::move(record)});
+    }
+
+    void RenderGraph::execute(VkCommandBuffer commandBuffer) {
+        PROFILE_SCOPE("RenderGraph::execute");
+        m_stats = {};
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+
+        auto flush = [&]() {
+            if (m_barriers.empty()) {
+                return;
+            }
+            vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0,
+                                 0, nullptr,
+                                 0, nullptr,
+                                 static_cast<uint32_t>(m_barriers.size()), m_barriers.data());
+            m_stats.barriers++;
+            m_stats.imageBarriers += static_cast<uint32_t>(m_barriers.size());
+            m_barriers.clear();
+            srcStages = 0;
+            dstStages = 0;
+        };
+
+        auto transition = [&](Image &image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                              VkPipelineStageFlags stages, VkAccessFlags access) {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = image.writes;
+            barrier.dstAccessMask = access;
+            barrier.oldLayout = oldLayout;
+            barrier.newLayout = newLayout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image.handle;
+            barrier.subresourceRange.aspectMask = image.aspect;
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+            m_barriers.push_back(barrier);
+            srcStages |= image.stages;
+            dstStages |= stages;
+        };
+
+        for (auto &pass : m_passes) {
+            for (const auto &use : pass.uses) {
+                Image &image = m_images[use.image];
+                assert(image.handle != VK_NULL_HANDLE && "Render graph image used before it was bound");
+                UseInfo info = useInfo(use.use);
+
+                // reads following reads in the same layout need no barrier, but a
+                // later write has to wait for all of them
+                if (image.used && image.layout == info.layout && image.writes == 0 && info.writes == 0) {
+                    image.stages |= info.stages;
+                    continue;
+                }
+
+                transition(image, image.used ? image.layout : VK_IMAGE_LAYOUT_UNDEFINED, info.layout,
+                           info.stages, info.access);
+                image.layout = info.layout;
+                image.stages = info.stages;
+                image.writes = info.writes;
+                image.used = true;
+            }
+            flush();
+
+            if (m_gpuProfiler) {
+                m_gpuProfiler->beginPass(commandBuffer, pass.name);
+            }
+            pass.record(commandBuffer);
+            if (m_gpuProfiler) {
+                m_gpuProfiler->endPass(commandBuffer);
+            }
+            m_stats.passes++;
+        }
+
+        for (auto &image : m_images) {
+            if (image.swapChain && image.used) {
+                transition(image, image.layout, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                           VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+                image.layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+                image.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+                image.writes = 0;
+            }
+            // the stages and writes stay, the next frame's first use still waits for them
+            if (image.transient) {
+                image.used = false;
+            }
+        }
+        flush();
+
+        m_passes.clear();
+    }
+
+} // namespace engine
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+    class GpuProfiler;
+
+    // The passes of one frame in submission order, each declaring the images it
+    // reads and writes. execute() derives the layout transitions and the barriers
+    // between passes from those declarations, so render passes keep their
+    // attachments in the layout they are used in and carry no external subpass
+    // dependencies. The first use of an image in a frame waits for its last use
+    // in the previous one. Layouts survive the frame too, except for transient
+    // and swap chain images, whose contents are discarded at every frame start.
+    class RenderGraph {
+    public:
+        using ImageId = uint32_t;
+
+        enum class Use {
+            ColorAttachment,   // written, and read back by blending
+            DepthAttachment,   // depth tested and written
+            FragmentSampled,   // sampled by fragment shaders
+        };
+
+        struct ImageUse {
+            ImageId image;
+            Use use;
+        };
+
+        struct Stats {
+            uint32_t passes{0};
+            uint32_t barriers{0};
+            uint32_t imageBarriers{0};
+        };
+
+        // An image that keeps its contents: its first use in a frame transitions from
+        // the layout of its last use, and reads following reads need no barrier.
+        ImageId addImage(const std::string &name, VkImageAspectFlags aspect);
+
+        // An image whose contents don't outlive the frame, like a cleared attachment:
+        // its first use in every frame starts from VK_IMAGE_LAYOUT_UNDEFINED, which
+        // lets the driver discard it instead of preserving the previous frame's.
+        ImageId addTransientImage(const std::string &name, VkImageAspectFlags aspect);
+
+        // A swap chain image. Its first use waits on the acquire semaphore, which
+        // is signalled at color attachment output, and it leaves the frame in
+        // VK_IMAGE_LAYOUT_PRESENT_SRC_KHR.
+        ImageId addSwapChainImage(const std::string &name);
+
+        // the VkImage behind image for the coming frames, images may be recreated or
+        // change every frame like the swap chain's. A new handle starts out undefined.
+        void bindImage(ImageId image, VkImage handle);
+
+        // an image may appear only once in uses
+        void addPass(const std::string &name, std::vector<ImageUse> uses,
+                     std::function<void(VkCommandBuffer)> record);
+
+        // records the passes added since the last call, each preceded by a single
+        // vkCmdPipelineBarrier if it needs one, and drops them
+        void execute(VkCommandBuffer commandBuffer);
+
+        // counters of the last execute
+        [[nodiscard]] const Stats &stats() const { return m_stats; }
+
+        // brackets every pass recorded by execute, after its barrier, with a GPU
+        // profiler pass of the same name, may be null
+        void setGpuProfiler(GpuProfiler *profiler) { m_gpuProfiler = profiler; }
+
+    private:
+        struct Image {
+            std::string name;
+            VkImageAspectFlags aspect;
+            bool swapChain;
+            bool transient;
+            VkImage handle{VK_NULL_HANDLE};
+            VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+            // stages that touched the image since its last barrier and the writes
+            // among those accesses that are not yet available
+            VkPipelineStageFlags stages{VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT};
+            VkAccessFlags writes{0};
+            // layout holds the image's contents, false until the first use and for
+            // transient images at the start of every frame
+            bool used{false};
+        };
+
+        struct Pass {
+            std::string name;
+            std::vector<ImageUse> uses;
+            std::function<void(VkCommandBuffer)> record;
+        };
+
+        ImageId add(const std::string &name, VkImageAspectFlags aspect, bool swapChain, bool transient);
+
+        std::vector<Image> m_images;
+        std::vector<Pass> m_passes;
+        std::vector<VkImageMemoryBarrier> m_barriers;
+        Stats m_stats;
+        GpuProfiler *m_gpuProfiler{nullptr};
+    };
+
+} // namespace engine
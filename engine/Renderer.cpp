@@ -1,42 +1,130 @@
 #include "Renderer.h"
+#include "Profiler.h"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <limits>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 
 namespace engine {
-    Renderer::Renderer(Window &window, Device &device, const VkExtent2D &extent)
-    : m_Window(window), m_Device(device), m_extent(extent) {
+    Renderer::Renderer(Window &window, Device &device, const VkExtent2D &extent, const FramePolicy &policy)
+    : m_Window(&window), m_Device(device), m_extent(extent), m_Policy(policy) {
         RecreateSwapChain();
+        // keep the clamped value so per-frame resources are sized like the swap chain
+        m_Policy.framesInFlight = m_SwapChain->framesInFlight();
+        Init();
+    }
+
+    Renderer::Renderer(Device &device, const VkExtent2D &extent, const FramePolicy &policy)
+    : m_Window(nullptr), m_Device(device), m_extent(extent), m_Policy(policy) {
+        m_Policy.framesInFlight = std::clamp(m_Policy.framesInFlight,
+                                             FramePolicy::MIN_FRAMES_IN_FLIGHT,
+                                             FramePolicy::MAX_FRAMES_IN_FLIGHT);
+        // the format swap chains usually end up with, so pipelines behave the same
+        m_Viewport = std::make_unique<OffscreenTarget>(m_Device, m_extent, VK_FORMAT_B8G8R8A8_SRGB,
+                                                       m_Device.findDepthFormat());
+        CreateFrameFences();
+        Init();
+    }
+
+    void Renderer::Init() {
+        m_FrameAllocator = std::make_unique<FrameAllocator>(m_Device, m_Policy.framesInFlight);
+        m_GpuProfiler = std::make_unique<GpuProfiler>(m_Device, m_Policy.framesInFlight);
+        m_Graph.setGpuProfiler(m_GpuProfiler.get());
         CreateCommandBuffers();
+
+        m_SwapChainImage = m_Graph.addSwapChainImage("swap chain");
+        m_ViewportColor = m_Graph.addTransientImage("viewport color", VK_IMAGE_ASPECT_COLOR_BIT);
+        m_ViewportDepth = m_Graph.addTransientImage("viewport depth", VK_IMAGE_ASPECT_DEPTH_BIT);
     }
 
-    Renderer::~Renderer() { FreeCommandBuffers(); }
+    Renderer::~Renderer() {
+        if (!m_FrameFences.empty()) {
+            vkWaitForFences(m_Device.device(), static_cast<uint32_t>(m_FrameFences.size()), m_FrameFences.data(),
+                            VK_TRUE, std::numeric_limits<uint64_t>::max());
+        }
+        for (auto fence : m_FrameFences) {
+            vkDestroyFence(m_Device.device(), fence, nullptr);
+        }
+        FreeCommandBuffers();
+    }
 
     void Renderer::RecreateSwapChain() {
-        auto extent = m_Window.getExtent();
+        auto extent = m_Window->getExtent();
 
         while (m_extent.width == 0 || m_extent.height == 0) {
-            m_extent = m_Window.getExtent();
+            m_extent = m_Window->getExtent();
             glfwWaitEvents();
         }
 
-        vkDeviceWaitIdle(m_Device.device());
+        m_Device.waitIdle();
 
         if (m_SwapChain == nullptr) {
-            m_SwapChain = std::make_unique<SwapChain>(m_Device, m_extent);
+            m_SwapChain = std::make_unique<SwapChain>(m_Device, m_extent, m_Policy);
         } else {
             std::shared_ptr<SwapChain> oldSwapChain = std::move(m_SwapChain);
-            m_SwapChain = std::make_unique<SwapChain>(m_Device, m_extent, oldSwapChain);
+            m_SwapChain = std::make_unique<SwapChain>(m_Device, m_extent, m_Policy, oldSwapChain);
 
             if (!oldSwapChain->compareSwapFormats(*m_SwapChain)) {
                 throw std::runtime_error("Swap chain image(or depth) format has changed!");
             }
         }
+        // the surface may not support the requested mode, keep the one actually in use
+        m_Policy.presentMode = m_SwapChain->presentMode();
+
+        if (m_Viewport == nullptr) {
+            m_Viewport = std::make_unique<OffscreenTarget>(m_Device, m_extent,
+                                                           m_SwapChain->getSwapChainImageFormat(),
+                                                           m_Device.findDepthFormat());
+        }
+    }
+
+    void Renderer::ResizeViewport() {
+        VkExtent2D current = m_Viewport->extent();
+        if (m_extent.width == 0 || m_extent.height == 0 ||
+            (current.width == m_extent.width && current.height == m_extent.height)) {
+            return;
+        }
+
+        // the attachments may still be read by frames in flight
+        m_Device.waitIdle();
+        m_Viewport->resize(m_extent);
+    }
+
+    void Renderer::SetPresentMode(VkPresentModeKHR presentMode) {
+        assert(!m_IsFramStarted && "Can't change the present mode while a frame is in progress");
+        if (m_Policy.presentMode == presentMode) {
+            return;
+        }
+        m_Policy.presentMode = presentMode;
+        if (m_SwapChain) {
+            RecreateSwapChain();
+        }
+    }
+
+    void Renderer::LimitFrameRate() {
+        if (m_Policy.maxFrameRate <= 0.0f) {
+            return;
+        }
+
+        auto frameDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<float>(1.0f / m_Policy.maxFrameRate));
+        auto now = std::chrono::steady_clock::now();
+
+        // don't try to catch up on frames that were missed by more than one period
+        if (m_NextFrameTime < now - frameDuration) {
+            m_NextFrameTime = now;
+        }
+        PROFILE_SCOPE("Renderer::limitFrameRate");
+        std::this_thread::sleep_until(m_NextFrameTime);
+        m_NextFrameTime += frameDuration;
     }
 
     void Renderer::CreateCommandBuffers() {
-        m_CommandBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        m_CommandBuffers.resize(m_Policy.framesInFlight);
 
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -50,6 +138,35 @@ namespace engine {
         }
     }
 
+    void Renderer::CreateFrameFences() {
+        m_FrameFences.resize(m_Policy.framesInFlight);
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        for (auto &fence : m_FrameFences) {
+            if (vkCreateFence(m_Device.device(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create frame fence");
+            }
+        }
+    }
+
+    void Renderer::SubmitHeadless(VkCommandBuffer commandBuffer) {
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        std::lock_guard<std::mutex> queueLock{m_Device.queueMutex()};
+
+        VkFence fence = m_FrameFences[m_CurrentFrameIndex];
+        vkResetFences(m_Device.device(), 1, &fence);
+        if (vkQueueSubmit(m_Device.graphicsQueue(), 1, &submitInfo, fence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit command buffer");
+        }
+    }
+
     void Renderer::FreeCommandBuffers() {
         vkFreeCommandBuffers(m_Device.device(), m_Device.getCommandPool(),
                              static_cast<uint32_t>(m_CommandBuffers.size()),
@@ -59,17 +176,41 @@ namespace engine {
     }
 
     VkCommandBuffer Renderer::BeginFrame() {
+        PROFILE_SCOPE("Renderer::BeginFrame");
         assert(!m_IsFramStarted && "Can't call BeginFrame while already in progress");
 
-        auto result = m_SwapChain->acquireNextImage(&m_CurrentImageIndex);
-        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-            RecreateSwapChain();
-            return nullptr;
+        LimitFrameRate();
+        ResizeViewport();
+        m_Device.uploads().poll();
+
+        if (m_SwapChain) {
+            auto result = m_SwapChain->acquireNextImage(&m_CurrentImageIndex);
+            if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                RecreateSwapChain();
+                return nullptr;
+            }
+
+            if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                throw std::runtime_error("Failed to acquire swap chain image");
+            }
+        } else {
+            PROFILE_SCOPE("Renderer::waitForFrame");
+            vkWaitForFences(m_Device.device(), 1, &m_FrameFences[m_CurrentFrameIndex], VK_TRUE,
+                            std::numeric_limits<uint64_t>::max());
         }
 
-        if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-            throw std::runtime_error("Failed to acquire swap chain image");
+        // the wait above covered this frame slot's fence, whatever was
+        // queued for deletion that many frames ago is no longer referenced
+        m_Device.deletionQueue().beginFrame(m_Policy.framesInFlight);
+        m_FrameAllocator->beginFrame(m_CurrentFrameIndex);
+
+        // the swap chain hands out a different image every frame and the viewport
+        // attachments are recreated on resize
+        if (m_SwapChain) {
+            m_Graph.bindImage(m_SwapChainImage, m_SwapChain->getImage(static_cast<int>(m_CurrentImageIndex)));
         }
+        m_Graph.bindImage(m_ViewportColor, m_Viewport->colorTexture()->image());
+        m_Graph.bindImage(m_ViewportDepth, m_Viewport->depthImage());
 
         m_IsFramStarted = true;
 
@@ -80,27 +221,38 @@ namespace engine {
         if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
             throw std::runtime_error("Failed to begin recording command buffer");
         }
+        m_GpuProfiler->beginFrame(commandBuffer, m_CurrentFrameIndex);
         return commandBuffer;
     }
 
     void Renderer::EndFrame() {
+        PROFILE_SCOPE("Renderer::EndFrame");
         assert(m_IsFramStarted && "Can't call EndFrame while frame is not in progress");
         auto commandBuffer = GetCurrentCommandBuffer();
+        m_GpuProfiler->endFrame(commandBuffer);
         if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
             throw std::runtime_error("Failed to record command buffer");
         }
 
-        auto result = m_SwapChain->submitCommandBuffers(&commandBuffer, &m_CurrentImageIndex);
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
-            m_Window.wasWindowResized()) {
-            m_Window.resetWindowResizedFlag();
-            RecreateSwapChain();
-        } else if (result != VK_SUCCESS) {
-            throw std::runtime_error("Failed to present swap chain image");
+        // uploads recorded up to now are submitted ahead of the frame that may use them
+        m_Device.uploads().flush();
+        m_FrameAllocator->flush();
+
+        if (m_SwapChain) {
+            auto result = m_SwapChain->submitCommandBuffers(&commandBuffer, &m_CurrentImageIndex);
+            if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+                m_Window->wasWindowResized()) {
+                m_Window->resetWindowResizedFlag();
+                RecreateSwapChain();
+            } else if (result != VK_SUCCESS) {
+                throw std::runtime_error("Failed to present swap chain image");
+            }
+        } else {
+            SubmitHeadless(commandBuffer);
         }
 
         m_IsFramStarted = false;
-        m_CurrentFrameIndex = (m_CurrentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
+        m_CurrentFrameIndex = (m_CurrentFrameIndex + 1) % m_Policy.framesInFlight;
     }
 
     void Renderer::BeginSwapChainRenderPass(VkCommandBuffer commandBuffer) const {
@@ -116,11 +268,10 @@ namespace engine {
         renderPassInfo.renderArea.offset = {0, 0};
         renderPassInfo.renderArea.extent = m_SwapChain->getSwapChainExtent();
 
-        std::array<VkClearValue, 2> clearValues{};
-        clearValues[0].color = {mClearColor.r, mClearColor.g, mClearColor.b, 1.0f};
-        clearValues[1].depthStencil = {1.0f, 0};
-        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-        renderPassInfo.pClearValues = clearValues.data();
+        VkClearValue clearValue{};
+        clearValue.color = {mClearColor.r, mClearColor.g, mClearColor.b, 1.0f};
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearValue;
 
         vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
@@ -142,15 +293,57 @@ namespace engine {
                "Can't end render pass on command buffer from a different frame");
 
         vkCmdEndRenderPass(commandBuffer);
+    }
 
-        m_SwapChain->copySwapChainImageToImGuiTexture(commandBuffer, m_CurrentImageIndex);
+    void Renderer::BeginViewportRenderPass(VkCommandBuffer commandBuffer) const {
+        assert(m_IsFramStarted && "Can't call BeginViewportRenderPass if frame is not in progress");
+        assert(commandBuffer == GetCurrentCommandBuffer() &&
+               "Can't begin render pass on command buffer from a different frame");
+
+        VkExtent2D extent = m_Viewport->extent();
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = m_Viewport->renderPass();
+        renderPassInfo.framebuffer = m_Viewport->framebuffer();
+
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = extent;
+
+        std::array<VkClearValue, 2> clearValues{};
+        clearValues[0].color = {mClearColor.r, mClearColor.g, mClearColor.b, 1.0f};
+        clearValues[1].depthStencil = {1.0f, 0};
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(extent.width);
+        viewport.height = static_cast<float>(extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        VkRect2D scissor{{0, 0}, extent};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    }
+
+    void Renderer::EndViewportRenderPass(VkCommandBuffer commandBuffer) const {
+        assert(m_IsFramStarted && "Can't call EndViewportRenderPass if frame is not in progress");
+        assert(commandBuffer == GetCurrentCommandBuffer() &&
+               "Can't end render pass on command buffer from a different frame");
+
+        vkCmdEndRenderPass(commandBuffer);
     }
 
     std::shared_ptr<Texture> Renderer::GetTexture() {
-        return m_SwapChain->getTexture();
+        return m_Viewport->colorTexture();
     }
 
     void Renderer::RenderImGui() {
+        PROFILE_SCOPE("Renderer::RenderImGui");
         ImGui::Render();
         ImDrawData* draw_data = ImGui::GetDrawData();
 
@@ -162,13 +355,12 @@ namespace engine {
         info.framebuffer = m_SwapChain->getFrameBuffer(m_CurrentImageIndex);
         info.renderArea.extent = m_SwapChain->getSwapChainExtent();
 
-        // Provide clear values for color and depth-stencil attachments
-        std::array<VkClearValue, 2> clearValues{};
-        clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f}; // Clear color (black with full opacity)
-        clearValues[1].depthStencil = {1.0f, 0}; // Clear depth to 1.0f and stencil to 0
+        // the swap chain pass has a single color attachment, cleared to opaque black
+        VkClearValue clearValue{};
+        clearValue.color = {0.0f, 0.0f, 0.0f, 1.0f};
 
-        info.clearValueCount = static_cast<uint32_t>(clearValues.size());
-        info.pClearValues = clearValues.data();
+        info.clearValueCount = 1;
+        info.pClearValues = &clearValue;
 
         vkCmdBeginRenderPass(commandBuffer, &info, VK_SUBPASS_CONTENTS_INLINE);
 
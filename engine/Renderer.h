@@ -1,6 +1,10 @@
 #pragma once
 
 #include "Device.h"
+#include "FrameAllocator.h"
+#include "GpuProfiler.h"
+#include "OffscreenTarget.h"
+#include "RenderGraph.h"
 #include "SwapChain.h"
 #include "Window.h"
 #include <cassert>
@@ -11,6 +15,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <chrono>
 #include <memory>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -19,10 +24,12 @@ namespace engine {
     class Renderer {
     public:
         std::unique_ptr<SwapChain> m_SwapChain;
+        std::unique_ptr<OffscreenTarget> m_Viewport;
         std::vector<VkCommandBuffer> m_CommandBuffers;
 
     private:
-        Window &m_Window;
+        // null when headless
+        Window *m_Window;
         Device &m_Device;
 
 
@@ -33,8 +40,27 @@ namespace engine {
         glm::vec3 mClearColor;
         VkExtent2D m_extent;
 
+        FramePolicy m_Policy;
+        std::unique_ptr<FrameAllocator> m_FrameAllocator;
+        // times the frames and the render graph's passes
+        std::unique_ptr<GpuProfiler> m_GpuProfiler;
+
+        // the frame's passes, the images below are bound to it in BeginFrame
+        RenderGraph m_Graph;
+        RenderGraph::ImageId m_SwapChainImage;
+        RenderGraph::ImageId m_ViewportColor;
+        RenderGraph::ImageId m_ViewportDepth;
+        std::chrono::steady_clock::time_point m_NextFrameTime{};
+
+        // one per frame in flight when headless, the swap chain paces frames otherwise
+        std::vector<VkFence> m_FrameFences;
+
     public:
-        Renderer(Window &window, Device &device, const VkExtent2D &extent);
+        Renderer(Window &window, Device &device, const VkExtent2D &extent, const FramePolicy &policy = {});
+
+        // Renders into the viewport only. There is no swap chain, nothing is
+        // presented and the present mode is ignored.
+        Renderer(Device &device, const VkExtent2D &extent, const FramePolicy &policy = {});
 
         ~Renderer();
 
@@ -45,10 +71,17 @@ namespace engine {
         void SetClearColor(const glm::vec3 &color) { mClearColor = color; }
         [[nodiscard]] glm::vec3 GetClearColor() const { return mClearColor; }
 
+        [[nodiscard]] bool IsHeadless() const { return m_SwapChain == nullptr; }
+
         [[nodiscard]] VkRenderPass GetSwapChainRenderPass() const {
+            assert(m_SwapChain && "A headless renderer has no swap chain");
             return m_SwapChain->getRenderPass();
         }
 
+        [[nodiscard]] VkRenderPass GetViewportRenderPass() const {
+            return m_Viewport->renderPass();
+        }
+
         [[nodiscard]] float GetAspectRatio() const {
 //            return m_SwapChain->extentAspectRatio();
             return static_cast<float>(m_extent.width) /
@@ -67,6 +100,24 @@ namespace engine {
             return m_CurrentFrameIndex;
         }
 
+        [[nodiscard]] uint32_t GetFramesInFlight() const { return m_Policy.framesInFlight; }
+
+        [[nodiscard]] const FramePolicy &GetFramePolicy() const { return m_Policy; }
+
+        [[nodiscard]] FrameAllocator &GetFrameAllocator() const { return *m_FrameAllocator; }
+
+        [[nodiscard]] GpuProfiler &GetGpuProfiler() const { return *m_GpuProfiler; }
+
+        [[nodiscard]] RenderGraph &GetRenderGraph() { return m_Graph; }
+        [[nodiscard]] RenderGraph::ImageId GetSwapChainImage() const { return m_SwapChainImage; }
+        [[nodiscard]] RenderGraph::ImageId GetViewportColor() const { return m_ViewportColor; }
+        [[nodiscard]] RenderGraph::ImageId GetViewportDepth() const { return m_ViewportDepth; }
+
+        // recreates the swap chain, the frames in flight count is fixed at construction
+        void SetPresentMode(VkPresentModeKHR presentMode);
+
+        void SetMaxFrameRate(float maxFrameRate) { m_Policy.maxFrameRate = maxFrameRate; }
+
         [[nodiscard]] uint32_t GetImageCount() const {return (uint32_t) m_SwapChain->imageCount();}
 
         std::shared_ptr<Texture> GetTexture();
@@ -79,16 +130,31 @@ namespace engine {
 
         void EndSwapChainRenderPass(VkCommandBuffer commandBuffer) const;
 
+        void BeginViewportRenderPass(VkCommandBuffer commandBuffer) const;
+
+        void EndViewportRenderPass(VkCommandBuffer commandBuffer) const;
+
         void RenderImGui();
 
         void SetExtent(const VkExtent2D &extent) { m_extent = extent; }
         [[nodiscard]] VkExtent2D Extent() const { return m_extent; }
 
     private:
+        // frame resources shared by both constructors, m_Policy is final by now
+        void Init();
+
         void CreateCommandBuffers();
 
+        void CreateFrameFences();
+
+        void SubmitHeadless(VkCommandBuffer commandBuffer);
+
         void FreeCommandBuffers();
 
         void RecreateSwapChain();
+
+        void ResizeViewport();
+
+        void LimitFrameRate();
     };
 } // namespace engine
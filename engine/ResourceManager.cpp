@@ -3,87 +3,287 @@
 //
 
 #include "ResourceManager.h"
+#include "MeshCooker.h"
+#include "Profiler.h"
+#include "TextureCooker.h"
 #include "descriptors/DescriptorWriter.h"
 
+#include <algorithm>
 #include <filesystem>
+#include <iostream>
 
 
 namespace engine {
-ResourceManager::ResourceManager(Device &device) : m_device(device) {
+namespace {
+// unit cube drawn in place of models that are still loading
+Model::Builder placeholderCube() {
+  static const glm::vec3 normals[] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+  static const glm::vec2 corners[] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+
+  Model::Builder builder{};
+  for (const auto &normal : normals) {
+    glm::vec3 u{normal.y, normal.z, normal.x};
+    glm::vec3 v = glm::cross(normal, u);
+    auto base = static_cast<uint32_t>(builder.vertices.size());
+    for (const auto &corner : corners) {
+      Model::Vertex vertex{};
+      vertex.position = 0.5f * (normal + corner.x * u + corner.y * v);
+      vertex.normal = normal;
+      vertex.uv = (corner + 1.0f) * 0.5f;
+      builder.vertices.push_back(vertex);
+    }
+    builder.indices.insert(builder.indices.end(), {base, base + 1, base + 2, base, base + 2, base + 3});
+  }
+  return builder;
+}
+
+// prefers an up to date .cmesh next to the OBJ, a cooked file that fails to
+// load falls back to parsing the OBJ again
+std::shared_ptr<Model> loadModel(Device &device, const std::string &filepath, Model::VertexFormat format) {
+  if (hasCookedMesh(filepath)) {
+    try {
+      return std::make_shared<Model>(device, loadCookedMesh(cookedMeshPath(filepath)), 2, format);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << ", loading " << filepath << " instead" << std::endl;
+    }
+  }
+
+  Model::Builder builder{};
+  if (!builder.LoadModel(filepath)) {
+    return nullptr;
+  }
+  return std::make_shared<Model>(device, builder, 2, format);
+}
+} // namespace
+
+ResourceManager::ResourceManager(Device &device)
+    : m_device(device), m_useCooked(device.enabledFeatures.textureCompressionBC) {
   m_descriptorPool = DescriptorPool::Builder(m_device)
-                    .setMaxSets(1000)
-                    .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000)
+                    .setMaxSets(FramePolicy::MAX_FRAMES_IN_FLIGHT + 1)
+                    .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)
+                    .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, FramePolicy::MAX_FRAMES_IN_FLIGHT + 1)
                     .build();
 
   m_descriptorSetLayout = DescriptorSetLayout::Builder{m_device}.
                           addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT).
                           build();
 
+  m_placeholderModel = std::make_shared<Model>(m_device, placeholderCube());
+
+  // bound until the first texture finished loading, the pipeline layout always needs set 2
+  auto white = std::make_shared<TextureImage>();
+  white->filepath = "placeholder";
+  white->extent = {1, 1};
+  white->data = {255, 255, 255, 255};
+  m_placeholderArray = std::make_unique<TextureArray>(
+      m_device, std::vector<std::shared_ptr<const TextureImage>>{white}, m_samplerSettings);
+  writeMaterialSet(*m_placeholderArray);
 }
 
 bool ResourceManager::importModel(const std::string &filepath) {
+  PROFILE_SCOPE("ResourceManager::importModel");
 
   std::string name = std::filesystem::path(filepath).filename().string();
   if (m_models.find(name) != m_models.end()) return false;
 
-  Model::Builder builder{};
-  if (builder.LoadModel(filepath)) {
-    m_models[name] = std::make_shared<Model>(m_device, builder);
+  std::shared_ptr<Model> model = loadModel(m_device, filepath, m_vertexFormat);
+  if (model) {
+    AssetHandle<Model> handle{m_placeholderModel};
+    handle.publish(std::move(model));
+    m_models[name] = handle;
     return true;
   }
   return false;
 }
 
+AssetHandle<Model> ResourceManager::importModelAsync(const std::string &filepath) {
+  std::string name = std::filesystem::path(filepath).filename().string();
+  auto it = m_models.find(name);
+  if (it != m_models.end()) return it->second;
+
+  AssetHandle<Model> handle{m_placeholderModel};
+  m_models[name] = handle;
+
+  // the model's uploads land in the open UploadQueue batch, which the renderer
+  // submits ahead of any frame that can see the published model
+  m_workers.submit([&device = m_device, handle, filepath, format = m_vertexFormat]() {
+    PROFILE_SCOPE("ResourceManager::loadModel");
+    try {
+      std::shared_ptr<Model> model = loadModel(device, filepath, format);
+      if (!model) {
+        throw std::runtime_error("failed to load model: " + filepath);
+      }
+      handle.publish(std::move(model));
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      handle.fail();
+    }
+  });
+  return handle;
+}
+
 std::shared_ptr<Model> ResourceManager::getModel(Structure::Type type) {
   switch (type) {
   case Structure::TYPE_1:
     return getModel("structure_1.obj");
   }
+  return nullptr;
 }
 
 std::shared_ptr<Model> ResourceManager::getModel(const std::string &filepath) {
-  return m_models[filepath];
+  auto it = m_models.find(filepath);
+  return it != m_models.end() ? it->second.get() : nullptr;
+}
+
+AssetHandle<const TextureImage> ResourceManager::loadTexture(const std::string &filepath, bool async) {
+  // cooked files are only used while every texture so far had one with the same
+  // layout, the array cannot mix block compressed and RGBA layers
+  std::string path = m_useCooked && hasCookedTexture(filepath) ? cookedTexturePath(filepath) : filepath;
+
+  AssetHandle<const TextureImage> handle{nullptr};
+  m_texturesRequested++;
+  auto load = [handle, path, &loaded = m_texturesLoaded]() {
+    PROFILE_SCOPE("ResourceManager::loadTexture");
+    try {
+      handle.publish(std::make_shared<const TextureImage>(TextureImage::load(path)));
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      handle.fail();
+    }
+    loaded.fetch_add(1, std::memory_order_release);
+  };
+
+  if (async) {
+    m_workers.submit(std::move(load));
+  } else {
+    load();
+  }
+  return handle;
 }
 
 bool ResourceManager::importTexture(const std::string &filepath) {
     std::string name = std::filesystem::path(filepath).filename().string();
-    if (m_textures.find(name) == m_textures.end()) {
-      m_textures[name] = std::make_shared<Texture>(m_device, filepath);
-      return true;
+    if (m_textures.find(name) != m_textures.end()) {
+      return false;
     }
-    return false;
+    auto layer = static_cast<uint32_t>(m_textures.size());
+    auto handle = loadTexture(filepath, false);
+    m_textures[name] = {filepath, handle, layer};
+    return !handle.failed();
 }
 
-VkDescriptorSet ResourceManager::getTexture(Structure::Type type) {
+AssetHandle<const TextureImage> ResourceManager::importTextureAsync(const std::string &filepath) {
+    std::string name = std::filesystem::path(filepath).filename().string();
+    auto it = m_textures.find(name);
+    if (it != m_textures.end()) {
+      return it->second.image;
+    }
+    auto layer = static_cast<uint32_t>(m_textures.size());
+    auto handle = loadTexture(filepath, true);
+    m_textures[name] = {filepath, handle, layer};
+    return handle;
+}
+
+uint32_t ResourceManager::getTextureLayer(Structure::Type type) const {
     switch (type) {
     case Structure::TYPE_1:
-      return getTexture("structure_1.png");
+      return getTextureLayer("structure_1.png");
+    }
+    return NO_TEXTURE;
+}
+
+uint32_t ResourceManager::getTextureLayer(const std::string &filepath) const {
+    auto it = m_textureLayers.find(filepath);
+    return it != m_textureLayers.end() ? it->second : NO_TEXTURE;
+}
+
+VkDescriptorSet ResourceManager::getMaterialSet() {
+    // every rebuild uploads the whole array, textures finishing a few frames apart
+    // are folded into one rebuild once the last of them is done
+    uint32_t loaded = m_texturesLoaded.load(std::memory_order_acquire);
+    bool settled = loaded == m_texturesRequested ||
+                   std::chrono::steady_clock::now() - m_materialsBuiltAt >= MATERIAL_REBUILD_INTERVAL;
+    if (m_materialsDirty || (loaded != m_texturesBuilt && settled)) {
+      rebuildMaterials();
     }
+    return m_materialSet;
+}
+
+void ResourceManager::setSamplerSettings(const SamplerSettings &settings) {
+    m_samplerSettings = settings;
+    m_materialsDirty = true;
 }
 
-VkDescriptorSet ResourceManager::getTexture(const std::string &filepath) {
-    if (m_textureDescritporSets.find(filepath) != m_textureDescritporSets.end()) {
-        return m_textureDescritporSets[filepath];
+void ResourceManager::rebuildMaterials() {
+    PROFILE_SCOPE("ResourceManager::rebuildMaterials");
+    m_materialsDirty = false;
+    m_texturesBuilt = m_texturesLoaded.load(std::memory_order_acquire);
+    m_materialsBuiltAt = std::chrono::steady_clock::now();
+
+    // layers follow the import order, so a texture's layer never changes when
+    // another one finishes, layers of textures that aren't ready stay null for now
+    std::vector<std::shared_ptr<const TextureImage>> images;
+    std::unordered_map<std::string, uint32_t> layers;
+    std::shared_ptr<const TextureImage> firstCooked;
+    for (auto &[name, entry] : m_textures) {
+      if (!entry.image.ready()) continue;
+      auto image = entry.image.get();
+      if (images.size() <= entry.layer) images.resize(entry.layer + 1);
+      images[entry.layer] = image;
+      layers[name] = entry.layer;
+      if (image->cooked() && !firstCooked) firstCooked = image;
     }
-    auto it = m_textures.find(filepath);
-    if (it == m_textures.end()) {
-      throw std::runtime_error("Texture not found: " + filepath);
+
+    // a texture without a cook showed up, or two cooks differ in codec, extent or
+    // level count, block data cannot be rescaled so the cooked ones are reloaded as RGBA
+    bool mixed = firstCooked && std::any_of(images.begin(), images.end(), [&](const auto &image) {
+      return image && (!image->cooked() || image->format != firstCooked->format ||
+                       image->extent.width != firstCooked->extent.width ||
+                       image->extent.height != firstCooked->extent.height ||
+                       image->levelCount != firstCooked->levelCount);
+    });
+    if (mixed) {
+      m_useCooked = false;
+      for (auto &[name, entry] : m_textures) {
+        if (entry.image.ready() && entry.image.get()->cooked()) {
+          entry.image = loadTexture(entry.filepath, true);
+        }
+      }
+      return;
+    }
+
+    // the gaps repeat a ready image, nothing samples them before their own texture arrives
+    std::unique_ptr<TextureArray> array;
+    if (!images.empty()) {
+      auto filler = *std::find_if(images.begin(), images.end(), [](const auto &image) { return image != nullptr; });
+      std::replace(images.begin(), images.end(), std::shared_ptr<const TextureImage>{}, filler);
+      array = std::make_unique<TextureArray>(m_device, images, m_samplerSettings);
+    }
+    writeMaterialSet(array ? *array : *m_placeholderArray);
+
+    m_textureArray = std::move(array);
+    m_textureLayers = std::move(layers);
+}
+
+void ResourceManager::writeMaterialSet(const TextureArray &array) {
+    // frames still in flight may reference the old set, its array is released
+    // through the deletion queue by the TextureArray destructor
+    if (m_materialSet != VK_NULL_HANDLE) {
+      m_device.deletionQueue().push([pool = m_descriptorPool, set = m_materialSet]() {
+        std::vector<VkDescriptorSet> sets{set};
+        pool->freeDescriptors(sets);
+      });
+      m_materialSet = VK_NULL_HANDLE;
     }
-    auto &texture = it->second;
-    VkDescriptorSet descriptorSet;
 
     VkDescriptorImageInfo imageInfo{};
-    imageInfo.sampler = texture->sampler();
-    imageInfo.imageView = texture->imageView();
+    imageInfo.sampler = array.sampler();
+    imageInfo.imageView = array.imageView();
     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
     DescriptorWriter{*m_descriptorSetLayout, *m_descriptorPool}
         .writeImage(0, &imageInfo, 1)
-        .build(descriptorSet);
-
-    m_textureDescritporSets[filepath] = descriptorSet;
-
-    return descriptorSet;
+        .build(m_materialSet);
 }
 
 std::vector<std::string> ResourceManager::getModelNames() const {
@@ -99,7 +299,7 @@ ResourceManager::~ResourceManager() = default;
 
 std::string ResourceManager::getModelName(const std::shared_ptr<Model> &model) {
     for (auto &it : m_models) {
-        if (it.second == model) {
+        if (it.second.get() == model) {
           return it.first;
         }
     }
@@ -110,15 +310,6 @@ void ResourceManager::deleteModel(const std::string &filepath) {
     m_models.erase(filepath);
 }
 
-std::string ResourceManager::getTextureName(VkDescriptorSet texture) {
-    for (auto &it : m_textureDescritporSets) {
-        if (it.second == texture) {
-          return it.first;
-        }
-    }
-    return {};
-}
-
 std::vector<std::string> ResourceManager::getTextureNames() const {
     std::vector<std::string> names;
     names.reserve(m_textures.size());
@@ -128,4 +319,4 @@ std::vector<std::string> ResourceManager::getTextureNames() const {
     return names;
 }
 
-} // engine
\ No newline at end of file
+} // engine
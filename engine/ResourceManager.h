@@ -1,7 +1,9 @@
 #pragma once
 
+#include "AssetHandle.h"
 #include "Model.h"
 #include "SwapChain.h"
+#include "ThreadPool.h"
 #include "descriptors/DescriptorPool.h"
 #include "descriptors/DescriptorSetLayout.h"
 
@@ -9,33 +11,90 @@
 #include "TextureArray.h"
 #include "entt/entt.hpp"
 
+#include <atomic>
+#include <chrono>
+
 namespace engine {
 
     class ResourceManager {
+    public:
+       // texture layer of assets that are not loaded, the mesh shader draws those untextured
+       static constexpr uint32_t NO_TEXTURE = ~0u;
+
     private:
+       struct TextureEntry {
+         std::string filepath;
+         AssetHandle<const TextureImage> image;
+         // import position, the texture keeps this array layer for good
+         uint32_t layer;
+       };
+
+       // bound on how long finished textures wait for the rest of a burst of loads
+       static constexpr std::chrono::milliseconds MATERIAL_REBUILD_INTERVAL{250};
+
        Device &m_device;
        std::shared_ptr<DescriptorPool> m_descriptorPool;
        std::shared_ptr<DescriptorSetLayout> m_descriptorSetLayout;
 
-       std::unordered_map<std::string, std::shared_ptr<Model>> m_models;
-       std::unordered_map<std::string, std::shared_ptr<Texture>> m_textures;
-       std::unordered_map<std::string, VkDescriptorSet> m_textureDescritporSets;
+       // the maps are only touched by the thread owning the ResourceManager, loader
+       // threads publish through the handles, so lookups never take a lock
+       std::unordered_map<std::string, AssetHandle<Model>> m_models;
+       std::shared_ptr<Model> m_placeholderModel;
+
+       // structure textures share one array that only holds the textures already
+       // decoded, it is rebuilt once the loads in flight finished
+       std::unordered_map<std::string, TextureEntry> m_textures;
+       std::unordered_map<std::string, uint32_t> m_textureLayers;
+       std::unique_ptr<TextureArray> m_textureArray;
+       std::unique_ptr<TextureArray> m_placeholderArray;
+       VkDescriptorSet m_materialSet{VK_NULL_HANDLE};
+       SamplerSettings m_samplerSettings{};
+       bool m_useCooked;
+       Model::VertexFormat m_vertexFormat{Model::VertexFormat::Compact};
+       bool m_materialsDirty{false};
+       uint32_t m_texturesRequested{0};
+       std::atomic<uint32_t> m_texturesLoaded{0};
+       uint32_t m_texturesBuilt{0};
+       std::chrono::steady_clock::time_point m_materialsBuiltAt{};
+
+       // declared last so the workers are joined before anything they reference is destroyed
+       ThreadPool m_workers;
+
+       AssetHandle<const TextureImage> loadTexture(const std::string &filepath, bool async);
+       void rebuildMaterials();
+       void writeMaterialSet(const TextureArray &array);
 
     public:
        explicit ResourceManager(Device &device);
        ~ResourceManager();
 
        bool importModel(const std::string &filepath);
+       // parses and uploads on a worker thread, the handle yields a placeholder cube until then
+       AssetHandle<Model> importModelAsync(const std::string &filepath);
        std::shared_ptr<Model> getModel(const std::string &filepath);
        std::shared_ptr<Model> getModel(Structure::Type type);
        void deleteModel(const std::string &filepath);
 
        bool importTexture(const std::string &filepath);
-       VkDescriptorSet getTexture(const std::string &filepath);
-       VkDescriptorSet getTexture(Structure::Type type);
-       std::string getTextureName(VkDescriptorSet texture);
+       // decodes on a worker thread, the texture's layer is NO_TEXTURE until the image is ready
+       AssetHandle<const TextureImage> importTextureAsync(const std::string &filepath);
+       uint32_t getTextureLayer(const std::string &filepath) const;
+       uint32_t getTextureLayer(Structure::Type type) const;
        std::vector<std::string> getTextureNames() const;
 
+       // descriptor set holding every loaded texture as a sampler2DArray, the array is
+       // rebuilt on first use after the textures loading finished, or after
+       // MATERIAL_REBUILD_INTERVAL while more of them are still loading
+       VkDescriptorSet getMaterialSet();
+
+       const SamplerSettings &getSamplerSettings() const { return m_samplerSettings; }
+       void setSamplerSettings(const SamplerSettings &settings);
+
+       // format of the models imported from now on, compact halves their vertex buffers
+       // but half float uvs lose texel precision on textures repeated many times
+       Model::VertexFormat getVertexFormat() const { return m_vertexFormat; }
+       void setVertexFormat(Model::VertexFormat format) { m_vertexFormat = format; }
+
        std::vector<std::string> getModelNames() const;
        std::string getModelName(const std::shared_ptr<Model> &model);
        VkDescriptorSetLayout getTextureSetLayout() const { return m_descriptorSetLayout->getDescriptorSetLayout(); }
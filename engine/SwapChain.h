@@ -1,7 +1,6 @@
 #pragma once
 
 #include "Device.h"
-#include "Texture.h"
 
 // vulkan headers
 #include <memory>
@@ -13,13 +12,24 @@
 
 namespace engine {
 
+    // Latency/throughput trade-off of the presentation loop. Fewer frames in
+    // flight and FIFO keep input latency low while editing, more frames and
+    // immediate/mailbox favour raw throughput for benchmark runs.
+    struct FramePolicy {
+        static constexpr uint32_t MIN_FRAMES_IN_FLIGHT = 1;
+        static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+        uint32_t framesInFlight = 2;
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        // frames per second, 0 means uncapped
+        float maxFrameRate = 0.0f;
+    };
+
     class SwapChain {
     public:
-        static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
-        SwapChain(Device &deviceRef, VkExtent2D windowExtent);
+        SwapChain(Device &deviceRef, VkExtent2D windowExtent, const FramePolicy &policy);
 
-        SwapChain(Device &deviceRef, VkExtent2D windowExtent,
+        SwapChain(Device &deviceRef, VkExtent2D windowExtent, const FramePolicy &policy,
                   std::shared_ptr<SwapChain> previous);
 
         ~SwapChain();
@@ -34,6 +44,8 @@ namespace engine {
 
         VkRenderPass getRenderPass() { return renderPass; }
 
+        VkImage getImage(int index) { return swapChainImages[index]; }
+
         VkImageView getImageView(int index) { return swapChainImageViews[index]; }
 
         size_t imageCount() { return swapChainImages.size(); }
@@ -46,14 +58,14 @@ namespace engine {
 
         uint32_t height() { return swapChainExtent.height; }
 
-        std::shared_ptr<engine::Texture> getTexture() { return texture; }
-
         float extentAspectRatio() {
             return static_cast<float>(swapChainExtent.width) /
                    static_cast<float>(swapChainExtent.height);
         }
 
-        VkFormat findDepthFormat();
+        uint32_t framesInFlight() const { return policy.framesInFlight; }
+
+        VkPresentModeKHR presentMode() const { return swapChainPresentMode; }
 
         VkResult acquireNextImage(uint32_t *imageIndex);
 
@@ -61,20 +73,15 @@ namespace engine {
                                       uint32_t *imageIndex);
 
         bool compareSwapFormats(const SwapChain &swapChain) const {
-            return swapChain.swapChainDepthFormat == swapChainDepthFormat &&
-                   swapChain.swapChainImageFormat == swapChainImageFormat;
+            return swapChain.swapChainImageFormat == swapChainImageFormat;
         }
 
-        void copySwapChainImageToImGuiTexture(VkCommandBuffer commandBuffer, uint32_t imageIndex);
-
 
     private:
         void createSwapChain();
 
         void createImageViews();
 
-        void createDepthResources();
-
         void createRenderPass();
 
         void createFramebuffers();
@@ -93,22 +100,19 @@ namespace engine {
 
         VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
 
+        FramePolicy policy;
+
         VkFormat swapChainImageFormat;
-        VkFormat swapChainDepthFormat;
+        VkPresentModeKHR swapChainPresentMode;
         VkExtent2D swapChainExtent;
         std::shared_ptr<SwapChain> m_OldSwapChain;
 
         std::vector<VkFramebuffer> swapChainFramebuffers;
         VkRenderPass renderPass;
 
-        std::vector<VkImage> depthImages;
-        std::vector<VkDeviceMemory> depthImageMemorys;
-        std::vector<VkImageView> depthImageViews;
         std::vector<VkImage> swapChainImages;
         std::vector<VkImageView> swapChainImageViews;
 
-        std::shared_ptr<engine::Texture> texture;
-
         Device &device;
         VkExtent2D windowExtent;
 
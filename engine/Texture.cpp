@@ -1,23 +1,41 @@
 #include "Texture.h"
-#include "Buffer.h"
+#include "MipChain.h"
+#include "TextureCooker.h"
 #include "descriptors/DescriptorWriter.h"
 #include "stb/stb_image.h"
 
+#include <algorithm>
 #include <cmath>
 #include <stdexcept>
 #include <utility>
+#include <vector>
 
 namespace engine {
 
-    Texture::Texture(Device& device, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect)
-            : m_device{device}, m_extent{extent}, m_format{format}, m_usage{usage}, m_aspect{aspect} {
+    void SamplerSettings::apply(VkSamplerCreateInfo &info, const VkPhysicalDeviceLimits &limits, uint32_t mipLevels) const {
+        float anisotropy = std::min(maxAnisotropy, limits.maxSamplerAnisotropy);
+        info.anisotropyEnable = anisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+        info.maxAnisotropy = std::max(anisotropy, 1.0f);
+        info.mipLodBias = std::clamp(mipLodBias, -limits.maxSamplerLodBias, limits.maxSamplerLodBias);
+        info.minLod = 0.0f;
+        info.maxLod = static_cast<float>(mipLevels);
+    }
+
+    Texture::Texture(Device& device, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+                     MemoryTag tag)
+            : m_device{device}, m_extent{extent}, m_format{format}, m_usage{usage}, m_aspect{aspect}, m_tag{tag} {
         createImage();
         createImageView();
         createSampler();
     }
 
-    Texture::Texture(Device &device, const std::string &filepath)
-    : m_device(device) {
+    Texture::Texture(Device &device, const std::string &filepath, const SamplerSettings &samplerSettings)
+    : m_samplerSettings(samplerSettings), m_device(device) {
+        if (isCookedTexture(filepath)) {
+            loadCooked(filepath);
+            return;
+        }
+
 //        int channels;
         int bytesPerPixel;
         int width, height;
@@ -30,48 +48,61 @@ namespace engine {
           throw std::runtime_error("failed to load image: " + filepath);
         }
 
-//        m_mipLevels = (uint32_t) std::floor(std::log2(std::max(m_extent.width, m_extent.height))) + 1;
-
-        Buffer stagingBuffer{m_device,
-                             4,
-                             m_extent.width * m_extent.height,
-                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-                                 | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer(data);
+        m_mipLevels = mipLevelCount(m_extent);
 
         m_format = VK_FORMAT_R8G8B8A8_SRGB;
         m_usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
         createImage();
 
-        auto cmdBuffer = m_device.beginSingleTimeCommands();
-        transitionImageLayout(cmdBuffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        m_device.endSingleTimeCommands(cmdBuffer);
+        VkImageSubresourceRange range{m_aspect, 0, m_mipLevels, 0, 1};
+        if (supportsLinearBlit(m_device.physicalDevice(), m_format)) {
+            VkBufferImageCopy region{};
+            region.imageSubresource.aspectMask = m_aspect;
+            region.imageSubresource.mipLevel = 0;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = {m_extent.width, m_extent.height, 1};
+
+            m_device.uploads().uploadImage(m_image, range, data, 4ull * m_extent.width * m_extent.height, {region},
+                                           m_extent, true);
+        } else {
+            std::vector<VkBufferImageCopy> regions;
+            std::vector<uint8_t> chain = buildMipChain(data, m_extent, 1, m_mipLevels, true, regions);
+            m_device.uploads().uploadImage(m_image, range, chain.data(), chain.size(), regions);
+        }
+
+        createImageView();
+        createSampler();
+
+        stbi_image_free(data);
+    }
 
-        m_device.copyBufferToImage(stagingBuffer.getBuffer(), m_image, m_extent.width, m_extent.height, 1);
+    void Texture::loadCooked(const std::string &filepath) {
+        CookedTexture cooked = loadCookedTexture(filepath);
 
-        cmdBuffer = m_device.beginSingleTimeCommands();
-        transitionImageLayout(cmdBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        m_device.endSingleTimeCommands(cmdBuffer);
+        m_extent = cooked.extent;
+        m_format = cooked.format;
+        m_mipLevels = cooked.levelCount;
+        m_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
-//        generateMipmaps();
+        createImage();
 
-//        mImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        VkImageSubresourceRange range{m_aspect, 0, m_mipLevels, 0, 1};
+        m_device.uploads().uploadImage(m_image, range, cooked.data.data(), cooked.data.size(), cooked.regions);
 
         createImageView();
         createSampler();
-
-        stbi_image_free(data);
     }
 
     Texture::~Texture() {
-        vkDestroySampler(m_device.device(), m_sampler, nullptr);
-        vkDestroyImageView(m_device.device(), m_imageView, nullptr);
-        vkDestroyImage(m_device.device(), m_image, nullptr);
-        vkFreeMemory(m_device.device(), m_memory, nullptr);
+        m_device.deletionQueue().push([&device = m_device, sampler = m_sampler, imageView = m_imageView,
+                                       image = m_image, memory = m_memory]() mutable {
+            vkDestroySampler(device.device(), sampler, nullptr);
+            vkDestroyImageView(device.device(), imageView, nullptr);
+            vkDestroyImage(device.device(), image, nullptr);
+            device.freeMemory(memory);
+        });
     }
 
     void Texture::createImage() {
@@ -92,7 +123,7 @@ namespace engine {
         imageInfo.arrayLayers = 1;
         imageInfo.flags = 0;
 
-        m_device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_image, m_memory);
+        m_device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_image, m_memory, m_tag);
     }
 
     void Texture::createImageView() {
@@ -119,21 +150,16 @@ namespace engine {
         VkSamplerCreateInfo samplerInfo{};
         samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
         samplerInfo.magFilter = VK_FILTER_NEAREST; // VK_FILTER_LINEAR
-        samplerInfo.minFilter = VK_FILTER_NEAREST; // VK_FILTER_LINEAR
+        samplerInfo.minFilter = m_mipLevels > 1 ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
         samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
         samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
         samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-        samplerInfo.anisotropyEnable = VK_TRUE;
-        samplerInfo.maxAnisotropy = m_device.properties.limits.maxSamplerAnisotropy;
         samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
         samplerInfo.unnormalizedCoordinates = VK_FALSE;
         samplerInfo.compareEnable = VK_FALSE;
         samplerInfo.compareOp = VK_COMPARE_OP_NEVER; // VK_COMPARE_OP_ALLWAYS
         samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-        samplerInfo.mipLodBias = 0.0f;
-        samplerInfo.minLod = 0.0f;
-        samplerInfo.maxLod = 0.0f;
-        samplerInfo.maxAnisotropy = 4.0f;
+        m_samplerSettings.apply(samplerInfo, m_device.properties.limits, m_mipLevels);
 
         if (vkCreateSampler(m_device.device(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
             throw std::runtime_error("failed to create texture sampler!");
@@ -150,7 +176,7 @@ namespace engine {
         barrier.image = m_image;
         barrier.subresourceRange.aspectMask = m_aspect;
         barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.levelCount = m_mipLevels;
         barrier.subresourceRange.baseArrayLayer = 0;
         barrier.subresourceRange.layerCount = 1;
 
@@ -225,92 +251,6 @@ namespace engine {
         transitionImageLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     }
 
-    void Texture::generateMipmaps() {
-        VkFormatProperties formatProperties;
-        vkGetPhysicalDeviceFormatProperties(m_device.physicalDevice(), m_format, &formatProperties);
-
-        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-            throw std::runtime_error("texture image format does not support linear blitting!");
-        }
-
-        VkCommandBuffer commandBuffer = m_device.beginSingleTimeCommands();
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.image = m_image;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.subresourceRange.levelCount = 1;
-
-        int32_t mipWidth = m_extent.width;
-        int32_t mipHeight = m_extent.height;
-
-        for (uint32_t i = 1; i < m_mipLevels; i++) {
-            barrier.subresourceRange.baseMipLevel = i - 1;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-            vkCmdPipelineBarrier(commandBuffer,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-                                 0, nullptr,
-                                 0, nullptr,
-                                 1, &barrier);
-
-            VkImageBlit blit{};
-            blit.srcOffsets[0] = {0, 0, 0};
-            blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
-            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.srcSubresource.mipLevel = i - 1;
-            blit.srcSubresource.baseArrayLayer = 0;
-            blit.srcSubresource.layerCount = 1;
-            blit.dstOffsets[0] = {0, 0, 0};
-            blit.dstOffsets[1] = {mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1};
-            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.dstSubresource.mipLevel = i;
-            blit.dstSubresource.baseArrayLayer = 0;
-            blit.dstSubresource.layerCount = 1;
-
-            vkCmdBlitImage(commandBuffer,
-                           m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                           m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           1, &blit,
-                           VK_FILTER_LINEAR);
-
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            vkCmdPipelineBarrier(commandBuffer,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-                                 0, nullptr,
-                                 0, nullptr,
-                                 1, &barrier);
-
-            if (mipWidth > 1) mipWidth /= 2;
-            if (mipHeight > 1) mipHeight /= 2;
-        }
-
-        barrier.subresourceRange.baseMipLevel = m_mipLevels - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer,
-                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-                             0, nullptr,
-                             0, nullptr,
-                             1, &barrier);
-
-        m_device.endSingleTimeCommands(commandBuffer);
-    }
-
     void Texture::writeDescriptorSets(DescriptorPool &descriptorPool, DescriptorSetLayout &descriptorSetLayout) {
 //        VkDescriptorImageInfo imageInfo{};
 //        imageInfo.sampler = m_sampler;
@@ -8,9 +8,19 @@
 
 namespace engine {
 
+    // Filtering for sampled textures. Anisotropy is clamped to the device limit,
+    // a value of 1 or less disables it.
+    struct SamplerSettings {
+        float maxAnisotropy = 8.0f;
+        float mipLodBias = 0.0f;
+
+        // fills the anisotropy and LOD fields of info for an image with mipLevels levels
+        void apply(VkSamplerCreateInfo &info, const VkPhysicalDeviceLimits &limits, uint32_t mipLevels) const;
+    };
+
     class Texture {
         VkImage m_image{VK_NULL_HANDLE};
-        VkDeviceMemory m_memory{VK_NULL_HANDLE};
+        Allocation m_memory{};
         VkImageView m_imageView{VK_NULL_HANDLE};
         VkSampler m_sampler{VK_NULL_HANDLE};
 
@@ -18,15 +28,19 @@ namespace engine {
         VkFormat m_format;
         VkImageUsageFlags m_usage;
         VkImageAspectFlags m_aspect{VK_IMAGE_ASPECT_COLOR_BIT};
+        // textures loaded from files are counted as material textures
+        MemoryTag m_tag{MemoryTag::Textures};
         uint32_t m_mipLevels{1};
+        SamplerSettings m_samplerSettings;
 
         Device &m_device;
 
 
 
     public:
-        Texture(Device &device, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect);
-        Texture(Device &device, const std::string &filepath);
+        Texture(Device &device, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+                MemoryTag tag);
+        Texture(Device &device, const std::string &filepath, const SamplerSettings &samplerSettings = {});
         ~Texture();
 
         Texture(const Texture&) = delete;
@@ -37,6 +51,7 @@ namespace engine {
         [[nodiscard]] VkSampler sampler() const { return m_sampler; }
         [[nodiscard]] VkExtent2D extent() const { return m_extent; }
         [[nodiscard]] VkFormat format() const { return m_format; }
+        [[nodiscard]] uint32_t mipLevels() const { return m_mipLevels; }
 
         void transitionImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout);
         void copyFromBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer);
@@ -45,10 +60,11 @@ namespace engine {
         void writeDescriptorSets(DescriptorPool &, DescriptorSetLayout &);
 
     private:
+        // block compressed levels written by cookTexture, uploaded without decoding
+        void loadCooked(const std::string &filepath);
         void createImage();
         void createImageView();
         void createSampler();
-        void generateMipmaps();
 
     };
 
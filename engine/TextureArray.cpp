@@ -1,81 +1,212 @@
 #include "TextureArray.h"
-#include "Buffer.h"
+#include "MipChain.h"
+#include "TextureCooker.h"
 #include "descriptors/DescriptorWriter.h"
 #include "stb/stb_image.h"
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
 namespace engine {
 
-TextureArray::TextureArray(Device& device, const std::vector<std::string>& filepaths)
-    : m_device(device), m_layerCount(static_cast<uint32_t>(filepaths.size())) {
-  loadImages(filepaths);
-  createImage();
+namespace {
+// bilinear RGBA8 resize so that every layer covers the full uv range of the array
+void resizeLayer(const stbi_uc* src, VkExtent2D srcExtent, stbi_uc* dst, VkExtent2D dstExtent) {
+  float scaleX = static_cast<float>(srcExtent.width) / static_cast<float>(dstExtent.width);
+  float scaleY = static_cast<float>(srcExtent.height) / static_cast<float>(dstExtent.height);
+
+  for (uint32_t y = 0; y < dstExtent.height; y++) {
+    float srcY = std::max((static_cast<float>(y) + 0.5f) * scaleY - 0.5f, 0.0f);
+    uint32_t y0 = std::min(static_cast<uint32_t>(srcY), srcExtent.height - 1);
+    uint32_t y1 = std::min(y0 + 1, srcExtent.height - 1);
+    float fy = srcY - static_cast<float>(y0);
+
+    for (uint32_t x = 0; x < dstExtent.width; x++) {
+      float srcX = std::max((static_cast<float>(x) + 0.5f) * scaleX - 0.5f, 0.0f);
+      uint32_t x0 = std::min(static_cast<uint32_t>(srcX), srcExtent.width - 1);
+      uint32_t x1 = std::min(x0 + 1, srcExtent.width - 1);
+      float fx = srcX - static_cast<float>(x0);
+
+      for (uint32_t c = 0; c < 4; c++) {
+        float top = src[(y0 * srcExtent.width + x0) * 4 + c] * (1.0f - fx) + src[(y0 * srcExtent.width + x1) * 4 + c] * fx;
+        float bottom = src[(y1 * srcExtent.width + x0) * 4 + c] * (1.0f - fx) + src[(y1 * srcExtent.width + x1) * 4 + c] * fx;
+        dst[(y * dstExtent.width + x) * 4 + c] = static_cast<stbi_uc>(top * (1.0f - fy) + bottom * fy + 0.5f);
+      }
+    }
+  }
+}
+} // namespace
+
+TextureImage TextureImage::load(const std::string& filepath) {
+  if (isCookedTexture(filepath)) {
+    CookedTexture cooked = loadCookedTexture(filepath);
+    TextureImage image{filepath, cooked.format, cooked.extent, cooked.levelCount, std::move(cooked.data),
+                       std::move(cooked.regions)};
+    image.hostMemory = HostMemory(MemoryTag::Textures, image.data.size());
+    return image;
+  }
+
+  int width, height, channels;
+  stbi_uc* pixels = stbi_load(filepath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+  if (!pixels) {
+    throw std::runtime_error("Failed to load texture image: " + filepath);
+  }
+
+  TextureImage image{};
+  image.filepath = filepath;
+  image.extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+  image.data.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+  stbi_image_free(pixels);
+  image.hostMemory = HostMemory(MemoryTag::Textures, image.data.size());
+  return image;
+}
+
+TextureArray::TextureArray(Device& device, const std::vector<std::shared_ptr<const TextureImage>>& images,
+                           const SamplerSettings& samplerSettings)
+    : m_device(device), m_layerCount(static_cast<uint32_t>(images.size())), m_samplerSettings(samplerSettings) {
+  std::vector<const TextureImage*> layers;
+  layers.reserve(images.size());
+  for (const auto& image : images) {
+    layers.push_back(image.get());
+  }
+  uploadImages(layers);
   createImageView();
   createSampler();
-  transitionLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-//  m_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 }
 
 TextureArray::~TextureArray() {
-  vkDestroySampler(m_device.device(), m_sampler, nullptr);
-  vkDestroyImageView(m_device.device(), m_imageView, nullptr);
-  vkDestroyImage(m_device.device(), m_image, nullptr);
-  vkFreeMemory(m_device.device(), m_memory, nullptr);
+  m_device.deletionQueue().push([&device = m_device, sampler = m_sampler, imageView = m_imageView,
+                                 image = m_image, memory = m_memory]() mutable {
+    vkDestroySampler(device.device(), sampler, nullptr);
+    vkDestroyImageView(device.device(), imageView, nullptr);
+    vkDestroyImage(device.device(), image, nullptr);
+    device.freeMemory(memory);
+  });
 }
 
-void TextureArray::loadImages(const std::vector<std::string>& filepaths) {
+void TextureArray::uploadImages(const std::vector<const TextureImage*>& images) {
+  if (images.empty()) {
+    throw std::runtime_error("Texture array needs at least one layer");
+  }
+
+  bool cooked = images.front()->cooked();
+  for (const auto* image : images) {
+    if (image->cooked() != cooked) {
+      throw std::runtime_error("Texture array cannot mix cooked and uncooked layers: " + image->filepath);
+    }
+  }
+
+  if (cooked) {
+    uploadCooked(images);
+  } else {
+    uploadPixels(images);
+  }
+}
+
+void TextureArray::uploadPixels(const std::vector<const TextureImage*>& images) {
   m_maxExtent = {0, 0};
-  VkDeviceSize totalSize = 0;
+  for (const auto* image : images) {
+    m_maxExtent.width = std::max(m_maxExtent.width, image->extent.width);
+    m_maxExtent.height = std::max(m_maxExtent.height, image->extent.height);
+  }
+
+  // every layer is stored at the largest extent, smaller images are scaled up
+  VkDeviceSize layerSize = static_cast<VkDeviceSize>(m_maxExtent.width) * m_maxExtent.height * 4;
+  VkDeviceSize totalSize = layerSize * m_layerCount;
+
+  m_format = VK_FORMAT_R8G8B8A8_SRGB;
+  m_usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  m_mipLevels = mipLevelCount(m_maxExtent);
 
-  for (const auto& filepath : filepaths) {
-    int width, height, channels;
-    stbi_uc* pixels = stbi_load(filepath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+  for (uint32_t i = 0; i < m_layerCount; i++) {
+    m_textureInfos.push_back({images[i]->filepath, images[i]->extent, layerSize * i});
+  }
+
+  createImage();
 
-    if (!pixels) {
-      throw std::runtime_error("Failed to load texture image: " + filepath);
+  // layers are copied or scaled straight into staging, without linear blits the
+  // mips are built on the cpu from a regular copy of the base level instead
+  bool gpuMips = supportsLinearBlit(m_device.physicalDevice(), m_format);
+  StagingReservation staging = gpuMips ? m_device.uploads().reserve(totalSize) : StagingReservation{};
+  std::vector<uint8_t> pixelData(gpuMips ? 0 : totalSize);
+  auto* base = gpuMips ? static_cast<uint8_t*>(staging.data()) : pixelData.data();
+
+  for (uint32_t i = 0; i < m_layerCount; i++) {
+    const TextureImage& image = *images[i];
+    uint8_t* dst = base + m_textureInfos[i].offset;
+    if (image.extent.width == m_maxExtent.width && image.extent.height == m_maxExtent.height) {
+      std::memcpy(dst, image.data.data(), layerSize);
+    } else {
+      resizeLayer(image.data.data(), image.extent, dst, m_maxExtent);
     }
+  }
 
-    VkExtent2D extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
-    m_maxExtent.width = std::max(m_maxExtent.width, extent.width);
-    m_maxExtent.height = std::max(m_maxExtent.height, extent.height);
+  VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, m_mipLevels, 0, m_layerCount};
+  if (!gpuMips) {
+    std::vector<VkBufferImageCopy> regions;
+    std::vector<uint8_t> chain = buildMipChain(pixelData.data(), m_maxExtent, m_layerCount, m_mipLevels, true, regions);
+    m_device.uploads().uploadImage(m_image, range, chain.data(), chain.size(), regions);
+    m_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    return;
+  }
 
-    VkDeviceSize imageSize = extent.width * extent.height * 4;
-    m_textureInfos.push_back({filepath, extent, totalSize});
-    totalSize += imageSize;
+  // one copy covers every layer of the base level
+  VkBufferImageCopy region{};
+  region.bufferOffset = 0;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = m_layerCount;
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = {m_maxExtent.width, m_maxExtent.height, 1};
+
+  m_device.uploads().uploadImage(m_image, range, std::move(staging), {region}, m_maxExtent, true);
+  m_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
 
-    stbi_image_free(pixels);
+void TextureArray::uploadCooked(const std::vector<const TextureImage*>& images) {
+  const TextureImage& first = *images.front();
+  for (const auto* image : images) {
+    // block data cannot be rescaled, every layer has to be cooked at the same size
+    if (image->format != first.format || image->extent.width != first.extent.width ||
+        image->extent.height != first.extent.height || image->levelCount != first.levelCount) {
+      throw std::runtime_error("Cooked texture does not match the array layout: " + image->filepath);
+    }
   }
 
-  m_format = VK_FORMAT_R8G8B8A8_SRGB;
+  m_maxExtent = first.extent;
+  m_format = first.format;
+  m_mipLevels = first.levelCount;
   m_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
-  Buffer stagingBuffer{
-      m_device,
-      4,
-      static_cast<uint32_t>(totalSize),
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-  };
-
-  stagingBuffer.map();
-  for (const auto& info : m_textureInfos) {
-    int width, height, channels;
-    stbi_uc* pixels = stbi_load(info.filepath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = info.extent.width * info.extent.height * 4;
-    stagingBuffer.writeToBuffer(pixels, imageSize, info.offset);
-    stbi_image_free(pixels);
+  VkDeviceSize totalSize = 0;
+  for (const auto* image : images) {
+    totalSize += image->data.size();
   }
 
   createImage();
 
-  transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-  copyBufferToImage(stagingBuffer.getBuffer());
+  StagingReservation staging = m_device.uploads().reserve(totalSize);
+  auto* base = static_cast<uint8_t*>(staging.data());
+  std::vector<VkBufferImageCopy> regions;
+  VkDeviceSize offset = 0;
+  for (uint32_t i = 0; i < m_layerCount; i++) {
+    const TextureImage& image = *images[i];
+    std::memcpy(base + offset, image.data.data(), image.data.size());
+    for (VkBufferImageCopy region : image.regions) {
+      region.bufferOffset += offset;
+      region.imageSubresource.baseArrayLayer = i;
+      regions.push_back(region);
+    }
+    m_textureInfos.push_back({image.filepath, image.extent, offset});
+    offset += image.data.size();
+  }
 
-  transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, m_mipLevels, 0, m_layerCount};
+  m_device.uploads().uploadImage(m_image, range, std::move(staging), regions);
+  m_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 }
 
 void TextureArray::createImage() {
@@ -85,7 +216,7 @@ void TextureArray::createImage() {
   imageInfo.extent.width = m_maxExtent.width;
   imageInfo.extent.height = m_maxExtent.height;
   imageInfo.extent.depth = 1;
-  imageInfo.mipLevels = 1;
+  imageInfo.mipLevels = m_mipLevels;
   imageInfo.arrayLayers = m_layerCount;
   imageInfo.format = m_format;
   imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -94,7 +225,8 @@ void TextureArray::createImage() {
   imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
   imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-  m_device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_image, m_memory);
+  m_device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_image, m_memory,
+                               MemoryTag::Textures);
 }
 
 void TextureArray::createImageView() {
@@ -105,7 +237,7 @@ void TextureArray::createImageView() {
   viewInfo.format = m_format;
   viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   viewInfo.subresourceRange.baseMipLevel = 0;
-  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.levelCount = m_mipLevels;
   viewInfo.subresourceRange.baseArrayLayer = 0;
   viewInfo.subresourceRange.layerCount = m_layerCount;
 
@@ -122,13 +254,12 @@ void TextureArray::createSampler() {
   samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
   samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
   samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-  samplerInfo.anisotropyEnable = VK_TRUE;
-  samplerInfo.maxAnisotropy = m_device.properties.limits.maxSamplerAnisotropy;
   samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
   samplerInfo.unnormalizedCoordinates = VK_FALSE;
   samplerInfo.compareEnable = VK_FALSE;
   samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
   samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  m_samplerSettings.apply(samplerInfo, m_device.properties.limits, m_mipLevels);
 
   if (vkCreateSampler(m_device.device(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
     throw std::runtime_error("failed to create texture sampler!");
@@ -147,7 +278,7 @@ void TextureArray::transitionImageLayout(VkImageLayout oldLayout, VkImageLayout
   barrier.image = m_image;
   barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   barrier.subresourceRange.baseMipLevel = 0;
-  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.levelCount = m_mipLevels;
   barrier.subresourceRange.baseArrayLayer = 0;
   barrier.subresourceRange.layerCount = m_layerCount;
 
@@ -184,31 +315,6 @@ void TextureArray::transitionImageLayout(VkImageLayout oldLayout, VkImageLayout
   std::cout << "Transitioning image layout from " << oldLayout << " to " << newLayout << std::endl;
 }
 
-void TextureArray::copyBufferToImage(VkBuffer buffer) {
-  VkCommandBuffer commandBuffer = m_device.beginSingleTimeCommands();
-
-  std::vector<VkBufferImageCopy> regions;
-  for (uint32_t i = 0; i < m_layerCount; i++) {
-    const auto& info = m_textureInfos[i];
-    VkBufferImageCopy region{};
-    region.bufferOffset = info.offset;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = i;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {info.extent.width, info.extent.height, 1};
-    regions.push_back(region);
-  }
-
-  vkCmdCopyBufferToImage(commandBuffer, buffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                         static_cast<uint32_t>(regions.size()), regions.data());
-
-  m_device.endSingleTimeCommands(commandBuffer);
-}
-
 void TextureArray::writeDescriptorSets(DescriptorPool& descriptorPool, DescriptorSetLayout& descriptorSetLayout) {
   VkDescriptorImageInfo imageInfo{};
   imageInfo.imageLayout = m_layout;
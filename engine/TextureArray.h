@@ -1,10 +1,12 @@
 #pragma once
 
 #include "Device.h"
+#include "Texture.h"
 #include "descriptors/DescriptorPool.h"
 #include "descriptors/DescriptorSetLayout.h"
 
 #include <vulkan/vulkan.h>
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -12,15 +14,35 @@ namespace engine {
 
 struct TextureInfo {
   std::string filepath;
+  // size of the source image, layers are stored at the array's extent
   VkExtent2D extent;
   VkDeviceSize offset;
 };
 
+// A decoded layer source, either RGBA8 pixels of the base level or all block
+// compressed levels of a cooked texture.
+struct TextureImage {
+  std::string filepath;
+  VkFormat format{VK_FORMAT_R8G8B8A8_SRGB};
+  VkExtent2D extent{0, 0};
+  uint32_t levelCount{1};
+  std::vector<uint8_t> data;
+  // level copies of cooked data, empty for RGBA8 images whose mips are generated
+  std::vector<VkBufferImageCopy> regions;
+  // the pixels stay in memory while the resource manager keeps the image
+  HostMemory hostMemory;
+
+  // decodes an image file, or reads the levels of a .ctex
+  static TextureImage load(const std::string& filepath);
+
+  [[nodiscard]] bool cooked() const { return !regions.empty(); }
+};
+
 class TextureArray {
 private:
   Device& m_device;
   VkImage m_image{VK_NULL_HANDLE};
-  VkDeviceMemory m_memory{VK_NULL_HANDLE};
+  Allocation m_memory{};
   VkImageView m_imageView{VK_NULL_HANDLE};
   VkSampler m_sampler{VK_NULL_HANDLE};
   VkImageLayout m_layout;
@@ -30,12 +52,15 @@ private:
   VkImageUsageFlags m_usage;
   uint32_t m_layerCount;
   uint32_t m_mipLevels{1};
+  SamplerSettings m_samplerSettings;
 
   VkDescriptorSet m_descriptorSet{VK_NULL_HANDLE};
   std::vector<TextureInfo> m_textureInfos;
 
 public:
-  TextureArray(Device& device, const std::vector<std::string>& filepaths);
+  // layers decoded up front, e.g. on a loader thread
+  TextureArray(Device& device, const std::vector<std::shared_ptr<const TextureImage>>& images,
+               const SamplerSettings& samplerSettings = {});
   ~TextureArray();
 
   TextureArray(const TextureArray&) = delete;
@@ -47,6 +72,7 @@ public:
   [[nodiscard]] VkExtent2D maxExtent() const { return m_maxExtent; }
   [[nodiscard]] VkFormat format() const { return m_format; }
   [[nodiscard]] uint32_t layerCount() const { return m_layerCount; }
+  [[nodiscard]] uint32_t mipLevels() const { return m_mipLevels; }
   [[nodiscard]] const std::vector<TextureInfo>& textureInfos() const { return m_textureInfos; }
   [[nodiscard]] VkDescriptorSet descriptorSet() const { return m_descriptorSet; }
 
@@ -54,12 +80,14 @@ public:
   void transitionLayout(VkImageLayout newLayout);
 
 private:
-  void loadImages(const std::vector<std::string>& filepaths);
+  void uploadImages(const std::vector<const TextureImage*>& images);
+  void uploadPixels(const std::vector<const TextureImage*>& images);
+  // all layers cooked with the same codec, extent and level count
+  void uploadCooked(const std::vector<const TextureImage*>& images);
   void createImage();
   void createImageView();
   void createSampler();
   void transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout);
-  void copyBufferToImage(VkBuffer buffer);
 };
 
 } // namespace engine
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "TextureCooker.h"
+#include "MipChain.h"
+#include "stb/stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace engine {
+
+    namespace {
+        constexpr uint64_t LEVEL_ALIGNMENT = 16;
+
+        uint64_t alignLevel(uint64_t offset) {
+            return (offset + LEVEL_ALIGNMENT - 1) & ~(LEVEL_ALIGNMENT - 1);
+        }
+    } // namespace
+
+    std::string cookedTexturePath(const std::string &sourcePath) {
+        return std::filesystem::path(sourcePath).replace_extension(".ctex").string();
+    }
+
+    bool isCookedTexture(const std::string &path) {
+        return std::filesystem::path(path).extension() == ".ctex";
+    }
+
+    bool hasCookedTexture(const std::string &sourcePath) {
+        std::error_code error;
+        std::filesystem::path cooked = cookedTexturePath(sourcePath);
+        if (!std::filesystem::exists(cooked, error)) {
+            return false;
+        }
+        return std::filesystem::last_write_time(cooked, error) >= std::filesystem::last_write_time(sourcePath, error);
+    }
+
+    void cookTexture(const std::string &sourcePath, TextureCodec codec) {
+        int width, height, channels;
+        stbi_uc *pixels = stbi_load(sourcePath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (!pixels) {
+            throw std::runtime_error("failed to load image: " + sourcePath);
+        }
+
+        VkExtent2D extent{static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+        uint32_t levelCount = mipLevelCount(extent);
+        std::vector<VkBufferImageCopy> mipRegions;
+        std::vector<uint8_t> mips = buildMipChain(pixels, extent, 1, levelCount, true, mipRegions);
+        stbi_image_free(pixels);
+
+        CookedTextureHeader header{};
+        std::memcpy(header.identifier, CookedTextureHeader::IDENTIFIER, sizeof(header.identifier));
+        header.vkFormat = codecFormat(codec, true);
+        header.pixelWidth = extent.width;
+        header.pixelHeight = extent.height;
+        header.layerCount = 1;
+        header.levelCount = levelCount;
+
+        std::vector<std::vector<uint8_t>> levels;
+        std::vector<CookedLevelIndex> levelIndex(levelCount);
+        uint64_t offset = alignLevel(sizeof(CookedTextureHeader) + sizeof(CookedLevelIndex) * levelCount);
+        for (uint32_t level = 0; level < levelCount; level++) {
+            const VkBufferImageCopy &region = mipRegions[level];
+            levels.push_back(compressImage(codec, mips.data() + region.bufferOffset,
+                                           region.imageExtent.width, region.imageExtent.height));
+            levelIndex[level] = {offset, levels.back().size()};
+            offset = alignLevel(offset + levels.back().size());
+        }
+
+        std::string cookedPath = cookedTexturePath(sourcePath);
+        std::ofstream file{cookedPath, std::ios::binary | std::ios::trunc};
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file: " + cookedPath);
+        }
+
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(levelIndex.data()),
+                   static_cast<std::streamsize>(sizeof(CookedLevelIndex) * levelIndex.size()));
+        for (uint32_t level = 0; level < levelCount; level++) {
+            file.seekp(static_cast<std::streamoff>(levelIndex[level].byteOffset));
+            file.write(reinterpret_cast<const char *>(levels[level].data()),
+                       static_cast<std::streamsize>(levels[level].size()));
+        }
+        if (!file) {
+            throw std::runtime_error("failed to write file: " + cookedPath);
+        }
+
+        std::cout << "cooked " << sourcePath << " -> " << cookedPath << " (" << offset / 1024 << " KiB, "
+                  << levelCount << " levels)" << std::endl;
+    }
+
+    CookedTexture loadCookedTexture(const std::string &path) {
+        std::ifstream file{path, std::ios::binary | std::ios::ate};
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file: " + path);
+        }
+
+        auto fileSize = static_cast<uint64_t>(file.tellg());
+        file.seekg(0);
+
+        CookedTextureHeader header{};
+        if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+            std::memcmp(header.identifier, CookedTextureHeader::IDENTIFIER, sizeof(header.identifier)) != 0) {
+            throw std::runtime_error("not a cooked texture: " + path);
+        }
+        if (header.layerCount != 1 || header.levelCount == 0 || header.levelCount > 32) {
+            throw std::runtime_error("unsupported cooked texture layout: " + path);
+        }
+
+        std::vector<CookedLevelIndex> levelIndex(header.levelCount);
+        file.read(reinterpret_cast<char *>(levelIndex.data()),
+                  static_cast<std::streamsize>(sizeof(CookedLevelIndex) * levelIndex.size()));
+
+        CookedTexture texture{};
+        texture.format = static_cast<VkFormat>(header.vkFormat);
+        texture.extent = {header.pixelWidth, header.pixelHeight};
+        texture.levelCount = header.levelCount;
+
+        uint64_t dataSize = 0;
+        for (const auto &level : levelIndex) {
+            if (level.byteOffset + level.byteLength > fileSize) {
+                throw std::runtime_error("truncated cooked texture: " + path);
+            }
+            dataSize = alignLevel(dataSize + level.byteLength);
+        }
+        texture.data.resize(dataSize);
+
+        uint64_t offset = 0;
+        for (uint32_t level = 0; level < header.levelCount; level++) {
+            file.seekg(static_cast<std::streamoff>(levelIndex[level].byteOffset));
+            file.read(reinterpret_cast<char *>(texture.data.data() + offset),
+                      static_cast<std::streamsize>(levelIndex[level].byteLength));
+
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = {std::max(header.pixelWidth >> level, 1u), std::max(header.pixelHeight >> level, 1u), 1};
+            texture.regions.push_back(region);
+
+            offset = alignLevel(offset + levelIndex[level].byteLength);
+        }
+
+        if (!file) {
+            throw std::runtime_error("failed to read file: " + path);
+        }
+        return texture;
+    }
+
+} // namespace engine
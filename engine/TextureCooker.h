@@ -0,0 +1,54 @@
+#pragma once
+
+#include "BlockCompression.h"
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+namespace engine {
+
+    // Container written by cookTexture, laid out after KTX2: an identifier, the
+    // vkFormat and extent, a level index and the level data, each level aligned
+    // to 16 bytes. There is no data format descriptor, the vkFormat is authoritative.
+    struct CookedTextureHeader {
+        static constexpr uint8_t IDENTIFIER[12] = {0xAB, 'C', 'T', 'E', 'X', ' ', '1', '0', 0xBB, '\r', '\n', 0x1A};
+
+        uint8_t identifier[12];
+        uint32_t vkFormat;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t layerCount;
+        uint32_t levelCount;
+    };
+
+    struct CookedLevelIndex {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+    };
+
+    struct CookedTexture {
+        VkFormat format{VK_FORMAT_UNDEFINED};
+        VkExtent2D extent{0, 0};
+        uint32_t levelCount{0};
+        std::vector<uint8_t> data;
+        // one copy per level, buffer offsets are relative to data
+        std::vector<VkBufferImageCopy> regions;
+    };
+
+    // sibling path the cooked version of a source texture is written to
+    std::string cookedTexturePath(const std::string &sourcePath);
+
+    bool isCookedTexture(const std::string &path);
+
+    // true if a cooked file exists for sourcePath and is not older than it
+    bool hasCookedTexture(const std::string &sourcePath);
+
+    // Decodes sourcePath, builds its mip chain and block compresses every level
+    // into cookedTexturePath(sourcePath). Throws std::runtime_error on failure.
+    void cookTexture(const std::string &sourcePath, TextureCodec codec);
+
+    CookedTexture loadCookedTexture(const std::string &path);
+
+} // namespace engine
@@ -0,0 +1,56 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+namespace engine {
+
+    ThreadPool::ThreadPool(uint32_t threadCount) {
+        if (threadCount == 0) {
+            threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+        }
+
+        m_workers.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; i++) {
+            m_workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_stopping = true;
+        }
+        m_condition.notify_all();
+
+        for (auto &worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::enqueue(std::function<void()> &&job) {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_jobs.push(std::move(job));
+        }
+        m_condition.notify_one();
+    }
+
+    void ThreadPool::workerLoop() {
+        Profiler::setThreadName("worker");
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock{m_mutex};
+                m_condition.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+                if (m_jobs.empty()) {
+                    return;
+                }
+                job = std::move(m_jobs.front());
+                m_jobs.pop();
+            }
+            job();
+        }
+    }
+
+} // namespace engine
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace engine {
+
+    // Fixed set of worker threads draining a FIFO of jobs. Pending jobs still run
+    // when the pool is destroyed, the destructor joins the workers afterwards.
+    class ThreadPool {
+    public:
+        // 0 picks hardware_concurrency() - 1, leaving a core to the render thread
+        explicit ThreadPool(uint32_t threadCount = 0);
+
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        template<typename F>
+        auto submit(F &&job) -> std::future<std::invoke_result_t<F>> {
+            using Result = std::invoke_result_t<F>;
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+            std::future<Result> future = task->get_future();
+            enqueue([task]() { (*task)(); });
+            return future;
+        }
+
+        // Runs job(i) for every i in [0, count) on the workers and the calling thread
+        // and returns once all of them are done. The caller works through the range
+        // as well, so queued jobs ahead of the helpers only cost parallelism. The
+        // first exception thrown by a job is rethrown.
+        template<typename Job>
+        void parallelFor(uint32_t count, Job &&job);
+
+        [[nodiscard]] uint32_t threadCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+    private:
+        void enqueue(std::function<void()> &&job);
+
+        void workerLoop();
+
+        std::vector<std::thread> m_workers;
+        std::queue<std::function<void()>> m_jobs;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        bool m_stopping{false};
+    };
+
+    template<typename Job>
+    void ThreadPool::parallelFor(uint32_t count, Job &&job) {
+        // shared with the helpers, one that starts after the range is done only
+        // reads next and never touches job
+        struct State {
+            std::atomic<uint32_t> next{0};
+            std::atomic<uint32_t> done{0};
+            std::exception_ptr error;
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+        auto state = std::make_shared<State>();
+
+        auto run = [state, count, &job]() {
+            for (uint32_t i = state->next++; i < count; i = state->next++) {
+                try {
+                    job(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock{state->mutex};
+                    if (!state->error) {
+                        state->error = std::current_exception();
+                    }
+                }
+                if (++state->done == count) {
+                    std::lock_guard<std::mutex> lock{state->mutex};
+                    state->finished.notify_all();
+                }
+            }
+        };
+
+        uint32_t helpers = std::min(threadCount(), count > 0 ? count - 1 : 0u);
+        for (uint32_t i = 0; i < helpers; i++) {
+            enqueue(run);
+        }
+        run();
+
+        std::unique_lock<std::mutex> lock{state->mutex};
+        state->finished.wait(lock, [&]() { return state->done == count; });
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+    // Runs job(i) for every i in [0, count) on short lived threads, the caller
+    // included. For bulk work inside one call rather than queued background jobs,
+    // work repeated every frame goes through a ThreadPool instead.
+    // The first exception thrown by a job is rethrown once all threads finished.
+    template<typename Job>
+    void parallelFor(uint32_t count, Job &&job) {
+        std::atomic<uint32_t> next{0};
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        auto worker = [&]() {
+            for (uint32_t i = next++; i < count; i = next++) {
+                try {
+                    job(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock{errorMutex};
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        };
+
+        uint32_t workerCount = std::max(1u, std::min(std::thread::hardware_concurrency(), count));
+        std::vector<std::thread> workers;
+        for (uint32_t i = 1; i < workerCount; i++) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto &thread : workers) {
+            thread.join();
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+} // namespace engine
@@ -0,0 +1,572 @@
+#include "UploadQueue.h"
+#include "Buffer.h"
+#include "Device.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace engine {
+
+    namespace {
+        constexpr VkDeviceSize BUFFER_ALIGNMENT = 16;
+
+        constexpr VkPipelineStageFlags CONSUMER_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                                                         VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+        constexpr VkAccessFlags CONSUMER_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                                  VK_ACCESS_INDEX_READ_BIT |
+                                                  VK_ACCESS_UNIFORM_READ_BIT |
+                                                  VK_ACCESS_SHADER_READ_BIT;
+
+        uint64_t alignUp(uint64_t value, uint64_t alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    StagingReservation::StagingReservation(StagingReservation &&other) noexcept
+        : m_queue{std::exchange(other.m_queue, nullptr)}, m_data{other.m_data}, m_size{other.m_size},
+          m_buffer{other.m_buffer}, m_offset{other.m_offset}, m_position{other.m_position},
+          m_dedicated{std::move(other.m_dedicated)} {}
+
+    StagingReservation::~StagingReservation() {
+        if (m_queue) {
+            m_queue->release(*this);
+        }
+    }
+
+    struct UploadQueue::Batch {
+        VkCommandBuffer transfer{VK_NULL_HANDLE};
+        // graphics side acquire, only used with a dedicated transfer queue
+        VkCommandBuffer acquire{VK_NULL_HANDLE};
+        VkSemaphore semaphore{VK_NULL_HANDLE};
+        VkFence fence{VK_NULL_HANDLE};
+
+        uint64_t stagingEnd{0};
+        uint32_t uploadCount{0};
+
+        // recorded after all copies, either the release half of the ownership
+        // transfer or the final barrier towards the shaders
+        std::vector<VkBufferMemoryBarrier> bufferBarriers;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+        // images whose lower levels are blitted once their base level arrived
+        std::vector<MipChain> mipChains;
+
+        // uploads that did not fit the staging ring
+        std::vector<std::unique_ptr<Buffer>> oversized;
+
+        std::promise<void> promise;
+        UploadFuture future;
+    };
+
+    UploadQueue::UploadQueue(Device &device) : m_device{device} {
+        QueueFamilyIndices indices = m_device.findPhysicalQueueFamilies();
+        m_graphicsFamily = indices.graphicsFamily;
+        m_transferFamily = indices.transferFamilyHasValue ? indices.transferFamily : indices.graphicsFamily;
+        m_transferQueue = indices.transferFamilyHasValue ? m_device.transferQueue() : m_device.graphicsQueue();
+
+        m_imageAlignment = std::max<VkDeviceSize>(BUFFER_ALIGNMENT,
+                                                  m_device.properties.limits.optimalBufferCopyOffsetAlignment);
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = m_transferFamily;
+        if (vkCreateCommandPool(m_device.device(), &poolInfo, nullptr, &m_transferPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload command pool!");
+        }
+
+        if (hasTransferQueue()) {
+            poolInfo.queueFamilyIndex = m_graphicsFamily;
+            if (vkCreateCommandPool(m_device.device(), &poolInfo, nullptr, &m_graphicsPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create upload acquire command pool!");
+            }
+        }
+
+        m_device.createBuffer(STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              m_staging, m_stagingMemory, MemoryTag::Staging);
+    }
+
+    UploadQueue::~UploadQueue() {
+        waitIdle();
+
+        if (m_open) {
+            m_free.push_back(std::move(m_open));
+        }
+        for (auto &batch : m_free) {
+            vkDestroyFence(m_device.device(), batch->fence, nullptr);
+            if (batch->semaphore != VK_NULL_HANDLE) {
+                vkDestroySemaphore(m_device.device(), batch->semaphore, nullptr);
+            }
+        }
+
+        vkDestroyCommandPool(m_device.device(), m_transferPool, nullptr);
+        if (m_graphicsPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(m_device.device(), m_graphicsPool, nullptr);
+        }
+
+        vkDestroyBuffer(m_device.device(), m_staging, nullptr);
+        m_device.freeMemory(m_stagingMemory);
+    }
+
+    UploadFuture UploadQueue::uploadBuffer(VkBuffer dst, const void *data, VkDeviceSize size, VkDeviceSize dstOffset) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+
+        VkBuffer src;
+        VkDeviceSize srcOffset = stage(data, size, BUFFER_ALIGNMENT, src);
+        Batch &batch = openBatch();
+
+        VkBufferCopy region{};
+        region.srcOffset = srcOffset;
+        region.dstOffset = dstOffset;
+        region.size = size;
+        vkCmdCopyBuffer(batch.transfer, src, dst, 1, &region);
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = hasTransferQueue() ? 0 : CONSUMER_ACCESS;
+        barrier.srcQueueFamilyIndex = hasTransferQueue() ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = hasTransferQueue() ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = dst;
+        barrier.offset = dstOffset;
+        barrier.size = size;
+        batch.bufferBarriers.push_back(barrier);
+
+        batch.uploadCount++;
+        return batch.future;
+    }
+
+    UploadFuture UploadQueue::uploadImage(VkImage image, const VkImageSubresourceRange &range, const void *data,
+                                          VkDeviceSize size, const std::vector<VkBufferImageCopy> &regions,
+                                          VkExtent2D extent, bool generateMips) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+
+        VkBuffer src;
+        VkDeviceSize srcOffset = stage(data, size, m_imageAlignment, src);
+        return recordImage(src, srcOffset, image, range, regions, extent, generateMips);
+    }
+
+    StagingReservation UploadQueue::reserve(VkDeviceSize size) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+
+        StagingReservation staging{};
+        staging.m_size = size;
+
+        uint64_t position;
+        if (allocate(size, m_imageAlignment, position)) {
+            m_reserved.push_back(position);
+            staging.m_queue = this;
+            staging.m_position = position;
+            staging.m_buffer = m_staging;
+            staging.m_offset = position % STAGING_SIZE;
+            staging.m_data = static_cast<char *>(m_stagingMemory.mapped) + staging.m_offset;
+            return staging;
+        }
+
+        staging.m_dedicated = std::make_unique<Buffer>(m_device, size, 1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                       MemoryTag::Staging);
+        staging.m_dedicated->map();
+        staging.m_buffer = staging.m_dedicated->getBuffer();
+        staging.m_data = staging.m_dedicated->getMappedMemory();
+        staging.m_queue = this;
+        return staging;
+    }
+
+    UploadFuture UploadQueue::uploadImage(VkImage image, const VkImageSubresourceRange &range,
+                                          StagingReservation &&staging, const std::vector<VkBufferImageCopy> &regions,
+                                          VkExtent2D extent, bool generateMips) {
+        if (staging.m_queue != this) {
+            throw std::logic_error("staging reservation does not belong to this upload queue!");
+        }
+
+        std::lock_guard<std::mutex> lock{m_mutex};
+
+        UploadFuture future = recordImage(staging.m_buffer, staging.m_offset, image, range, regions, extent,
+                                          generateMips);
+        if (staging.m_dedicated) {
+            openBatch().oversized.push_back(std::move(staging.m_dedicated));
+        } else {
+            // from here on the open batch keeps the range alive
+            m_reserved.erase(std::find(m_reserved.begin(), m_reserved.end(), staging.m_position));
+        }
+        staging.m_queue = nullptr;
+        return future;
+    }
+
+    UploadFuture UploadQueue::recordImage(VkBuffer src, VkDeviceSize srcOffset, VkImage image,
+                                          const VkImageSubresourceRange &range,
+                                          const std::vector<VkBufferImageCopy> &regions,
+                                          VkExtent2D extent, bool generateMips) {
+        Batch &batch = openBatch();
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = range;
+        vkCmdPipelineBarrier(batch.transfer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+
+        std::vector<VkBufferImageCopy> copies{regions};
+        for (auto &copy : copies) {
+            copy.bufferOffset += srcOffset;
+        }
+        vkCmdCopyBufferToImage(batch.transfer, src, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(copies.size()), copies.data());
+
+        generateMips = generateMips && range.levelCount > 1;
+        if (generateMips) {
+            batch.mipChains.push_back({image, range, extent});
+        }
+
+        // mip chains stay in TRANSFER_DST, the blits transition them level by level.
+        // On a shared queue there is nothing to hand over for them
+        if (!generateMips || hasTransferQueue()) {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = hasTransferQueue() ? 0 : VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = generateMips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+                                             : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcQueueFamilyIndex = hasTransferQueue() ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = hasTransferQueue() ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+            batch.imageBarriers.push_back(barrier);
+        }
+
+        batch.uploadCount++;
+        return batch.future;
+    }
+
+    void UploadQueue::flush() {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        submit();
+        retire(false);
+    }
+
+    void UploadQueue::poll() {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        retire(false);
+    }
+
+    void UploadQueue::wait(const UploadFuture &future) {
+        if (!future.valid()) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock{m_mutex};
+        // the future may belong to the open batch
+        submit();
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (m_inFlight.empty()) {
+                throw std::logic_error("waiting on an upload that was never submitted!");
+            }
+            retire(true);
+        }
+    }
+
+    void UploadQueue::waitIdle() {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        submit();
+        while (!m_inFlight.empty()) {
+            retire(true);
+        }
+    }
+
+    UploadQueue::Batch &UploadQueue::openBatch() {
+        if (m_open) {
+            return *m_open;
+        }
+
+        if (!m_free.empty()) {
+            m_open = std::move(m_free.back());
+            m_free.pop_back();
+        } else {
+            m_open = std::make_unique<Batch>();
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = m_transferPool;
+            allocInfo.commandBufferCount = 1;
+            vkAllocateCommandBuffers(m_device.device(), &allocInfo, &m_open->transfer);
+
+            VkFenceCreateInfo fenceInfo{};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            if (vkCreateFence(m_device.device(), &fenceInfo, nullptr, &m_open->fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create upload fence!");
+            }
+
+            if (hasTransferQueue()) {
+                allocInfo.commandPool = m_graphicsPool;
+                vkAllocateCommandBuffers(m_device.device(), &allocInfo, &m_open->acquire);
+
+                VkSemaphoreCreateInfo semaphoreInfo{};
+                semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+                if (vkCreateSemaphore(m_device.device(), &semaphoreInfo, nullptr, &m_open->semaphore) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create upload semaphore!");
+                }
+            }
+        }
+
+        Batch &batch = *m_open;
+        batch.uploadCount = 0;
+        batch.bufferBarriers.clear();
+        batch.imageBarriers.clear();
+        batch.mipChains.clear();
+        batch.promise = std::promise<void>{};
+        batch.future = batch.promise.get_future().share();
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(batch.transfer, &beginInfo);
+
+        return batch;
+    }
+
+    bool UploadQueue::allocate(VkDeviceSize size, VkDeviceSize alignment, uint64_t &position) {
+        if (size > STAGING_SIZE) {
+            return false;
+        }
+
+        while (true) {
+            uint64_t start = alignUp(m_head, alignment);
+            // ranges never wrap around the end of the ring
+            if (start % STAGING_SIZE + size > STAGING_SIZE) {
+                start = alignUp(start, STAGING_SIZE);
+            }
+
+            if (start + size - ringTail() <= STAGING_SIZE) {
+                m_head = start + size;
+                position = start;
+                return true;
+            }
+
+            // ring is full, push out what was recorded and recycle the oldest batch
+            submit();
+            if (m_inFlight.empty()) {
+                // an open reservation still owns part of the ring
+                if (!m_reserved.empty()) {
+                    return false;
+                }
+                m_head = m_tail = 0;
+                continue;
+            }
+            retire(true);
+        }
+    }
+
+    VkDeviceSize UploadQueue::stage(const void *data, VkDeviceSize size, VkDeviceSize alignment, VkBuffer &buffer) {
+        uint64_t position;
+        if (allocate(size, alignment, position)) {
+            std::memcpy(static_cast<char *>(m_stagingMemory.mapped) + position % STAGING_SIZE, data, size);
+            buffer = m_staging;
+            return position % STAGING_SIZE;
+        }
+
+        auto staging = std::make_unique<Buffer>(m_device, size, 1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                MemoryTag::Staging);
+        staging->map();
+        staging->writeToBuffer(const_cast<void *>(data), size);
+        buffer = staging->getBuffer();
+        openBatch().oversized.push_back(std::move(staging));
+        return 0;
+    }
+
+    void UploadQueue::release(StagingReservation &staging) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (!staging.m_dedicated) {
+            // the space itself is reclaimed once a later batch retires past it
+            m_reserved.erase(std::find(m_reserved.begin(), m_reserved.end(), staging.m_position));
+        }
+        staging.m_queue = nullptr;
+    }
+
+    uint64_t UploadQueue::ringTail() const {
+        uint64_t tail = m_tail;
+        for (uint64_t position : m_reserved) {
+            tail = std::min(tail, position);
+        }
+        return tail;
+    }
+
+    void UploadQueue::submit() {
+        if (!m_open || m_open->uploadCount == 0) {
+            return;
+        }
+
+        Batch &batch = *m_open;
+        batch.stagingEnd = m_head;
+
+        VkPipelineStageFlags dstStage = hasTransferQueue() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : CONSUMER_STAGES;
+        if (!batch.bufferBarriers.empty() || !batch.imageBarriers.empty()) {
+            vkCmdPipelineBarrier(batch.transfer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0,
+                                 0, nullptr,
+                                 static_cast<uint32_t>(batch.bufferBarriers.size()), batch.bufferBarriers.data(),
+                                 static_cast<uint32_t>(batch.imageBarriers.size()), batch.imageBarriers.data());
+        }
+        if (!hasTransferQueue()) {
+            for (const auto &chain : batch.mipChains) {
+                recordMipChain(batch.transfer, chain);
+            }
+        }
+        vkEndCommandBuffer(batch.transfer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.transfer;
+
+        std::lock_guard<std::mutex> queueLock{m_device.queueMutex()};
+
+        if (!hasTransferQueue()) {
+            if (vkQueueSubmit(m_transferQueue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit upload batch!");
+            }
+        } else {
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &batch.semaphore;
+            if (vkQueueSubmit(m_transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit upload batch!");
+            }
+
+            // acquire half of the ownership transfer, identical barriers with the
+            // access masks moved to the graphics side
+            for (auto &barrier : batch.bufferBarriers) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = CONSUMER_ACCESS;
+            }
+            for (auto &barrier : batch.imageBarriers) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = barrier.newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+                                        ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+                                        : VK_ACCESS_SHADER_READ_BIT;
+            }
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkBeginCommandBuffer(batch.acquire, &beginInfo);
+            vkCmdPipelineBarrier(batch.acquire, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 CONSUMER_STAGES | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                 0, nullptr,
+                                 static_cast<uint32_t>(batch.bufferBarriers.size()), batch.bufferBarriers.data(),
+                                 static_cast<uint32_t>(batch.imageBarriers.size()), batch.imageBarriers.data());
+            // blits need a graphics queue
+            for (const auto &chain : batch.mipChains) {
+                recordMipChain(batch.acquire, chain);
+            }
+            vkEndCommandBuffer(batch.acquire);
+
+            VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            VkSubmitInfo acquireInfo{};
+            acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            acquireInfo.waitSemaphoreCount = 1;
+            acquireInfo.pWaitSemaphores = &batch.semaphore;
+            acquireInfo.pWaitDstStageMask = &waitStage;
+            acquireInfo.commandBufferCount = 1;
+            acquireInfo.pCommandBuffers = &batch.acquire;
+            if (vkQueueSubmit(m_device.graphicsQueue(), 1, &acquireInfo, batch.fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit upload acquire!");
+            }
+        }
+
+        m_inFlight.push_back(std::move(m_open));
+    }
+
+    void UploadQueue::recordMipChain(VkCommandBuffer commandBuffer, const MipChain &chain) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.image = chain.image;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange = chain.range;
+        barrier.subresourceRange.levelCount = 1;
+
+        int32_t mipWidth = static_cast<int32_t>(chain.extent.width);
+        int32_t mipHeight = static_cast<int32_t>(chain.extent.height);
+        uint32_t lastLevel = chain.range.baseMipLevel + chain.range.levelCount - 1;
+
+        for (uint32_t level = chain.range.baseMipLevel + 1; level <= lastLevel; level++) {
+            barrier.subresourceRange.baseMipLevel = level - 1;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                 0, nullptr, 0, nullptr, 1, &barrier);
+
+            int32_t nextWidth = mipWidth > 1 ? mipWidth / 2 : 1;
+            int32_t nextHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+
+            VkImageBlit blit{};
+            blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+            blit.srcSubresource = {chain.range.aspectMask, level - 1, chain.range.baseArrayLayer,
+                                   chain.range.layerCount};
+            blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+            blit.dstSubresource = {chain.range.aspectMask, level, chain.range.baseArrayLayer,
+                                   chain.range.layerCount};
+            vkCmdBlitImage(commandBuffer,
+                           chain.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           chain.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           1, &blit, VK_FILTER_LINEAR);
+
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                                 0, nullptr, 0, nullptr, 1, &barrier);
+
+            mipWidth = nextWidth;
+            mipHeight = nextHeight;
+        }
+
+        barrier.subresourceRange.baseMipLevel = lastLevel;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    void UploadQueue::retire(bool block) {
+        while (!m_inFlight.empty()) {
+            Batch &batch = *m_inFlight.front();
+            if (block) {
+                vkWaitForFences(m_device.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+                block = false;
+            } else if (vkGetFenceStatus(m_device.device(), batch.fence) != VK_SUCCESS) {
+                break;
+            }
+
+            m_tail = batch.stagingEnd;
+            batch.oversized.clear();
+            batch.promise.set_value();
+            vkResetFences(m_device.device(), 1, &batch.fence);
+
+            m_free.push_back(std::move(m_inFlight.front()));
+            m_inFlight.pop_front();
+        }
+
+        // nothing staged is pending, restart at the beginning of the ring
+        if (m_inFlight.empty() && (!m_open || m_open->uploadCount == 0) && m_reserved.empty() && m_head == m_tail) {
+            m_head = m_tail = 0;
+        }
+    }
+
+} // namespace engine
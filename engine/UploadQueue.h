@@ -0,0 +1,159 @@
+#pragma once
+
+#include "MemoryAllocator.h"
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace engine {
+
+    class Buffer;
+    class Device;
+    class UploadQueue;
+
+    using UploadFuture = std::shared_future<void>;
+
+    // Staging memory handed out to be filled in place, e.g. by decoding straight into
+    // it from several threads. The range stays reserved until it is passed to
+    // UploadQueue::uploadImage, dropping it unused gives the space back.
+    class StagingReservation {
+    public:
+        StagingReservation() = default;
+
+        StagingReservation(StagingReservation &&other) noexcept;
+
+        StagingReservation &operator=(StagingReservation &&) = delete;
+
+        ~StagingReservation();
+
+        [[nodiscard]] void *data() const { return m_data; }
+
+        [[nodiscard]] VkDeviceSize size() const { return m_size; }
+
+    private:
+        friend class UploadQueue;
+
+        UploadQueue *m_queue{nullptr};
+        void *m_data{nullptr};
+        VkDeviceSize m_size{0};
+        VkBuffer m_buffer{VK_NULL_HANDLE};
+        VkDeviceSize m_offset{0};
+        // ring position pinning the range, unused for reservations too big for the ring
+        uint64_t m_position{0};
+        std::unique_ptr<Buffer> m_dedicated;
+    };
+
+    // Batches staging copies into as few queue submissions as possible. Source data
+    // is copied into a persistently mapped staging ring right away, the copy commands
+    // go into the open batch which is submitted by flush(). The renderer flushes right
+    // before every frame submit, so anything uploaded before a frame is recorded is
+    // visible to it without waiting on the CPU.
+    //
+    // When the device exposes a transfer only queue family the copies run there and
+    // ownership is released to the graphics family, which acquires it in a small
+    // submission ordered behind the copies with a semaphore.
+    class UploadQueue {
+    public:
+        static constexpr VkDeviceSize STAGING_SIZE = 32ull * 1024 * 1024;
+
+        explicit UploadQueue(Device &device);
+
+        ~UploadQueue();
+
+        UploadQueue(const UploadQueue &) = delete;
+
+        UploadQueue &operator=(const UploadQueue &) = delete;
+
+        UploadFuture uploadBuffer(VkBuffer dst, const void *data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+        // region buffer offsets are relative to data, the image is expected in
+        // VK_IMAGE_LAYOUT_UNDEFINED and ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+        // With generateMips the regions only fill the base level and the remaining
+        // levels of range are blitted on the graphics queue, the image format has
+        // to support linear filtering for that.
+        UploadFuture uploadImage(VkImage image, const VkImageSubresourceRange &range, const void *data,
+                                 VkDeviceSize size, const std::vector<VkBufferImageCopy> &regions,
+                                 VkExtent2D extent = {0, 0}, bool generateMips = false);
+
+        // maps size bytes of staging memory for the caller to write, thread safe
+        StagingReservation reserve(VkDeviceSize size);
+
+        // same as above with the source already written to a reservation, regions are relative to it
+        UploadFuture uploadImage(VkImage image, const VkImageSubresourceRange &range, StagingReservation &&staging,
+                                 const std::vector<VkBufferImageCopy> &regions,
+                                 VkExtent2D extent = {0, 0}, bool generateMips = false);
+
+        // submits the open batch, does nothing if no upload was recorded since the last flush
+        void flush();
+
+        // fulfils the futures of finished batches and recycles their staging space
+        void poll();
+
+        // blocks until the upload behind future has completed on the GPU
+        void wait(const UploadFuture &future);
+
+        void waitIdle();
+
+        [[nodiscard]] bool hasTransferQueue() const { return m_transferFamily != m_graphicsFamily; }
+
+    private:
+        friend class StagingReservation;
+
+        struct Batch;
+
+        struct MipChain {
+            VkImage image;
+            VkImageSubresourceRange range;
+            VkExtent2D extent;
+        };
+
+        static void recordMipChain(VkCommandBuffer commandBuffer, const MipChain &chain);
+
+        Batch &openBatch();
+
+        // claims ring space at position, false if it cannot fit even after draining the ring
+        bool allocate(VkDeviceSize size, VkDeviceSize alignment, uint64_t &position);
+
+        VkDeviceSize stage(const void *data, VkDeviceSize size, VkDeviceSize alignment, VkBuffer &buffer);
+
+        UploadFuture recordImage(VkBuffer src, VkDeviceSize srcOffset, VkImage image,
+                                 const VkImageSubresourceRange &range, const std::vector<VkBufferImageCopy> &regions,
+                                 VkExtent2D extent, bool generateMips);
+
+        void release(StagingReservation &staging);
+
+        // oldest ring position that may still be read, either by the GPU or by an open reservation
+        [[nodiscard]] uint64_t ringTail() const;
+
+        void submit();
+
+        void retire(bool block);
+
+        Device &m_device;
+        uint32_t m_graphicsFamily;
+        uint32_t m_transferFamily;
+        VkQueue m_transferQueue;
+        VkCommandPool m_transferPool{VK_NULL_HANDLE};
+        VkCommandPool m_graphicsPool{VK_NULL_HANDLE};
+        VkDeviceSize m_imageAlignment;
+
+        VkBuffer m_staging{VK_NULL_HANDLE};
+        Allocation m_stagingMemory{};
+        // monotonic ring positions, the staging offset is position % STAGING_SIZE
+        uint64_t m_head{0};
+        uint64_t m_tail{0};
+        // positions of reservations that were not uploaded yet
+        std::vector<uint64_t> m_reserved;
+
+        std::mutex m_mutex;
+        std::unique_ptr<Batch> m_open;
+        std::deque<std::unique_ptr<Batch>> m_inFlight;
+        std::vector<std::unique_ptr<Batch>> m_free;
+    };
+
+} // namespace engine
@@ -0,0 +1,48 @@
+#include "VertexQuantizer.h"
+
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace engine {
+
+    void encodeOctahedral(const glm::vec3 &normal, int16_t encoded[2]) {
+        float length = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+        glm::vec2 folded = length > 0.0f ? glm::vec2(normal) / length : glm::vec2(0.0f);
+        if (normal.z < 0.0f) {
+            glm::vec2 sign{folded.x >= 0.0f ? 1.0f : -1.0f, folded.y >= 0.0f ? 1.0f : -1.0f};
+            folded = (1.0f - glm::abs(glm::vec2(folded.y, folded.x))) * sign;
+        }
+        encoded[0] = static_cast<int16_t>(glm::packSnorm1x16(folded.x));
+        encoded[1] = static_cast<int16_t>(glm::packSnorm1x16(folded.y));
+    }
+
+    void compactVertices(const Model::Vertex *vertices, uint32_t vertexCount, const glm::vec3 &minExtent,
+                         const glm::vec3 &maxExtent, Model::CompactVertex *compact) {
+        // flat axes map to 0, the dequantization scales them back to nothing
+        glm::vec3 extent = maxExtent - minExtent;
+        glm::vec3 scale{extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+                        extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+                        extent.z > 0.0f ? 1.0f / extent.z : 0.0f};
+
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            const Model::Vertex &vertex = vertices[i];
+            Model::CompactVertex &out = compact[i];
+
+            glm::vec3 unit = (vertex.position - minExtent) * scale;
+            out.position[0] = glm::packUnorm1x16(unit.x);
+            out.position[1] = glm::packUnorm1x16(unit.y);
+            out.position[2] = glm::packUnorm1x16(unit.z);
+            out.position[3] = 0;
+
+            encodeOctahedral(vertex.normal, out.normal);
+
+            out.uv[0] = glm::packHalf1x16(vertex.uv.x);
+            out.uv[1] = glm::packHalf1x16(vertex.uv.y);
+        }
+    }
+
+    glm::mat4 dequantizeTransform(const glm::vec3 &minExtent, const glm::vec3 &maxExtent) {
+        return glm::scale(glm::translate(glm::mat4{1.0f}, minExtent), maxExtent - minExtent);
+    }
+
+} // namespace engine
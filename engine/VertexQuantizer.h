@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Model.h"
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace engine {
+
+    // Folds the unit sphere onto an octahedron and unfolds that into the square
+    // [-1, 1]^2, both coordinates stored as snorm16. mesh_compact.vert decodes it.
+    void encodeOctahedral(const glm::vec3 &normal, int16_t encoded[2]);
+
+    // Quantizes vertices into compact, positions relative to the box spanned by
+    // minExtent and maxExtent, which has to contain all of them.
+    void compactVertices(const Model::Vertex *vertices, uint32_t vertexCount, const glm::vec3 &minExtent,
+                         const glm::vec3 &maxExtent, Model::CompactVertex *compact);
+
+    // maps the unorm positions written by compactVertices back into the box
+    glm::mat4 dequantizeTransform(const glm::vec3 &minExtent, const glm::vec3 &maxExtent);
+
+} // namespace engine
@@ -1,6 +1,11 @@
 #include "MeshRenderSystem.h"
+#include "Meshlet.h"
 #include "Model.h"
+#include "Profiler.h"
 #include "Texture.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <stdexcept>
 
 namespace engine {
@@ -9,22 +14,30 @@ struct SimplePushConstantsData {
   glm::mat4 modelMatrix{1.0f};
   glm::mat4 normalMatrix{1.0f};
   uint32_t colorIndex{0};
+  uint32_t textureLayer{0};
 };
 
-MeshRenderSystem::MeshRenderSystem(Device &device, VkRenderPass renderPass, std::vector<VkDescriptorSetLayout> &&descriptorSetLayouts, const std::string &vertPath, const std::string &fragPath)
-    : m_device(device) {
+MeshRenderSystem::MeshRenderSystem(Device &device, PipelineRegistry &pipelineRegistry, VkRenderPass renderPass, std::vector<VkDescriptorSetLayout> &&descriptorSetLayouts, const std::string &vertPath, const std::string &compactVertPath, const std::string &fragPath)
+    : m_device(device), m_pipelineRegistry(pipelineRegistry) {
 
   CreatePipelineLayout(descriptorSetLayouts);
-  CreatePipeline(renderPass, vertPath, fragPath);
+  CreatePipelines(renderPass, vertPath, compactVertPath, fragPath);
 }
 
 MeshRenderSystem::~MeshRenderSystem() {
+  for (auto &pipeline : m_pipelines) {
+    pipeline.reset();
+  }
+  m_pipelineRegistry.evict(m_pipelineLayout);
   vkDestroyPipelineLayout(m_device.device(), m_pipelineLayout, nullptr);
 }
 
 
 void MeshRenderSystem::Render(FrameInfo &frameInfo) {
-  m_pipeline->bind(frameInfo.commandBuffer);
+  PROFILE_SCOPE("MeshRenderSystem::Render");
+  // the descriptor sets survive pipeline switches, both pipelines share the layout
+  Pipeline *bound = m_pipelines[0].get();
+  bound->bind(frameInfo.commandBuffer);
 
   vkCmdBindDescriptorSets(
       frameInfo.commandBuffer,
@@ -33,32 +46,44 @@ void MeshRenderSystem::Render(FrameInfo &frameInfo) {
       0,
       static_cast<uint32_t>(frameInfo.descriptorSets.size()),
       frameInfo.descriptorSets.data(),
+      static_cast<uint32_t>(frameInfo.dynamicOffsets.size()),
+      frameInfo.dynamicOffsets.data()
+  );
+
+  // all structure textures live in one array, bound once for the whole pass
+  VkDescriptorSet materialSet = frameInfo.resourceManager.getMaterialSet();
+  vkCmdBindDescriptorSets(
+      frameInfo.commandBuffer,
+      VK_PIPELINE_BIND_POINT_GRAPHICS,
+      m_pipelineLayout,
+      static_cast<uint32_t>(frameInfo.descriptorSets.size()),
+      1,
+      &materialSet,
       0,
       nullptr
   );
 
-  for (auto &structure : frameInfo.structures) {
+  for (size_t i = 0; i < frameInfo.structures.size(); i++) {
+    const auto &structure = frameInfo.structures[i];
     if (!structure) continue;
+    // structures placed after culling ran have no entry and are drawn
+    if (frameInfo.structureVisibility && i < frameInfo.structureVisibility->size() &&
+        !(*frameInfo.structureVisibility)[i]) continue;
 
-    VkDescriptorSet textureSet = frameInfo.resourceManager.getTexture(structure->type);
     std::shared_ptr<Model> model = frameInfo.resourceManager.getModel(structure->type);
+    if (!model) continue;
 
-
-    vkCmdBindDescriptorSets(
-        frameInfo.commandBuffer,
-        VK_PIPELINE_BIND_POINT_GRAPHICS,
-        m_pipelineLayout,
-        frameInfo.descriptorSets.size(),
-        1,
-        &textureSet,
-        0,
-        nullptr
-    );
+    Pipeline *pipeline = m_pipelines[static_cast<size_t>(model->GetVertexFormat())].get();
+    if (pipeline != bound) {
+      pipeline->bind(frameInfo.commandBuffer);
+      bound = pipeline;
+    }
 
     SimplePushConstantsData push{};
-    push.modelMatrix = structure->mat4();
-    push.normalMatrix = glm::identity<glm::mat4>();
+    push.modelMatrix = structure->mat4() * model->GetPositionTransform();
+    push.normalMatrix = structure->mat4();
     push.colorIndex = structure->color;
+    push.textureLayer = frameInfo.resourceManager.getTextureLayer(structure->type);
 
     vkCmdPushConstants(
         frameInfo.commandBuffer,
@@ -68,8 +93,11 @@ void MeshRenderSystem::Render(FrameInfo &frameInfo) {
         sizeof(SimplePushConstantsData),
         &push);
 
+    glm::mat4 modelMatrix = structure->mat4();
+    CullView view = makeCullView(frameInfo.viewProjection, modelMatrix, frameInfo.cameraPosition);
     model->Bind(frameInfo.commandBuffer);
-    model->Draw(frameInfo.commandBuffer);
+    model->Draw(frameInfo.commandBuffer, model->SelectLod(modelMatrix, frameInfo.cameraPosition, frameInfo.projectionScale),
+                &view);
   }
 
 }
@@ -92,87 +120,93 @@ void MeshRenderSystem::CreatePipelineLayout(std::vector<VkDescriptorSetLayout> &
   }
 }
 
-void MeshRenderSystem::CreatePipeline(VkRenderPass renderPass,
-                                      const std::string &vertPath,
-                                      const std::string &fragPath) {
+void MeshRenderSystem::CreatePipelines(VkRenderPass renderPass,
+                                       const std::string &vertPath,
+                                       const std::string &compactVertPath,
+                                       const std::string &fragPath) {
   assert(m_pipelineLayout != VK_NULL_HANDLE && "Cannot create pipeline before pipeline layout");
 
-  PipelineConfigInfo pipelineConfig{};
-  pipelineConfig.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  pipelineConfig.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;  // Changed to triangle list
-  pipelineConfig.inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
-
-  pipelineConfig.viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  pipelineConfig.viewportInfo.viewportCount = 1;
-  pipelineConfig.viewportInfo.pViewports = nullptr;
-  pipelineConfig.viewportInfo.scissorCount = 1;
-  pipelineConfig.viewportInfo.pScissors = nullptr;
-
-  pipelineConfig.rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  pipelineConfig.rasterizationInfo.depthClampEnable = VK_FALSE;
-  pipelineConfig.rasterizationInfo.rasterizerDiscardEnable = VK_FALSE;
-  pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
-  pipelineConfig.rasterizationInfo.lineWidth = 1.0f;
-  pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;  // Enable back-face culling
-  pipelineConfig.rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;  // Assuming counter-clockwise winding
-  pipelineConfig.rasterizationInfo.depthBiasEnable = VK_FALSE;
-  pipelineConfig.rasterizationInfo.depthBiasConstantFactor = 0.0f;
-  pipelineConfig.rasterizationInfo.depthBiasClamp = 0.0f;
-  pipelineConfig.rasterizationInfo.depthBiasSlopeFactor = 0.0f;
-
-  pipelineConfig.multisampleInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  pipelineConfig.multisampleInfo.sampleShadingEnable = VK_FALSE;
-  pipelineConfig.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-  pipelineConfig.multisampleInfo.minSampleShading = 1.0f;
-  pipelineConfig.multisampleInfo.pSampleMask = nullptr;
-  pipelineConfig.multisampleInfo.alphaToCoverageEnable = VK_FALSE;
-  pipelineConfig.multisampleInfo.alphaToOneEnable = VK_FALSE;
-
-  pipelineConfig.colorBlendAttachment.colorWriteMask =
-      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  pipelineConfig.colorBlendAttachment.blendEnable = VK_TRUE;
-  pipelineConfig.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-  pipelineConfig.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-  pipelineConfig.colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-  pipelineConfig.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-  pipelineConfig.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-  pipelineConfig.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-  pipelineConfig.colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  pipelineConfig.colorBlendInfo.logicOpEnable = VK_FALSE;
-  pipelineConfig.colorBlendInfo.logicOp = VK_LOGIC_OP_COPY;
-  pipelineConfig.colorBlendInfo.attachmentCount = 1;
-  pipelineConfig.colorBlendInfo.pAttachments = &pipelineConfig.colorBlendAttachment;
-  pipelineConfig.colorBlendInfo.blendConstants[0] = 0.0f;
-  pipelineConfig.colorBlendInfo.blendConstants[1] = 0.0f;
-  pipelineConfig.colorBlendInfo.blendConstants[2] = 0.0f;
-  pipelineConfig.colorBlendInfo.blendConstants[3] = 0.0f;
-
-  pipelineConfig.depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-  pipelineConfig.depthStencilInfo.depthTestEnable = VK_TRUE;  // Enable depth testing
-  pipelineConfig.depthStencilInfo.depthWriteEnable = VK_TRUE;  // Enable depth writing
-  pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS;
-  pipelineConfig.depthStencilInfo.depthBoundsTestEnable = VK_FALSE;
-  pipelineConfig.depthStencilInfo.minDepthBounds = 0.0f;
-  pipelineConfig.depthStencilInfo.maxDepthBounds = 1.0f;
-  pipelineConfig.depthStencilInfo.stencilTestEnable = VK_FALSE;
-  pipelineConfig.depthStencilInfo.front = {};
-  pipelineConfig.depthStencilInfo.back = {};
-
-  pipelineConfig.dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
-  pipelineConfig.dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  pipelineConfig.dynamicStateInfo.pDynamicStates = pipelineConfig.dynamicStateEnables.data();
-  pipelineConfig.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(pipelineConfig.dynamicStateEnables.size());
-  pipelineConfig.dynamicStateInfo.flags = 0;
-
-  pipelineConfig.bindingDescriptions = Model::Vertex::getBindingsDescriptions();
-  pipelineConfig.attributeDescriptions = Model::Vertex::getAttributeDescriptions();
-  pipelineConfig.renderPass = renderPass;
-  pipelineConfig.pipelineLayout = m_pipelineLayout;
-
-  pipelineConfig.vertPath = vertPath;
-  pipelineConfig.fragPath = fragPath;
-
-  m_pipeline = std::make_unique<Pipeline>(m_device, pipelineConfig);
+  // one config per vertex format, the registry compiles both concurrently
+  std::array<PipelineConfigInfo, 2> configs{};
+  for (auto format : {Model::VertexFormat::Full, Model::VertexFormat::Compact}) {
+    PipelineConfigInfo &pipelineConfig = configs[static_cast<size_t>(format)];
+    pipelineConfig.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    pipelineConfig.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;  // Changed to triangle list
+    pipelineConfig.inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+    pipelineConfig.viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    pipelineConfig.viewportInfo.viewportCount = 1;
+    pipelineConfig.viewportInfo.pViewports = nullptr;
+    pipelineConfig.viewportInfo.scissorCount = 1;
+    pipelineConfig.viewportInfo.pScissors = nullptr;
+
+    pipelineConfig.rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    pipelineConfig.rasterizationInfo.depthClampEnable = VK_FALSE;
+    pipelineConfig.rasterizationInfo.rasterizerDiscardEnable = VK_FALSE;
+    pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    pipelineConfig.rasterizationInfo.lineWidth = 1.0f;
+    pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;  // Enable back-face culling
+    pipelineConfig.rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;  // Assuming counter-clockwise winding
+    pipelineConfig.rasterizationInfo.depthBiasEnable = VK_FALSE;
+    pipelineConfig.rasterizationInfo.depthBiasConstantFactor = 0.0f;
+    pipelineConfig.rasterizationInfo.depthBiasClamp = 0.0f;
+    pipelineConfig.rasterizationInfo.depthBiasSlopeFactor = 0.0f;
+
+    pipelineConfig.multisampleInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    pipelineConfig.multisampleInfo.sampleShadingEnable = VK_FALSE;
+    pipelineConfig.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    pipelineConfig.multisampleInfo.minSampleShading = 1.0f;
+    pipelineConfig.multisampleInfo.pSampleMask = nullptr;
+    pipelineConfig.multisampleInfo.alphaToCoverageEnable = VK_FALSE;
+    pipelineConfig.multisampleInfo.alphaToOneEnable = VK_FALSE;
+
+    pipelineConfig.colorBlendAttachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    pipelineConfig.colorBlendAttachment.blendEnable = VK_TRUE;
+    pipelineConfig.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    pipelineConfig.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    pipelineConfig.colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    pipelineConfig.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    pipelineConfig.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    pipelineConfig.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    pipelineConfig.colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    pipelineConfig.colorBlendInfo.logicOpEnable = VK_FALSE;
+    pipelineConfig.colorBlendInfo.logicOp = VK_LOGIC_OP_COPY;
+    pipelineConfig.colorBlendInfo.attachmentCount = 1;
+    pipelineConfig.colorBlendInfo.pAttachments = &pipelineConfig.colorBlendAttachment;
+    pipelineConfig.colorBlendInfo.blendConstants[0] = 0.0f;
+    pipelineConfig.colorBlendInfo.blendConstants[1] = 0.0f;
+    pipelineConfig.colorBlendInfo.blendConstants[2] = 0.0f;
+    pipelineConfig.colorBlendInfo.blendConstants[3] = 0.0f;
+
+    pipelineConfig.depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    pipelineConfig.depthStencilInfo.depthTestEnable = VK_TRUE;  // Enable depth testing
+    pipelineConfig.depthStencilInfo.depthWriteEnable = VK_TRUE;  // Enable depth writing
+    pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+    pipelineConfig.depthStencilInfo.depthBoundsTestEnable = VK_FALSE;
+    pipelineConfig.depthStencilInfo.minDepthBounds = 0.0f;
+    pipelineConfig.depthStencilInfo.maxDepthBounds = 1.0f;
+    pipelineConfig.depthStencilInfo.stencilTestEnable = VK_FALSE;
+    pipelineConfig.depthStencilInfo.front = {};
+    pipelineConfig.depthStencilInfo.back = {};
+
+    pipelineConfig.dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    pipelineConfig.dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    pipelineConfig.dynamicStateInfo.pDynamicStates = pipelineConfig.dynamicStateEnables.data();
+    pipelineConfig.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(pipelineConfig.dynamicStateEnables.size());
+    pipelineConfig.dynamicStateInfo.flags = 0;
+
+    pipelineConfig.renderPass = renderPass;
+    pipelineConfig.pipelineLayout = m_pipelineLayout;
+    pipelineConfig.fragPath = fragPath;
+
+    pipelineConfig.bindingDescriptions = Model::getBindingsDescriptions(format);
+    pipelineConfig.attributeDescriptions = Model::getAttributeDescriptions(format);
+    pipelineConfig.vertPath = format == Model::VertexFormat::Compact ? compactVertPath : vertPath;
+  }
+
+  auto pipelines = m_pipelineRegistry.getPipelines({&configs[0], &configs[1]});
+  std::copy(pipelines.begin(), pipelines.end(), m_pipelines.begin());
 }
 } // engine
\ No newline at end of file
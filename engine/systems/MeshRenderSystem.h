@@ -5,9 +5,11 @@
 #include "FrameInfo.h"
 #include "Mesh.h"
 #include "Pipeline.h"
+#include "PipelineRegistry.h"
 #include "Rectangle.h"
 #include "ShadowRenderSystem.h"
 
+#include <array>
 #include <memory>
 
 namespace engine {
@@ -15,12 +17,14 @@ namespace engine {
 class MeshRenderSystem {
 private:
   Device &m_device;
-  std::unique_ptr<Pipeline> m_pipeline;
+  PipelineRegistry &m_pipelineRegistry;
+  // one pipeline per Model::VertexFormat, indexed by it
+  std::array<std::shared_ptr<Pipeline>, 2> m_pipelines;
   VkPipelineLayout m_pipelineLayout;
 
 
 public:
-  MeshRenderSystem(Device &device, VkRenderPass renderPass, std::vector<VkDescriptorSetLayout> &&descriptorSetLayouts, const std::string &vertPath, const std::string &fragPath);
+  MeshRenderSystem(Device &device, PipelineRegistry &pipelineRegistry, VkRenderPass renderPass, std::vector<VkDescriptorSetLayout> &&descriptorSetLayouts, const std::string &vertPath, const std::string &compactVertPath, const std::string &fragPath);
 
   ~MeshRenderSystem();
 
@@ -32,8 +36,8 @@ public:
 
 private:
   void CreatePipelineLayout(std::vector<VkDescriptorSetLayout> &globalSetLayouts);
-  void CreatePipeline(VkRenderPass renderPass, const std::string &vertPath,
-                      const std::string &fragPath);
+  void CreatePipelines(VkRenderPass renderPass, const std::string &vertPath,
+                       const std::string &compactVertPath, const std::string &fragPath);
 };
 
 } // engine
@@ -3,11 +3,16 @@
 //
 
 #include "ShadowRenderSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <stdexcept>
 
 namespace engine {
 
-ShadowRenderSystem::ShadowRenderSystem(Device &device, VkDescriptorSetLayout globalSetLayout) : m_device(device) {
+ShadowRenderSystem::ShadowRenderSystem(Device &device, PipelineRegistry &pipelineRegistry, VkDescriptorSetLayout globalSetLayout)
+    : m_device(device), m_pipelineRegistry(pipelineRegistry) {
   CreateDepthResources();
   CreateSampler();
   CreateRenderPass();
@@ -18,11 +23,15 @@ ShadowRenderSystem::ShadowRenderSystem(Device &device, VkDescriptorSetLayout glo
 }
 
 ShadowRenderSystem::~ShadowRenderSystem() {
+  for (auto &pipeline : m_pipelines) {
+    pipeline.reset();
+  }
+  m_pipelineRegistry.evict(m_pipelineLayout);
   vkDestroyPipelineLayout(m_device.device(), m_pipelineLayout, nullptr);
   vkDestroySampler(m_device.device(), m_sampler, nullptr);
   vkDestroyImageView(m_device.device(), m_depthImageView, nullptr);
   vkDestroyImage(m_device.device(), m_depthImage, nullptr);
-  vkFreeMemory(m_device.device(), m_depthImageMemory, nullptr);
+  m_device.freeMemory(m_depthImageMemory);
   vkDestroyFramebuffer(m_device.device(), m_shadowFramebuffer, nullptr);
   vkDestroyRenderPass(m_device.device(), m_renderPass, nullptr);
 }
@@ -45,7 +54,7 @@ void ShadowRenderSystem::CreateDepthResources() {
   imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 
   m_device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                               m_depthImage, m_depthImageMemory);
+                               m_depthImage, m_depthImageMemory, MemoryTag::Shadow);
 
   VkImageViewCreateInfo viewInfo{};
   viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -71,8 +80,9 @@ void ShadowRenderSystem::CreateRenderPass() {
   depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  // the render graph moves the map between depth writes and sampling
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
   VkAttachmentReference depthReference{};
   depthReference.attachment = 0;
@@ -144,6 +154,7 @@ void ShadowRenderSystem::CreateSampler() {
 }
 
 void ShadowRenderSystem::Render(FrameInfo &frameInfo) {
+  PROFILE_SCOPE("ShadowRenderSystem::Render");
   VkRenderPassBeginInfo renderPassInfo{};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
   renderPassInfo.renderPass = m_renderPass;
@@ -172,7 +183,8 @@ void ShadowRenderSystem::Render(FrameInfo &frameInfo) {
   scissor.extent = {SHADOW_MAP_SIZE, SHADOW_MAP_SIZE};
   vkCmdSetScissor(frameInfo.commandBuffer, 0, 1, &scissor);
 
-  m_pipeline->bind(frameInfo.commandBuffer);
+  Pipeline *bound = m_pipelines[0].get();
+  bound->bind(frameInfo.commandBuffer);
 
   vkCmdBindDescriptorSets(
       frameInfo.commandBuffer,
@@ -181,14 +193,23 @@ void ShadowRenderSystem::Render(FrameInfo &frameInfo) {
       0,
       static_cast<uint32_t>(frameInfo.descriptorSets.size()),
       frameInfo.descriptorSets.data(),
-      0,
-      nullptr
+      static_cast<uint32_t>(frameInfo.dynamicOffsets.size()),
+      frameInfo.dynamicOffsets.data()
   );
 
   for (auto& obj : frameInfo.structures) {
     if (!obj) continue;
+    auto model = frameInfo.resourceManager.getModel(obj->type);
+    if (!model) continue;
+
+    Pipeline *pipeline = m_pipelines[static_cast<size_t>(model->GetVertexFormat())].get();
+    if (pipeline != bound) {
+      pipeline->bind(frameInfo.commandBuffer);
+      bound = pipeline;
+    }
+
     SimplePushConstantData push{};
-    push.modelMatrix = obj->mat4();
+    push.modelMatrix = obj->mat4() * model->GetPositionTransform();
 
     vkCmdPushConstants(
         frameInfo.commandBuffer,
@@ -198,9 +219,8 @@ void ShadowRenderSystem::Render(FrameInfo &frameInfo) {
         sizeof(SimplePushConstantData),
         &push);
 
-    auto model = frameInfo.resourceManager.getModel(obj->type);
     model->Bind(frameInfo.commandBuffer);
-    model->Draw(frameInfo.commandBuffer);
+    model->Draw(frameInfo.commandBuffer, model->SelectLod(obj->mat4(), frameInfo.cameraPosition, frameInfo.projectionScale));
   }
 
   vkCmdEndRenderPass(frameInfo.commandBuffer);
@@ -270,29 +290,34 @@ VkDescriptorSet ShadowRenderSystem::GetShadowMapDescriptorSet() {
 void ShadowRenderSystem::CreatePipeline() {
   assert(m_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
-  PipelineConfigInfo pipelineConfig{};
-  Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+  // one config per vertex format, the registry compiles both concurrently
+  std::array<PipelineConfigInfo, 2> configs{};
+  for (auto format : {Model::VertexFormat::Full, Model::VertexFormat::Compact}) {
+    PipelineConfigInfo &pipelineConfig = configs[static_cast<size_t>(format)];
+    Pipeline::defaultPipelineConfigInfo(pipelineConfig);
 
-  pipelineConfig.colorBlendInfo.attachmentCount = 0;
-  pipelineConfig.colorBlendInfo.pAttachments = nullptr;
+    pipelineConfig.colorBlendInfo.attachmentCount = 0;
+    pipelineConfig.colorBlendInfo.pAttachments = nullptr;
 
-  pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
 
-  // Enable depth bias for better shadow quality
-  pipelineConfig.rasterizationInfo.depthBiasEnable = VK_TRUE;
-  pipelineConfig.rasterizationInfo.depthBiasConstantFactor = 4.0f;
-  pipelineConfig.rasterizationInfo.depthBiasSlopeFactor = 1.5f;
-  pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-  pipelineConfig.rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    // Enable depth bias for better shadow quality
+    pipelineConfig.rasterizationInfo.depthBiasEnable = VK_TRUE;
+    pipelineConfig.rasterizationInfo.depthBiasConstantFactor = 4.0f;
+    pipelineConfig.rasterizationInfo.depthBiasSlopeFactor = 1.5f;
+    pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+    pipelineConfig.rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 
-  pipelineConfig.bindingDescriptions = Model::Vertex::getBindingsDescriptions();
-  pipelineConfig.attributeDescriptions = Model::Vertex::getAttributeDescriptions();
+    pipelineConfig.renderPass = m_renderPass;
+    pipelineConfig.pipelineLayout = m_pipelineLayout;
+    pipelineConfig.vertPath = "../shader/shadow.vert.spv";
+    pipelineConfig.fragPath = "../shader/shadow.frag.spv";
 
-  pipelineConfig.renderPass = m_renderPass;
-  pipelineConfig.pipelineLayout = m_pipelineLayout;
-  pipelineConfig.vertPath = "../shader/shadow.vert.spv";
-  pipelineConfig.fragPath = "../shader/shadow.frag.spv";
+    pipelineConfig.bindingDescriptions = Model::getBindingsDescriptions(format);
+    pipelineConfig.attributeDescriptions = Model::getAttributeDescriptions(format);
+  }
 
-  m_pipeline = std::make_unique<Pipeline>(m_device, pipelineConfig);
+  auto pipelines = m_pipelineRegistry.getPipelines({&configs[0], &configs[1]});
+  std::copy(pipelines.begin(), pipelines.end(), m_pipelines.begin());
 }
 } // namespace engine
\ No newline at end of file
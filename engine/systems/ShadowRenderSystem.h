@@ -2,9 +2,12 @@
 
 #include "Device.h"
 #include "Pipeline.h"
+#include "PipelineRegistry.h"
 #include "FrameInfo.h"
 #include "Model.h"
 
+#include <array>
+
 namespace engine {
 
 class ShadowRenderSystem {
@@ -16,12 +19,14 @@ private:
   static constexpr int SHADOW_MAP_SIZE = 2048;
 
   Device& m_device;
-  std::unique_ptr<Pipeline> m_pipeline;
+  PipelineRegistry& m_pipelineRegistry;
+  // one pipeline per Model::VertexFormat, shadow.vert only reads the position
+  std::array<std::shared_ptr<Pipeline>, 2> m_pipelines;
   VkPipelineLayout m_pipelineLayout{VK_NULL_HANDLE};
 
   // Shadow map resources
   VkImage m_depthImage{VK_NULL_HANDLE};
-  VkDeviceMemory m_depthImageMemory{VK_NULL_HANDLE};
+  Allocation m_depthImageMemory{};
   VkImageView m_depthImageView{VK_NULL_HANDLE};
   VkSampler m_sampler{VK_NULL_HANDLE};
   VkRenderPass m_renderPass{VK_NULL_HANDLE};
@@ -33,7 +38,7 @@ private:
   VkDescriptorSet m_shadowMapDescriptorSet{VK_NULL_HANDLE};
 
 public:
-  ShadowRenderSystem(Device& device, VkDescriptorSetLayout globalSetLayout);
+  ShadowRenderSystem(Device& device, PipelineRegistry& pipelineRegistry, VkDescriptorSetLayout globalSetLayout);
   ~ShadowRenderSystem();
 
   ShadowRenderSystem(const ShadowRenderSystem&) = delete;
@@ -42,6 +47,7 @@ public:
   void Render(FrameInfo& frameInfo);
   VkDescriptorSetLayout GetDescriptorSetLayout() const { return m_descriptorSetLayout->getDescriptorSetLayout(); }
   VkDescriptorSet GetShadowMapDescriptorSet();
+  VkImage GetShadowMapImage() const { return m_depthImage; }
 
 private:
   void CreateDepthResources();
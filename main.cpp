@@ -1,10 +1,144 @@
+#include "Benchmark.h"
 #include "Editor.h"
+#include "MeshCooker.h"
+#include "TextureCooker.h"
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 
-int main() {
-    engine::Editor app;
+namespace {
+  // --frames-in-flight <1-3> --present-mode <fifo|mailbox|immediate> --fps-cap <n>
+  engine::FramePolicy parseFramePolicy(int argc, char **argv) {
+    engine::FramePolicy policy{};
+    for (int i = 1; i + 1 < argc; i += 2) {
+      const char *option = argv[i];
+      const char *value = argv[i + 1];
+      if (std::strcmp(option, "--frames-in-flight") == 0) {
+        policy.framesInFlight = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+      } else if (std::strcmp(option, "--present-mode") == 0) {
+        if (std::strcmp(value, "fifo") == 0) {
+          policy.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        } else if (std::strcmp(value, "mailbox") == 0) {
+          policy.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        } else if (std::strcmp(value, "immediate") == 0) {
+          policy.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        } else {
+          std::cerr << "Unknown present mode: " << value << std::endl;
+        }
+      } else if (std::strcmp(option, "--fps-cap") == 0) {
+        policy.maxFrameRate = std::strtof(value, nullptr);
+      } else {
+        std::cerr << "Unknown option: " << option << std::endl;
+      }
+    }
+    return policy;
+  }
+
+  // cook mesh <models...>, writes a .cmesh next to each OBJ
+  int cookMeshes(int argc, char **argv) {
+    try {
+      for (int i = 3; i < argc; i++) {
+        engine::cookMesh(argv[i]);
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  // cook <bc1|bc3|bc7> <textures...>, writes a block compressed .ctex next to each texture
+  // cook mesh <models...>, see cookMeshes
+  int cookAssets(int argc, char **argv) {
+    if (argc < 4) {
+      std::cerr << "usage: " << argv[0] << " cook <bc1|bc3|bc7> <textures...>" << std::endl;
+      std::cerr << "       " << argv[0] << " cook mesh <models...>" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    if (std::strcmp(argv[2], "mesh") == 0) {
+      return cookMeshes(argc, argv);
+    }
+
+    engine::TextureCodec codec;
+    if (std::strcmp(argv[2], "bc1") == 0) {
+      codec = engine::TextureCodec::BC1;
+    } else if (std::strcmp(argv[2], "bc3") == 0) {
+      codec = engine::TextureCodec::BC3;
+    } else if (std::strcmp(argv[2], "bc7") == 0) {
+      codec = engine::TextureCodec::BC7;
+    } else {
+      std::cerr << "Unknown codec: " << argv[2] << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    try {
+      for (int i = 3; i < argc; i++) {
+        engine::cookTexture(argv[i], codec);
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  // bench [--frames <n>] [--warmup <n>] [--width <px>] [--height <px>] [--scene-size <n>]
+  //       [--frames-in-flight <1-3>] [--output <path>] [--trace <path>]
+  // renders headless, no window or surface is created, see Benchmark
+  int runBenchmark(int argc, char **argv) {
+    engine::BenchmarkSettings settings{};
+    for (int i = 2; i + 1 < argc; i += 2) {
+      const char *option = argv[i];
+      const char *value = argv[i + 1];
+      auto number = [&]() { return static_cast<uint32_t>(std::strtoul(value, nullptr, 10)); };
+      if (std::strcmp(option, "--frames") == 0) {
+        settings.frames = number();
+      } else if (std::strcmp(option, "--warmup") == 0) {
+        settings.warmupFrames = number();
+      } else if (std::strcmp(option, "--width") == 0) {
+        settings.extent.width = number();
+      } else if (std::strcmp(option, "--height") == 0) {
+        settings.extent.height = number();
+      } else if (std::strcmp(option, "--scene-size") == 0) {
+        settings.sceneSize = number();
+      } else if (std::strcmp(option, "--frames-in-flight") == 0) {
+        settings.framePolicy.framesInFlight = number();
+      } else if (std::strcmp(option, "--output") == 0) {
+        settings.output = value;
+      } else if (std::strcmp(option, "--trace") == 0) {
+        settings.tracePath = value;
+      } else {
+        std::cerr << "Unknown option: " << option << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    if (settings.frames == 0 || settings.extent.width == 0 || settings.extent.height == 0) {
+      std::cerr << "frames, width and height must be positive" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    try {
+      engine::Benchmark benchmark{settings};
+      benchmark.run();
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && std::strcmp(argv[1], "cook") == 0) {
+        return cookAssets(argc, argv);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "bench") == 0) {
+        return runBenchmark(argc, argv);
+    }
+
+    engine::Editor app{parseFramePolicy(argc, argv)};
     try {
         app.run();
     } catch (const std::exception &e) {
@@ -17,17 +17,21 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 
 layout(set = 1, binding = 0) uniform sampler2D shadowMap;
 
-layout(set = 2, binding = 0) uniform sampler2D  uTexture;
+layout(set = 2, binding = 0) uniform sampler2DArray uTextures;
 
 
 layout(push_constant) uniform Push {
     mat4 modelMatrix;
     mat4 normaMatrix;
     uint colorIndex;
+    uint textureLayer;
 } push;
 
 layout(location = 0) out vec4 outColor;
 
+// layer of textures that are still loading, see ResourceManager::NO_TEXTURE
+const uint NO_TEXTURE = 0xFFFFFFFFu;
+
 vec4 colors[] = {
   vec4(0.75, 0.5, 0.75, 1),
   vec4(0.5, 0.8, 0.75, 1),
@@ -45,7 +49,10 @@ float ShadowCalculation(vec4 fragPosLightSpace) {
 }
 
 void main() {
-    vec4 texColor = texture(uTexture, fragUV);
+    vec4 texColor = vec4(1.0);
+    if (push.textureLayer != NO_TEXTURE) {
+        texColor = texture(uTextures, vec3(fragUV, push.textureLayer));
+    }
     texColor *= colors[push.colorIndex];
 
     float shadow = ShadowCalculation(fragPosLightSpace);
@@ -28,7 +28,7 @@ void main() {
     vec4 positionWorld = push.modelMatrix * vec4(position, 1.0f);
     gl_Position = ubo.projection * ubo.view * positionWorld;
     fragPosLightSpace = ubo.lightSpaceMatrix * positionWorld;
-    fragNormalWorld = normalize(mat3(push.modelMatrix) * normal);
+    fragNormalWorld = normalize(mat3(push.normaMatrix) * normal);
     fragPosWorld = positionWorld.xyz;
     fragUV = uv;
 }
\ No newline at end of file
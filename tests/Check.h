@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+// Minimal assertions for the CPU tests, a failed check reports its location and
+// the test exits non-zero once main returns testResult().
+namespace engine::test {
+
+    inline int &failures() {
+        static int count = 0;
+        return count;
+    }
+
+    inline int testResult() {
+        if (failures() > 0) {
+            std::cerr << failures() << " check(s) failed" << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+} // namespace engine::test
+
+#define CHECK(condition)                                                                            \
+    do {                                                                                            \
+        if (!(condition)) {                                                                         \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            engine::test::failures()++;                                                             \
+        }                                                                                           \
+    } while (false)
@@ -0,0 +1,256 @@
+#include "Check.h"
+#include "ObjLoader.h"
+#include "Utils.h"
+
+#include "tiny_obj_loader/tiny_obj_loader.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace engine;
+
+namespace {
+    struct VertexHash {
+        size_t operator()(const Model::Vertex &vertex) const {
+            size_t seed = 0;
+            HashCombine(seed, vertex.position.x, vertex.position.y, vertex.position.z, vertex.normal.x,
+                        vertex.normal.y, vertex.normal.z, vertex.uv.x, vertex.uv.y);
+            return seed;
+        }
+    };
+
+    // the tinyobjloader path Model::Builder::LoadModel took before loadObj
+    Model::Builder loadReference(const std::string &filepath) {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string err;
+
+        Model::Builder builder{};
+        std::string mtlDir = filepath.substr(0, filepath.find_last_of('/') + 1);
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filepath.c_str(), mtlDir.c_str())) {
+            std::cerr << "tinyobjloader failed on " << filepath << ": " << err << std::endl;
+            test::failures()++;
+            return builder;
+        }
+
+        std::unordered_map<Model::Vertex, uint32_t, VertexHash> uniqueVertices{};
+        for (const auto &shape : shapes) {
+            int shapeMaterial = shape.mesh.material_ids.empty() ? -1 : shape.mesh.material_ids.front();
+            builder.submeshes.push_back({static_cast<uint32_t>(builder.indices.size()), 0, shapeMaterial});
+
+            size_t indexOffset = 0;
+            for (unsigned char fv : shape.mesh.num_face_vertices) {
+                for (size_t v = 0; v < fv; v++) {
+                    tinyobj::index_t index = shape.mesh.indices[indexOffset + v];
+                    Model::Vertex vertex{};
+                    if (index.vertex_index >= 0) {
+                        vertex.position = {attrib.vertices[3 * index.vertex_index + 0],
+                                           attrib.vertices[3 * index.vertex_index + 1],
+                                           attrib.vertices[3 * index.vertex_index + 2]};
+                    }
+                    if (index.normal_index >= 0) {
+                        vertex.normal = {attrib.normals[3 * index.normal_index + 0],
+                                         attrib.normals[3 * index.normal_index + 1],
+                                         attrib.normals[3 * index.normal_index + 2]};
+                    }
+                    if (index.texcoord_index >= 0) {
+                        vertex.uv = {attrib.texcoords[2 * index.texcoord_index + 0],
+                                     1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
+                    }
+
+                    auto [it, inserted] = uniqueVertices.try_emplace(vertex, static_cast<uint32_t>(builder.vertices.size()));
+                    if (inserted) {
+                        builder.vertices.push_back(vertex);
+                    }
+                    builder.indices.push_back(it->second);
+                }
+                indexOffset += fv;
+            }
+            builder.submeshes.back().indexCount =
+                    static_cast<uint32_t>(builder.indices.size()) - builder.submeshes.back().firstIndex;
+        }
+        return builder;
+    }
+
+    bool sameSubmeshes(const Model::Builder &a, const Model::Builder &b) {
+        return std::equal(a.submeshes.begin(), a.submeshes.end(), b.submeshes.begin(), b.submeshes.end(),
+                          [](const Model::Submesh &x, const Model::Submesh &y) {
+                              return x.firstIndex == y.firstIndex && x.indexCount == y.indexCount &&
+                                     x.materialId == y.materialId;
+                          });
+    }
+
+    // loadObj with the given chunk counts has to reproduce the reference exactly
+    void compare(const std::string &filepath, std::initializer_list<uint32_t> chunkCounts) {
+        Model::Builder expected = loadReference(filepath);
+        for (uint32_t chunkCount : chunkCounts) {
+            Model::Builder builder{};
+            loadObj(filepath, builder, chunkCount);
+
+            bool vertices = builder.vertices == expected.vertices;
+            bool indices = builder.indices == expected.indices;
+            bool submeshes = sameSubmeshes(builder, expected);
+            if (!vertices || !indices || !submeshes) {
+                std::cerr << filepath << " with " << chunkCount << " chunk(s) differs in"
+                          << (vertices ? "" : " vertices") << (indices ? "" : " indices")
+                          << (submeshes ? "" : " submeshes") << std::endl;
+            }
+            CHECK(vertices);
+            CHECK(indices);
+            CHECK(submeshes);
+        }
+    }
+
+    std::string writeFile(const std::filesystem::path &directory, const std::string &name, const std::string &text) {
+        std::filesystem::path path = directory / name;
+        std::ofstream{path, std::ios::binary} << text;
+        return path.generic_string();
+    }
+
+    // Numbers go through loadObj's own parser, which follows tinyobjloader's
+    // grammar: signs, exponents, missing digits and tokens that are not numbers.
+    void testFloats(const std::filesystem::path &directory) {
+        std::string obj = "v 1 -2 +3\n"
+                          "v 0.5 -0.25 +0.125\n"
+                          "v 1e2 -2.5E-1 1.5e+3\n"
+                          "v 1e 2E+ -3e-\n"
+                          "v .5 -.5 +.5\n"
+                          "v - + abc\n"
+                          "v 7.0f 1.25x 4e1e\n"
+                          "v 0.1 -0.3 1234.5678\n"
+                          "vt 0.25 1e-1\n"
+                          "vt 5E-1 .75\n"
+                          "vn 0 0 -1\n"
+                          "vn -0 1E0 -0.0\n"
+                          "f 1/1/1 2/2/2 3/1/2\n"
+                          "f 4/2/1 5/1/2 6/2/1\n"
+                          "f 7/1/1 8/2/2 1/2/2\n";
+        std::string path = writeFile(directory, "floats.obj", obj);
+        compare(path, {1});
+
+        // spot checks, independent of tinyobjloader
+        Model::Builder builder{};
+        loadObj(path, builder);
+        // corners 4/2/1 and 6/2/1 both end up at the origin and share a vertex
+        CHECK(builder.vertices.size() == 8);
+        if (builder.vertices.size() == 8) {
+            CHECK(builder.vertices[2].position == glm::vec3(100.0f, -0.25f, 1500.0f));
+            // an exponent without digits makes the whole number 0, as does a missing leading digit
+            CHECK(builder.vertices[3].position == glm::vec3(0.0f));
+            CHECK(builder.vertices[3].uv == glm::vec2(0.5f, 1.0f));
+            CHECK(builder.vertices[4].position == glm::vec3(0.0f));
+            // trailing text after a number is ignored, also after a complete exponent
+            CHECK(builder.vertices[5].position == glm::vec3(7.0f, 1.25f, 40.0f));
+        }
+    }
+
+    // Polygons are fanned around their first corner, in every index form.
+    void testPolygons(const std::filesystem::path &directory) {
+        std::string obj;
+        for (int i = 0; i < 8; i++) {
+            obj += "v " + std::to_string(i) + " " + std::to_string(i * i) + " " + std::to_string(i % 3) + "\n";
+            obj += "vt " + std::to_string(i * 0.125f) + " " + std::to_string(1.0f - i * 0.125f) + "\n";
+            obj += "vn 0 " + std::to_string(i % 2) + " " + std::to_string(1 - i % 2) + "\n";
+        }
+        obj += "f 1 2 3 4\n"
+               "f 1/1 2/2 3/3 4/4 5/5\n"
+               "f 1//8 3//7 5//6 7//5 8//4 6//3\n"
+               "f 8/1/2 7/2/3 6/3/4 5/4/5 4/5/6 3/6/7 2/7/8\n"
+               "f -1/-1/-1 -2/-2/-2 -3/-3/-3 -4/-4/-4\n"
+               "f 2 4 6\n";
+        std::string path = writeFile(directory, "polygons.obj", obj);
+        compare(path, {1, 2});
+
+        Model::Builder builder{};
+        loadObj(path, builder);
+        // triangles per face: 2, 3, 4, 5, 2 and 1
+        CHECK(builder.indices.size() == 17 * 3);
+        if (builder.indices.size() >= 6) {
+            // the quad 1 2 3 4 becomes 1 2 3 and 1 3 4
+            CHECK(builder.indices[3] == builder.indices[0]);
+            CHECK(builder.indices[4] == builder.indices[2]);
+        }
+    }
+
+    // usemtl, g and o change shapes in file order, which loadObj replays after
+    // parsing the chunks in parallel. Forcing many chunks puts the boundaries
+    // between a statement and the faces it applies to.
+    void testShapesAcrossChunks(const std::filesystem::path &directory) {
+        writeFile(directory, "shapes.mtl", "newmtl red\nKd 1 0 0\n\nnewmtl green\nKd 0 1 0\n\nnewmtl blue\nKd 0 0 1\n");
+
+        const char *materials[] = {"red", "green", "blue", "missing"};
+        std::string obj = "mtllib shapes.mtl\n";
+        int vertices = 0;
+        for (int block = 0; block < 240; block++) {
+            // a new group, a new material, a material right before a group (whose
+            // faces tinyobjloader drops), repeated and unknown materials, empty groups
+            switch (block % 7) {
+                case 0: obj += "g group" + std::to_string(block) + "\n"; break;
+                case 1: obj += "usemtl " + std::string(materials[block % 4]) + "\n"; break;
+                case 2: obj += "usemtl " + std::string(materials[block % 3]) + "\ng after\n"; break;
+                case 3: obj += "o object" + std::to_string(block) + "\r\n"; break;
+                case 4: obj += "usemtl " + std::string(materials[block % 4]) + "\nusemtl red\n"; break;
+                case 5: obj += "g empty\ng\n"; break;
+                default: break;
+            }
+            int faces = 1 + block % 5;
+            for (int face = 0; face < faces; face++) {
+                for (int corner = 0; corner < 4; corner++) {
+                    int i = vertices + corner;
+                    obj += "v " + std::to_string(i % 17) + " " + std::to_string(block) + " " + std::to_string(corner) + "\n";
+                    obj += "vt " + std::to_string(corner * 0.25f) + " " + std::to_string(face * 0.5f) + "\n";
+                }
+                // odd blocks index relative to the end, even ones absolute
+                obj += "f";
+                for (int corner = 0; corner < 4; corner++) {
+                    std::string index = std::to_string(block % 2 ? corner - 4 : vertices + corner + 1);
+                    obj += " " + index + "/" + index;
+                }
+                obj += "\n";
+                vertices += 4;
+            }
+        }
+        std::string path = writeFile(directory, "shapes.obj", obj);
+        compare(path, {1, 2, 3, 7, 64, 997});
+
+        Model::Builder builder{};
+        loadObj(path, builder, 64);
+        CHECK(builder.submeshes.size() > 40);
+    }
+} // namespace
+
+// expects the model directory as its only argument
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: ObjLoaderTest <model directory>" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::filesystem::path> models;
+    for (const auto &entry : std::filesystem::directory_iterator(argv[1])) {
+        if (entry.path().extension() == ".obj") {
+            models.push_back(entry.path());
+        }
+    }
+    std::sort(models.begin(), models.end());
+    CHECK(!models.empty());
+    for (const auto &model : models) {
+        std::cout << model.filename().string() << std::endl;
+        compare(model.generic_string(), {0, 1, 5});
+    }
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "ObjLoaderTest";
+    std::filesystem::create_directories(directory);
+    testFloats(directory);
+    testPolygons(directory);
+    testShapesAcrossChunks(directory);
+    std::filesystem::remove_all(directory);
+
+    return test::testResult();
+}
@@ -0,0 +1,220 @@
+#include "Camera.h"
+#include "Check.h"
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace engine;
+
+namespace {
+    constexpr uint32_t WIDTH = 320;
+    constexpr uint32_t HEIGHT = 192;
+
+    // camera at z = -20 looking down +z, occluders are placed around z = 0
+    const glm::vec3 CAMERA{0.0f, 0.0f, -20.0f};
+
+    glm::mat4 viewProjection() {
+        component::Camera camera;
+        camera.SetPerspectiveProjection(glm::radians(60.0f), static_cast<float>(WIDTH) / HEIGHT, 0.1f, 500.0f);
+        camera.SetViewDirection(CAMERA, {0.0f, 0.0f, 1.0f});
+        return camera.Projection() * camera.View();
+    }
+
+    bool visible(OcclusionCuller &culler, const glm::vec3 &min, const glm::vec3 &max) {
+        return culler.isVisible(min, max);
+    }
+
+    bool inView(const glm::vec3 &point) {
+        glm::vec4 clip = viewProjection() * glm::vec4(point, 1.0f);
+        return clip.w > 0.0f && std::abs(clip.x) <= clip.w && std::abs(clip.y) <= clip.w && clip.z >= 0.0f &&
+               clip.z <= clip.w;
+    }
+
+    // whether the segment from the camera to point passes through one of the boxes
+    bool hidden(const glm::vec3 &point, const std::vector<OccluderBox> &occluders) {
+        glm::vec3 direction = point - CAMERA;
+        for (const auto &box : occluders) {
+            float enter = 0.0f;
+            float exit = 1.0f;
+            for (int axis = 0; axis < 3; axis++) {
+                if (direction[axis] == 0.0f) {
+                    if (CAMERA[axis] < box.min[axis] || CAMERA[axis] > box.max[axis]) {
+                        exit = -1.0f;
+                    }
+                    continue;
+                }
+                float t0 = (box.min[axis] - CAMERA[axis]) / direction[axis];
+                float t1 = (box.max[axis] - CAMERA[axis]) / direction[axis];
+                enter = std::max(enter, std::min(t0, t1));
+                exit = std::min(exit, std::max(t0, t1));
+            }
+            if (enter < exit) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void testWithoutOccluders() {
+        OcclusionCuller culler{WIDTH, HEIGHT};
+        culler.beginFrame(viewProjection());
+        culler.rasterize();
+
+        CHECK(visible(culler, {-1, -1, 10}, {1, 1, 12}));
+        // behind the camera and far off to the side
+        CHECK(!visible(culler, {-1, -1, -40}, {1, 1, -30}));
+        CHECK(!visible(culler, {200, -1, 10}, {202, 1, 12}));
+        // crossing the near plane
+        CHECK(visible(culler, {-1, -1, -21}, {1, 1, -19}));
+    }
+
+    void testWall() {
+        OcclusionCuller culler{WIDTH, HEIGHT};
+        culler.beginFrame(viewProjection());
+        culler.addOccluder(OccluderBox{{-100, -100, 0}, {100, 100, 1}});
+        culler.rasterize();
+
+        CHECK(culler.stats().occluders == 1);
+        CHECK(!visible(culler, {-1, -1, 5}, {1, 1, 6}));
+        CHECK(!visible(culler, {-8, -5, 2}, {8, 5, 40}));
+        // in front of the wall and reaching through it
+        CHECK(visible(culler, {-1, -1, -5}, {1, 1, -4}));
+        CHECK(visible(culler, {-1, -1, -0.5f}, {1, 1, 2}));
+    }
+
+    void testHalfWall() {
+        OcclusionCuller culler{WIDTH, HEIGHT};
+        culler.beginFrame(viewProjection());
+        culler.addOccluder(OccluderBox{{-100, -100, 0}, {0, 100, 1}});
+        culler.rasterize();
+
+        CHECK(!visible(culler, {-6, -1, 5}, {-4, 1, 6}));
+        CHECK(visible(culler, {4, -1, 5}, {6, 1, 6}));
+        // partly behind the edge of the wall
+        CHECK(visible(culler, {-1, -1, 5}, {1, 1, 6}));
+    }
+
+    // every point of a culled box has to be hidden behind an occluder, boxes nearer
+    // than all occluders are never culled, and the batched test has to agree with
+    // isVisible box by box
+    void testRandomScenes() {
+        std::minstd_rand random{7};
+        std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+        auto range = [&](float low, float high) { return low + (high - low) * unit(random); };
+
+        OcclusionCuller culler{WIDTH, HEIGHT};
+        uint32_t occluded = 0;
+        for (int scene = 0; scene < 20; scene++) {
+            culler.beginFrame(viewProjection());
+            std::vector<OccluderBox> occluders;
+            for (int i = 0; i < 16; i++) {
+                glm::vec3 min{range(-15, 10), range(-10, 6), range(0, 10)};
+                occluders.push_back({min, min + glm::vec3{range(1, 8), range(1, 8), range(1, 4)}});
+                culler.addOccluder(occluders.back());
+            }
+            culler.rasterize();
+
+            uint32_t count = 3 * OcclusionCuller::BATCH_SIZE + 17;
+            std::vector<glm::vec3> mins(count);
+            std::vector<glm::vec3> maxs(count);
+            for (uint32_t i = 0; i < count; i++) {
+                mins[i] = {range(-30, 30), range(-20, 20), range(-15, 30)};
+                maxs[i] = mins[i] + glm::vec3{range(0.1f, 3), range(0.1f, 3), range(0.1f, 3)};
+            }
+            std::vector<uint8_t> result(count);
+            culler.cullBoxes(mins.data(), maxs.data(), count, result.data());
+
+            const OcclusionStats &stats = culler.stats();
+            CHECK(stats.tested == count);
+            uint32_t visibleCount = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                CHECK((result[i] != 0) == culler.isVisible(mins[i], maxs[i]));
+                visibleCount += result[i];
+
+                // corners pulled in a little and the center stand in for the whole box
+                if (!result[i]) {
+                    glm::vec3 inner = (maxs[i] - mins[i]) * 0.01f;
+                    for (uint32_t sample = 0; sample < 9; sample++) {
+                        glm::vec3 point = (mins[i] + maxs[i]) * 0.5f;
+                        if (sample < 8) {
+                            point = {sample & 1 ? maxs[i].x - inner.x : mins[i].x + inner.x,
+                                     sample & 2 ? maxs[i].y - inner.y : mins[i].y + inner.y,
+                                     sample & 4 ? maxs[i].z - inner.z : mins[i].z + inner.z};
+                        }
+                        CHECK(!inView(point) || hidden(point, occluders));
+                    }
+                }
+            }
+            CHECK(visibleCount + stats.frustumCulled + stats.occluded == count);
+            occluded += stats.occluded;
+
+            // nothing in front of z = 0 can be hidden
+            std::vector<glm::vec3> nearMins;
+            std::vector<glm::vec3> nearMaxs;
+            for (uint32_t i = 0; i < count; i++) {
+                if (maxs[i].z < 0.0f) {
+                    nearMins.push_back(mins[i]);
+                    nearMaxs.push_back(maxs[i]);
+                }
+            }
+            uint32_t occludedBefore = stats.occluded;
+            culler.cullBoxes(nearMins.data(), nearMaxs.data(), static_cast<uint32_t>(nearMins.size()), result.data());
+            CHECK(culler.stats().occluded == occludedBefore);
+        }
+        CHECK(occluded > 0);
+    }
+
+    // The target is a couple of milliseconds at 1M instances. Box tests are split
+    // across the culler's workers, so the budget is 16 ms of single core time
+    // spread over up to eight cores, 2 ms on eight. The tests are always built
+    // optimized, see CMakeLists.txt.
+    void testMillionBoxes() {
+        constexpr uint32_t count = 1000000;
+        std::minstd_rand random{3};
+        std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+
+        // a dense block of cells behind a merged front wall, most reach the depth test
+        std::vector<glm::vec3> mins(count);
+        std::vector<glm::vec3> maxs(count);
+        for (uint32_t i = 0; i < count; i++) {
+            glm::vec3 cell{static_cast<float>(i % 100), static_cast<float>(i / 100 % 100), static_cast<float>(i / 10000)};
+            mins[i] = glm::vec3{-50, -50, 2} + cell * glm::vec3{1, 1, 0.5f} + unit(random) * 0.1f;
+            maxs[i] = mins[i] + glm::vec3{0.8f};
+        }
+
+        OcclusionCuller culler{WIDTH, HEIGHT};
+        culler.beginFrame(viewProjection());
+        culler.addOccluder(OccluderBox{{-100, -100, 0}, {100, 100, 1}});
+        culler.rasterize();
+
+        std::vector<uint8_t> result(count);
+        float best = 0.0f;
+        // the best of several runs, other processes only ever add time
+        for (int run = 0; run < 20; run++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            culler.cullBoxes(mins.data(), maxs.data(), count, result.data());
+            float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            best = run == 0 ? ms : std::min(best, ms);
+        }
+        CHECK(std::count(result.begin(), result.end(), 0) == count);
+
+        uint32_t cores = std::max(1u, std::min(std::thread::hardware_concurrency(), 8u));
+        float budget = 16.0f / static_cast<float>(cores);
+        std::cout << "1M boxes: " << best << " ms on " << cores << " core(s), budget " << budget << " ms" << std::endl;
+        CHECK(best <= budget);
+    }
+} // namespace
+
+int main() {
+    testWithoutOccluders();
+    testWall();
+    testHalfWall();
+    testRandomScenes();
+    testMillionBoxes();
+    return test::testResult();
+}
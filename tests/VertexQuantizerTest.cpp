@@ -0,0 +1,125 @@
+#include "Check.h"
+#include "ObjLoader.h"
+#include "VertexQuantizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/packing.hpp>
+
+using namespace engine;
+
+namespace {
+    // what the compact format promises on every model in model/
+    constexpr float MAX_POSITION_ERROR = 7.6e-6f;  // of the bounding box diagonal
+    constexpr float MAX_NORMAL_ERROR = 0.0037f;    // degrees
+    constexpr float MAX_UV_ERROR = 3.4e-4f;
+
+    // mirrors decodeOctahedral in mesh_compact.vert
+    glm::vec3 decodeOctahedral(const int16_t encoded[2]) {
+        glm::vec2 e{glm::unpackSnorm1x16(static_cast<uint16_t>(encoded[0])),
+                    glm::unpackSnorm1x16(static_cast<uint16_t>(encoded[1]))};
+        glm::vec3 n{e, 1.0f - glm::abs(e.x) - glm::abs(e.y)};
+        float t = glm::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return glm::normalize(n);
+    }
+
+    float angleDegrees(const glm::vec3 &a, const glm::vec3 &b) {
+        // atan2 stays accurate for the tiny angles acos would round to zero
+        return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+    }
+
+    void testAxes() {
+        const glm::vec3 axes[] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+        for (const auto &axis : axes) {
+            int16_t encoded[2];
+            encodeOctahedral(axis, encoded);
+            CHECK(glm::length(decodeOctahedral(encoded) - axis) < 1e-4f);
+        }
+    }
+
+    void testModel(const std::filesystem::path &path) {
+        Model::Builder builder{};
+        loadObj(path.string(), builder);
+        const auto &vertices = builder.vertices;
+        CHECK(!vertices.empty());
+        if (vertices.empty()) {
+            return;
+        }
+
+        glm::vec3 minExtent = vertices[0].position;
+        glm::vec3 maxExtent = vertices[0].position;
+        for (const auto &vertex : vertices) {
+            minExtent = glm::min(minExtent, vertex.position);
+            maxExtent = glm::max(maxExtent, vertex.position);
+        }
+
+        std::vector<Model::CompactVertex> compact(vertices.size());
+        compactVertices(vertices.data(), static_cast<uint32_t>(vertices.size()), minExtent, maxExtent, compact.data());
+        glm::mat4 dequantize = dequantizeTransform(minExtent, maxExtent);
+
+        float positionError = 0.0f;
+        float normalError = 0.0f;
+        float uvError = 0.0f;
+        for (size_t i = 0; i < vertices.size(); i++) {
+            const Model::Vertex &vertex = vertices[i];
+            const Model::CompactVertex &out = compact[i];
+
+            glm::vec3 unit{glm::unpackUnorm1x16(out.position[0]), glm::unpackUnorm1x16(out.position[1]),
+                           glm::unpackUnorm1x16(out.position[2])};
+            glm::vec3 position{dequantize * glm::vec4(unit, 1.0f)};
+            positionError = std::max(positionError, glm::length(position - vertex.position));
+
+            // models without normals leave them at zero
+            if (glm::length(vertex.normal) > 0.0f) {
+                normalError = std::max(normalError, angleDegrees(glm::normalize(vertex.normal), decodeOctahedral(out.normal)));
+            }
+
+            glm::vec2 uv{glm::unpackHalf1x16(out.uv[0]), glm::unpackHalf1x16(out.uv[1])};
+            uvError = std::max({uvError, glm::abs(uv.x - vertex.uv.x), glm::abs(uv.y - vertex.uv.y)});
+        }
+
+        float diagonal = glm::length(maxExtent - minExtent);
+        float relativePosition = diagonal > 0.0f ? positionError / diagonal : positionError;
+        std::cout << path.filename().string() << ": " << vertices.size() << " vertices, position " << relativePosition
+                  << " of diagonal, normal " << normalError << " deg, uv " << uvError << std::endl;
+
+        CHECK(relativePosition <= MAX_POSITION_ERROR);
+        CHECK(normalError <= MAX_NORMAL_ERROR);
+        CHECK(uvError <= MAX_UV_ERROR);
+
+        // Model switches to 16-bit indices below this, terrain is the only model too big
+        bool shortIndices = vertices.size() < std::numeric_limits<uint16_t>::max();
+        CHECK(shortIndices == (path.stem() != "terrain"));
+    }
+} // namespace
+
+// expects the model directory as its only argument
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: VertexQuantizerTest <model directory>" << std::endl;
+        return 1;
+    }
+
+    testAxes();
+
+    std::vector<std::filesystem::path> models;
+    for (const auto &entry : std::filesystem::directory_iterator(argv[1])) {
+        if (entry.path().extension() == ".obj") {
+            models.push_back(entry.path());
+        }
+    }
+    std::sort(models.begin(), models.end());
+    CHECK(!models.empty());
+    for (const auto &model : models) {
+        testModel(model);
+    }
+    return test::testResult();
+}